@@ -0,0 +1,223 @@
+/*-
+ * Copyright (c) 2026 The io and ipc benchmark contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <err.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sysexits.h>
+#include <time.h>
+
+#include "calibrate.h"
+#include "duration.h"
+#include "trace.h"
+
+/*
+ * Calibration (-C).  Before the run, measure what the harness itself costs:
+ * a read of each clock, an iteration of the benchmark loop's bookkeeping
+ * with the system call taken out, and each of the caller's null system
+ * calls.  Each is the best of CALIBRATE_BATCHES timed batches.  After the
+ * run, the calls made are multiplied out into an estimate of the harness
+ * overhead.  With -CC, throughput is also given with that estimate
+ * subtracted, and as time per buffer beyond the harness -- the I/O or IPC
+ * path proper.
+ *
+ * The empty loop pays for what every benchmark loop does per call: the
+ * untraced trace_event() guards either side of it, the partial-transfer
+ * test, the byte count and its -i store, and the -d duration test.  It
+ * omits the USDT is-enabled tests, which cost nothing unless built with
+ * USDT probes, and per-buffer work in ipc's receiver (-H, fan-in and
+ * payload checks), which those options report on in their own terms.
+ */
+#define	CALIBRATE_BATCHES	5
+#define	CALIBRATE_ROUNDS	100000	/* Per batch */
+
+#define	CALIBRATE_REALTIME	0
+#define	CALIBRATE_MONOTONIC	1
+#define	CALIBRATE_TSC		2
+#define	CALIBRATE_LOOP		3
+#define	CALIBRATE_NULL		4	/* First of the caller's calls */
+#define	CALIBRATE_MAX		(CALIBRATE_NULL + CALIBRATE_CALLS)
+
+static const char *calibrate_names[CALIBRATE_MAX] = {
+	"CLOCK_REALTIME", "CLOCK_MONOTONIC", "TSC", "empty loop"
+};
+
+static double calibrate_ns[CALIBRATE_MAX];	/* Per call or iteration */
+static unsigned int calibrate_count;		/* Entries measured */
+static long calibrate_buffersize;
+
+static uint64_t
+min(uint64_t a, uint64_t b)
+{
+
+	return (a < b ? a : b);
+}
+
+static uint64_t
+monotonic_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		err(EX_OSERR, "FAIL: clock_gettime");
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static double
+timespec_ns(struct timespec ts)
+{
+
+	return ((double)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static double
+calibrate_measure(unsigned int what, const struct calibrate_call *ccp,
+    void *buf)
+{
+	struct timespec ts;
+	uint64_t best, start;
+	volatile long sink;
+	long bytes, i;
+	int batch;
+
+	best = UINT64_MAX;
+	for (batch = 0; batch < CALIBRATE_BATCHES; batch++) {
+		start = monotonic_ns();
+		switch (what) {
+		case CALIBRATE_REALTIME:
+			for (i = 0; i < CALIBRATE_ROUNDS; i++)
+				(void)clock_gettime(CLOCK_REALTIME, &ts);
+			break;
+
+		case CALIBRATE_MONOTONIC:
+			for (i = 0; i < CALIBRATE_ROUNDS; i++)
+				(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+			break;
+
+		case CALIBRATE_TSC:
+			for (i = 0; i < CALIBRATE_ROUNDS; i++)
+				sink = trace_tsc();
+			break;
+
+		case CALIBRATE_LOOP:
+			bytes = 0;
+			for (i = 0; i < CALIBRATE_ROUNDS; i++) {
+				trace_event(TRACE_READ, TRACE_BEGIN,
+				    calibrate_buffersize);
+				sink = calibrate_buffersize;
+				trace_event(TRACE_READ, TRACE_END, sink);
+				if (sink != calibrate_buffersize)
+					errx(EX_IOERR, "FAIL: partial");
+				bytes += sink;
+				if (interval_ms != 0)
+					__atomic_store_n(&benchmark_bytes,
+					    bytes, __ATOMIC_RELAXED);
+				if (duration_secs == 0)
+					continue;
+				if (duration_expired)
+					break;
+			}
+			break;
+
+		default:
+			for (i = 0; i < CALIBRATE_ROUNDS; i++)
+				ccp->cc_call(ccp->cc_fd, buf);
+			break;
+		}
+		best = min(best, monotonic_ns() - start);
+	}
+	return ((double)best / CALIBRATE_ROUNDS);
+}
+
+/*
+ * Measure the harness, and 'ncalls' null system calls 'calls', which use
+ * 'buf', for a run in 'buffersize' buffers.  Nothing may be tracing yet.
+ */
+void
+calibrate(const struct calibrate_call *calls, unsigned int ncalls, void *buf,
+    long buffersize)
+{
+	const struct calibrate_call *ccp;
+	unsigned int i;
+
+	if (ncalls > CALIBRATE_CALLS)
+		errx(EX_SOFTWARE, "FAIL: %u null calls to calibrate", ncalls);
+	calibrate_buffersize = buffersize;
+	calibrate_count = CALIBRATE_NULL + ncalls;
+	for (i = 0; i < calibrate_count; i++) {
+		ccp = i >= CALIBRATE_NULL ? &calls[i - CALIBRATE_NULL] : NULL;
+		if (ccp != NULL)
+			calibrate_names[i] = ccp->cc_name;
+		calibrate_ns[i] = calibrate_measure(i, ccp, buf);
+	}
+}
+
+/*
+ * Estimate the harness cost of 'calls' iterations of the loop, each making
+ * null call 'call'.
+ */
+double
+calibrate_harness(unsigned int call, long calls)
+{
+
+	return (calls * (calibrate_ns[CALIBRATE_LOOP] +
+	    calibrate_ns[CALIBRATE_NULL + call]));
+}
+
+/*
+ * Report the calibration for a run of 'elapsed' that moved 'bytes' with
+ * 'harness', from calibrate_harness(), spent in 'counts' calls; and with
+ * 'subtract', the throughput without it.
+ */
+void
+calibrate_print(struct timespec elapsed, long bytes, double harness,
+    const char *counts, int subtract)
+{
+	double overhead, net;
+	unsigned int i;
+
+	printf("calibration:");
+	for (i = 0; i < calibrate_count; i++)
+		printf("%s %s %.1F ns", i == 0 ? "" : ",", calibrate_names[i],
+		    calibrate_ns[i]);
+	printf("\n");
+	overhead = calibrate_ns[CALIBRATE_REALTIME] + harness;
+	printf("calibration: %s; harness ~%.3F ms, %.1F%% of the run\n",
+	    counts, overhead / 1000000, 100.0 * overhead /
+	    timespec_ns(elapsed));
+	if (!subtract)
+		return;
+	net = timespec_ns(elapsed) - overhead;
+	if (net <= 0) {
+		printf("calibration: harness estimate exceeds the run; "
+		    "nothing to subtract\n");
+		return;
+	}
+	printf("%.2F KBytes/sec (harness subtracted), %.1F ns/buffer beyond "
+	    "the harness\n", bytes / (net / 1000000000) / 1024,
+	    net / ((double)bytes / calibrate_buffersize));
+}
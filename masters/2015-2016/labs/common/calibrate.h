@@ -0,0 +1,55 @@
+/*-
+ * Copyright (c) 2026 The io and ipc benchmark contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _CALIBRATE_H_
+#define	_CALIBRATE_H_
+
+#include <time.h>
+
+/*
+ * Calibration (-C) for io and ipc: calibrate() before the run, naming the
+ * null system calls the benchmark makes, then calibrate_harness() for each
+ * to multiply out the calls made, and calibrate_print() with the total.
+ */
+#define	CALIBRATE_CALLS		2	/* Null calls, at most */
+
+/*
+ * A system call on 'cc_fd' that enters and leaves the kernel without moving
+ * any data, such as a zero-length read(); 'cc_call' makes it once.
+ */
+struct calibrate_call {
+	const char	*cc_name;
+	void		(*cc_call)(int fd, void *buf);
+	int		cc_fd;
+};
+
+void	calibrate(const struct calibrate_call *calls, unsigned int ncalls,
+	    void *buf, long buffersize);
+double	calibrate_harness(unsigned int call, long calls);
+void	calibrate_print(struct timespec elapsed, long bytes, double harness,
+	    const char *counts, int subtract);
+
+#endif /* !_CALIBRATE_H_ */
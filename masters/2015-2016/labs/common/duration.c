@@ -0,0 +1,223 @@
+/*-
+ * Copyright (c) 2026 The io and ipc benchmark contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <sys/types.h>
+#include <sys/time.h>
+
+#include <err.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+#include <time.h>
+
+#include "duration.h"
+#include "sampler.h"
+
+/*
+ * Duration-limited runs (-T) and interval throughput (-I), shared by io and
+ * ipc.  With -T, a one-shot interval timer is armed as the benchmark takes
+ * its start time, and its loop tests the flag that the SIGALRM handler sets,
+ * so that the loop makes no extra system calls.
+ *
+ * With -I, a periodic sampler records the benchmark's byte count at a fixed
+ * interval, and the throughput of each interval within the timed region is
+ * printed after the run, to tell ramp-up and stalls from steady state.  The
+ * benchmark loop publishes its count with a relaxed atomic store.
+ */
+#define	INTERVAL_RING		65536	/* Samples */
+
+#define	timespecsub(vvp, uvp)						\
+	do {								\
+		(vvp)->tv_sec -= (uvp)->tv_sec;				\
+		(vvp)->tv_nsec -= (uvp)->tv_nsec;			\
+		if ((vvp)->tv_nsec < 0) {				\
+			(vvp)->tv_sec--;				\
+			(vvp)->tv_nsec += 1000000000;			\
+		}							\
+	} while (0)
+
+#define	max(x, y)	((x) > (y) ? (x) : (y))
+
+long duration_secs;			/* 0 if bounded by -t */
+long interval_ms;			/* 0 if disabled */
+
+volatile sig_atomic_t duration_expired;
+
+long benchmark_bytes;
+
+struct interval_sample {
+	struct timespec	 is_time;
+	long		 is_bytes;
+};
+
+static struct sampler interval_sampler;
+
+static double
+timespec_ns(struct timespec ts)
+{
+
+	return ((double)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static void
+duration_alarm(int sig)
+{
+
+	(void)sig;
+	duration_expired = 1;
+}
+
+/*
+ * Before each duration-limited run.
+ */
+void
+duration_setup(void)
+{
+	static int installed;
+	struct sigaction sa;
+
+	if (!installed) {
+		bzero(&sa, sizeof(sa));
+		sa.sa_handler = duration_alarm;
+		sa.sa_flags = SA_RESTART;
+		sigemptyset(&sa.sa_mask);
+		if (sigaction(SIGALRM, &sa, NULL) < 0)
+			err(EX_OSERR, "FAIL: sigaction");
+		installed = 1;
+	}
+	duration_expired = 0;
+}
+
+/*
+ * Called by whoever moves the data, just after taking the start time.
+ */
+void
+duration_arm(void)
+{
+	struct itimerval it;
+
+	bzero(&it, sizeof(it));
+	it.it_value.tv_sec = duration_secs;
+	if (setitimer(ITIMER_REAL, &it, NULL) < 0)
+		err(EX_OSERR, "FAIL: setitimer");
+}
+
+static void
+interval_sample(void *slot, struct timespec now, void *arg)
+{
+	struct interval_sample *isp = slot;
+
+	(void)arg;
+	isp->is_time = now;
+	isp->is_bytes = __atomic_load_n(&benchmark_bytes, __ATOMIC_RELAXED);
+}
+
+void
+interval_start(void)
+{
+
+	benchmark_bytes = 0;
+	sampler_start(&interval_sampler, interval_ms * 1000000,
+	    sizeof(struct interval_sample), INTERVAL_RING, interval_sample,
+	    NULL);
+}
+
+void
+interval_finish(void)
+{
+
+	sampler_stop(&interval_sampler);
+}
+
+static int
+double_compare(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x < y ? -1 : x > y);
+}
+
+/*
+ * Print the throughput of each interval ending between 'starttime' and
+ * 'starttime' + 'elapsed', with times relative to the start, then the spread
+ * of the interval rates.  The first interval runs from the start, and the
+ * end of the run closes the last, so both may be short, and are left out of
+ * the spread.
+ */
+void
+interval_print(struct timespec starttime, struct timespec elapsed)
+{
+	struct sampler *sp = &interval_sampler;
+	struct interval_sample *isp;
+	struct timespec t;
+	double prev_ns, ns, rate, *rates;
+	long bytes, first, n, nrates, prev_bytes, prev_n;
+
+	first = max(0, sp->sp_count - INTERVAL_RING);
+	printf("interval: %ld ms, %ld samples, %ld overwritten\n", interval_ms,
+	    sp->sp_count, first);
+	printf("%12s %14s %14s\n", "time_ms", "bytes", "KBytes/sec");
+	rates = calloc(sp->sp_count - first + 1, sizeof(*rates));
+	if (rates == NULL)
+		err(EX_OSERR, "FAIL: calloc");
+	prev_ns = 0;
+	prev_bytes = 0;
+	prev_n = -1;
+	nrates = 0;
+	for (n = first; n <= sp->sp_count; n++) {
+		if (n < sp->sp_count) {
+			isp = sampler_slot(sp, n);
+			t = isp->is_time;
+			timespecsub(&t, &starttime);
+			if (t.tv_sec < 0)
+				continue;
+			ns = timespec_ns(t);
+			bytes = isp->is_bytes;
+		} else {
+			ns = timespec_ns(elapsed);
+			bytes = benchmark_bytes;
+		}
+		if (ns <= prev_ns || ns > timespec_ns(elapsed))
+			continue;
+		/* KBytes/sec, as the benchmarks' own rates. */
+		rate = (bytes - prev_bytes) / ((ns - prev_ns) / 1000000000) /
+		    1024;
+		printf("%12.1F %14ld %14.2F\n", ns / 1000000, bytes, rate);
+		if (prev_n != -1 && n < sp->sp_count)
+			rates[nrates++] = rate;
+		prev_ns = ns;
+		prev_bytes = bytes;
+		prev_n = n;
+	}
+	if (nrates != 0) {
+		qsort(rates, nrates, sizeof(*rates), double_compare);
+		printf("interval KBytes/sec: min %.2F, median %.2F, max %.2F\n",
+		    rates[0], rates[nrates / 2], rates[nrates - 1]);
+	}
+	free(rates);
+}
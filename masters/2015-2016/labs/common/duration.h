@@ -0,0 +1,57 @@
+/*-
+ * Copyright (c) 2026 The io and ipc benchmark contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _DURATION_H_
+#define	_DURATION_H_
+
+#include <signal.h>
+#include <time.h>
+
+/*
+ * Duration-limited runs (-T) and interval throughput (-I) for io and ipc.
+ * Before the run, duration_setup() and interval_start(); as the start time
+ * is taken, duration_arm().  The benchmark loop stops once duration_expired
+ * is set, and, with -I, publishes its running total in benchmark_bytes with
+ * a relaxed atomic store; at the end it stores the final total there.
+ * After the run, interval_finish(), then interval_print().
+ */
+extern long duration_secs;		/* 0 if bounded by -t */
+extern long interval_ms;		/* 0 if disabled */
+
+extern volatile sig_atomic_t duration_expired;
+
+/*
+ * Bytes moved so far, and in total, in the most recent run.
+ */
+extern long benchmark_bytes;
+
+void	duration_setup(void);
+void	duration_arm(void);
+void	interval_start(void);
+void	interval_finish(void);
+void	interval_print(struct timespec starttime, struct timespec elapsed);
+
+#endif /* !_DURATION_H_ */
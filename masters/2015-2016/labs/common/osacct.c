@@ -0,0 +1,315 @@
+/*-
+ * Copyright (c) 2026 The io and ipc benchmark contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
+
+#include <err.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sysexits.h>
+#include <unistd.h>
+
+#include "osacct.h"
+
+/*
+ * OS resource accounting (-R), shared by io and ipc.  Snapshot getrusage()
+ * for ourselves and our reaped children, and on Linux /proc/self/io,
+ * selected system-wide /proc/vmstat counters and, for io, the /proc/diskstats
+ * line of the target's block device, around the timed run, and report the
+ * deltas along with CPU time, I/O system calls and context switches per
+ * unit of data moved.  For reads of a file, the storage and character counts
+ * give the share of data that came from the device rather than the page
+ * cache.
+ *
+ * /proc/self/io counts our own reads of /proc.  So that the deltas cover
+ * only the run, the first snapshot reads it last and the second reads it
+ * first, each with a single read(), whose values do not yet include that
+ * read itself; what is left between the two is the first snapshot's read,
+ * which osacct_print() subtracts.  Like the children's rusage, /proc/self/io
+ * includes ipc's 2proc senders once they have been reaped.
+ */
+#ifdef __linux__
+static const char *osacct_io_names[OSACCT_IO] = {
+	"rchar", "wchar", "syscr", "syscw", "read_bytes", "write_bytes",
+	"cancelled_write_bytes"
+};
+
+static const char *osacct_vm_names[OSACCT_VM] = {
+	"pgpgin", "pgpgout", "pgfault", "pgmajfault", "pswpin", "pswpout",
+	"pgscan_kswapd", "pgscan_direct", "pgsteal_kswapd", "pgsteal_direct"
+};
+
+/*
+ * Parse a "name value" or "name: value" line.
+ */
+static void
+osacct_line(const char *line, const char **names, unsigned int n,
+    uint64_t *values)
+{
+	char name[64];
+	uintmax_t value;
+	unsigned int i;
+
+	if (sscanf(line, "%63[^: ]%*[: ]%ju", name, &value) != 2)
+		return;
+	for (i = 0; i < n; i++)
+		if (strcmp(name, names[i]) == 0)
+			values[i] = value;
+}
+
+/*
+ * Read a file of such lines; returns -1 if the file could not be read.
+ * Values not found are left as zero.
+ */
+static int
+osacct_procfile(const char *path, const char **names, unsigned int n,
+    uint64_t *values)
+{
+	char line[256];
+	FILE *fp;
+
+	bzero(values, n * sizeof(*values));
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return (-1);
+	while (fgets(line, sizeof(line), fp) != NULL)
+		osacct_line(line, names, n, values);
+	fclose(fp);
+	return (0);
+}
+
+/*
+ * Read /proc/self/io with exactly one read(), so that its own cost is known.
+ */
+static int
+osacct_selfio(struct osacct *oap)
+{
+	char buf[1024], *line, *p;
+	ssize_t len;
+	int fd;
+
+	bzero(oap->oa_io, sizeof(oap->oa_io));
+	fd = open("/proc/self/io", O_RDONLY);
+	if (fd < 0)
+		return (-1);
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0)
+		return (-1);
+	buf[len] = '\0';
+	oap->oa_io_len = len;
+	p = buf;
+	while ((line = strsep(&p, "\n")) != NULL)
+		osacct_line(line, osacct_io_names, OSACCT_IO, oap->oa_io);
+	return (0);
+}
+
+/*
+ * Find the /proc/diskstats line for block device 'dev'; returns -1 if there
+ * is none, e.g., for files on tmpfs, NFS or overlay filesystems.
+ */
+static int
+osacct_diskstats(dev_t dev, char *name, size_t namelen, uint64_t *values)
+{
+	char line[256], devname[32];
+	uintmax_t v[OSACCT_DISK];
+	unsigned int maj, mnr, i;
+	FILE *fp;
+
+	fp = fopen("/proc/diskstats", "r");
+	if (fp == NULL)
+		return (-1);
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "%u %u %31s %ju %*u %ju %*u %ju %*u %ju",
+		    &maj, &mnr, devname, &v[0], &v[1], &v[2], &v[3]) != 7)
+			continue;
+		if (maj != major(dev) || mnr != minor(dev))
+			continue;
+		snprintf(name, namelen, "%s", devname);
+		for (i = 0; i < OSACCT_DISK; i++)
+			values[i] = v[i];
+		fclose(fp);
+		return (0);
+	}
+	fclose(fp);
+	return (-1);
+}
+#endif
+
+static double
+osacct_secs(struct timeval tv)
+{
+
+	return (tv.tv_sec + tv.tv_usec / 1000000.0);
+}
+
+/*
+ * Everything but /proc/self/io.  'fd' is the target file, whose device (or,
+ * for a block special file, itself) is looked up in /proc/diskstats; -1 if
+ * there is none.
+ */
+static void
+osacct_snapshot(struct osacct *oap, int fd)
+{
+#ifdef __linux__
+	struct stat sb;
+#endif
+
+	if (getrusage(RUSAGE_SELF, &oap->oa_self) < 0 ||
+	    getrusage(RUSAGE_CHILDREN, &oap->oa_children) < 0)
+		err(EX_OSERR, "FAIL: getrusage");
+#ifdef __linux__
+	(void)osacct_procfile("/proc/vmstat", osacct_vm_names, OSACCT_VM,
+	    oap->oa_vm);
+	oap->oa_disk_lookup = fd >= 0;
+	oap->oa_disk_valid = 0;
+	if (fd < 0)
+		return;
+	if (fstat(fd, &sb) < 0)
+		err(EX_OSERR, "FAIL: fstat");
+	oap->oa_disk_valid = osacct_diskstats(S_ISBLK(sb.st_mode) ?
+	    sb.st_rdev : sb.st_dev, oap->oa_disk_name,
+	    sizeof(oap->oa_disk_name), oap->oa_disk) == 0;
+#endif
+}
+
+void
+osacct_begin(struct osacct *oap, int fd)
+{
+
+	osacct_snapshot(oap, fd);
+#ifdef __linux__
+	oap->oa_io_valid = osacct_selfio(oap) == 0;
+#endif
+}
+
+void
+osacct_end(struct osacct *oap, int fd)
+{
+
+#ifdef __linux__
+	oap->oa_io_valid = osacct_selfio(oap) == 0;
+#endif
+	osacct_snapshot(oap, fd);
+}
+
+/*
+ * Print deltas from 'before' to 'after', for 'bytes' of data moved;
+ * 'reading' if the run read from the target file.
+ */
+void
+osacct_print(const struct osacct *before, const struct osacct *after,
+    long bytes, int reading)
+{
+	double user, sys, cuser, csys, mb;
+	long nvcsw, nivcsw;
+#ifdef __linux__
+	uint64_t io[OSACCT_IO];
+	unsigned int i;
+	int io_valid;
+#endif
+
+	user = osacct_secs(after->oa_self.ru_utime) -
+	    osacct_secs(before->oa_self.ru_utime);
+	sys = osacct_secs(after->oa_self.ru_stime) -
+	    osacct_secs(before->oa_self.ru_stime);
+	cuser = osacct_secs(after->oa_children.ru_utime) -
+	    osacct_secs(before->oa_children.ru_utime);
+	csys = osacct_secs(after->oa_children.ru_stime) -
+	    osacct_secs(before->oa_children.ru_stime);
+	nvcsw = after->oa_self.ru_nvcsw - before->oa_self.ru_nvcsw +
+	    after->oa_children.ru_nvcsw - before->oa_children.ru_nvcsw;
+	nivcsw = after->oa_self.ru_nivcsw - before->oa_self.ru_nivcsw +
+	    after->oa_children.ru_nivcsw - before->oa_children.ru_nivcsw;
+	printf("rusage: user %.6F s, system %.6F s; children user %.6F s, "
+	    "system %.6F s\n", user, sys, cuser, csys);
+	printf("rusage: %ld voluntary, %ld involuntary context switches; "
+	    "%ld minor, %ld major faults; %ld blocks in, %ld out\n", nvcsw,
+	    nivcsw, after->oa_self.ru_minflt - before->oa_self.ru_minflt +
+	    after->oa_children.ru_minflt - before->oa_children.ru_minflt,
+	    after->oa_self.ru_majflt - before->oa_self.ru_majflt +
+	    after->oa_children.ru_majflt - before->oa_children.ru_majflt,
+	    after->oa_self.ru_inblock - before->oa_self.ru_inblock +
+	    after->oa_children.ru_inblock - before->oa_children.ru_inblock,
+	    after->oa_self.ru_oublock - before->oa_self.ru_oublock +
+	    after->oa_children.ru_oublock - before->oa_children.ru_oublock);
+#ifdef __linux__
+	io_valid = before->oa_io_valid && after->oa_io_valid;
+	if (io_valid) {
+		printf("proc io:");
+		for (i = 0; i < OSACCT_IO; i++) {
+			io[i] = after->oa_io[i] - before->oa_io[i];
+			if (i == OSACCT_IO_RCHAR)
+				io[i] -= before->oa_io_len;
+			else if (i == OSACCT_IO_SYSCR)
+				io[i] -= 1;
+			printf("%s %s %ju", i == 0 ? "" : ",",
+			    osacct_io_names[i], (uintmax_t)io[i]);
+		}
+		printf("\n");
+		if (reading && io[OSACCT_IO_RCHAR] != 0)
+			printf("storage reads: %.1F%% of bytes read (rest from "
+			    "page cache)\n", 100.0 * io[OSACCT_IO_READ_BYTES] /
+			    io[OSACCT_IO_RCHAR]);
+	}
+	if (after->oa_disk_valid && before->oa_disk_valid)
+		printf("diskstats %s: %ju reads (%ju KB), %ju writes (%ju KB) "
+		    "(device-wide)\n", after->oa_disk_name,
+		    (uintmax_t)(after->oa_disk[OSACCT_DISK_READS] -
+		    before->oa_disk[OSACCT_DISK_READS]),
+		    (uintmax_t)(after->oa_disk[OSACCT_DISK_RSECTORS] -
+		    before->oa_disk[OSACCT_DISK_RSECTORS]) / 2,
+		    (uintmax_t)(after->oa_disk[OSACCT_DISK_WRITES] -
+		    before->oa_disk[OSACCT_DISK_WRITES]),
+		    (uintmax_t)(after->oa_disk[OSACCT_DISK_WSECTORS] -
+		    before->oa_disk[OSACCT_DISK_WSECTORS]) / 2);
+	else if (after->oa_disk_lookup)
+		printf("diskstats: no block device behind target\n");
+	printf("vmstat (system-wide):");
+	for (i = 0; i < OSACCT_VM; i++)
+		printf("%s %s %ju", i == 0 ? "" : ",", osacct_vm_names[i],
+		    (uintmax_t)(after->oa_vm[i] - before->oa_vm[i]));
+	printf("\n");
+#endif
+	mb = bytes / 1048576.0;
+	printf("efficiency: %.3F CPU-s/GB", (user + sys + cuser + csys) /
+	    (mb / 1024));
+#ifdef __linux__
+	if (io_valid)
+		printf(", %.1F I/O syscalls/MB",
+		    (io[OSACCT_IO_SYSCR] + io[OSACCT_IO_SYSCW]) / mb);
+#endif
+	printf(", %.1F voluntary and %.1F involuntary switches/MB\n",
+	    nvcsw / mb, nivcsw / mb);
+}
@@ -0,0 +1,77 @@
+/*-
+ * Copyright (c) 2026 The io and ipc benchmark contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _OSACCT_H_
+#define	_OSACCT_H_
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <stdint.h>
+
+/*
+ * OS resource accounting (-R) for io and ipc: osacct_begin() just before
+ * the timed run, osacct_end() just after it, then osacct_print().
+ */
+#define	OSACCT_IO_RCHAR		0	/* Bytes passed to read() etc. */
+#define	OSACCT_IO_WCHAR		1
+#define	OSACCT_IO_SYSCR		2	/* read-class system calls */
+#define	OSACCT_IO_SYSCW		3	/* write-class system calls */
+#define	OSACCT_IO_READ_BYTES	4	/* Bytes fetched from storage */
+#define	OSACCT_IO_WRITE_BYTES	5
+#define	OSACCT_IO_CANCELLED	6
+#define	OSACCT_IO		7
+
+#define	OSACCT_VM		10	/* See osacct_vm_names[]. */
+
+#define	OSACCT_DISK_READS	0	/* Completed reads */
+#define	OSACCT_DISK_RSECTORS	1	/* 512-byte sectors read */
+#define	OSACCT_DISK_WRITES	2
+#define	OSACCT_DISK_WSECTORS	3
+#define	OSACCT_DISK		4
+
+struct osacct {
+	struct rusage	oa_self;
+	struct rusage	oa_children;
+#ifdef __linux__
+	uint64_t	oa_io[OSACCT_IO];
+	uint64_t	oa_io_len;	/* Bytes of /proc/self/io read. */
+	uint64_t	oa_vm[OSACCT_VM];
+	int		oa_io_valid;
+	uint64_t	oa_disk[OSACCT_DISK];
+	char		oa_disk_name[32];
+	int		oa_disk_lookup;	/* A target file was given. */
+	int		oa_disk_valid;
+#endif
+};
+
+void	osacct_begin(struct osacct *oap, int fd);
+void	osacct_end(struct osacct *oap, int fd);
+void	osacct_print(const struct osacct *before, const struct osacct *after,
+	    long bytes, int reading);
+
+#endif /* !_OSACCT_H_ */
@@ -0,0 +1,532 @@
+/*-
+ * Copyright (c) 2026 The io and ipc benchmark contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifdef WITH_PERF
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <linux/perf_event.h>
+
+#include <elf.h>
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+#include <unistd.h>
+
+#include "prof.h"
+
+#define	max(x, y)	((x) > (y) ? (x) : (y))
+#define	min(x, y)	((x) < (y) ? (x) : (y))
+
+/*
+ * Sampling profiler (-X), shared by io and ipc.  Each thread in the timed
+ * region opens a sampling perf event on itself, which records the
+ * interrupted user or kernel instruction pointer once every 'period' events
+ * into a ring buffer mapped into the thread.  At the end of the timed region
+ * the thread drains its ring into a sample store, shared across fork() so
+ * that ipc's 2proc senders can contribute.  After the run, samples are
+ * attributed to symbols -- kernel ones from /proc/kallsyms, our own from the
+ * executable's ELF symbol table, and anything else to the file it was mapped
+ * from -- and printed as a ranked hotspot table.  Rings are drained only at
+ * the end, so samples that do not fit are counted as lost; lengthen the
+ * period if there are many.  Kernel samples may require root or a
+ * permissive perf_event_paranoid; if they are refused, only user samples are
+ * taken, which prof_setup() decides before any fork() so that every process
+ * agrees with the report.
+ */
+#define	PROF_RING_PAGES		512		/* Power of two */
+#define	PROF_SAMPLES_MAX	(1024 * 1024)
+#define	PROF_HOTSPOTS		25
+
+struct prof_event {
+	const char	*pe_name;
+	uint32_t	 pe_type;
+	uint64_t	 pe_config;
+	uint64_t	 pe_period;	/* Default period. */
+};
+
+static const struct prof_event prof_events[] = {
+	{ "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 1000003 },
+	{ "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,
+	  1000003 },
+	{ "cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,
+	  10007 },
+	{ "cpu-clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_CLOCK, 100000 },
+};
+#define	PROF_EVENTS	(sizeof(prof_events) / sizeof(prof_events[0]))
+
+const struct prof_event *prof_event;	/* NULL if not profiling. */
+static uint64_t prof_period;
+static int prof_user_only;
+
+struct prof_store {
+	uint64_t	ps_count;	/* Samples taken, including dropped. */
+	uint64_t	ps_lost;	/* Samples lost from rings. */
+	uint64_t	ps_ip[PROF_SAMPLES_MAX];
+	uint8_t		ps_kernel[PROF_SAMPLES_MAX];
+};
+
+static struct prof_store *prof_store;
+
+/*
+ * Parse "event[:period]"; returns -1 if invalid.
+ */
+int
+prof_parse(char *spec)
+{
+	char *name, *endp;
+	unsigned int i;
+
+	name = strsep(&spec, ":");
+	for (i = 0; i < PROF_EVENTS; i++)
+		if (strcmp(name, prof_events[i].pe_name) == 0)
+			break;
+	if (i == PROF_EVENTS)
+		return (-1);
+	prof_event = &prof_events[i];
+	prof_period = prof_event->pe_period;
+	if (spec != NULL) {
+		prof_period = strtoull(spec, &endp, 10);
+		if (*spec == '\0' || *endp != '\0' || prof_period == 0)
+			return (-1);
+	}
+	return (0);
+}
+
+static int
+prof_event_open(int user_only)
+{
+	struct perf_event_attr attr;
+
+	bzero(&attr, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = prof_event->pe_type;
+	attr.config = prof_event->pe_config;
+	attr.sample_period = prof_period;
+	attr.sample_type = PERF_SAMPLE_IP;
+	attr.disabled = 1;
+	attr.exclude_hv = 1;
+	attr.exclude_kernel = user_only;
+	return (syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+/*
+ * (Re)initialise the sample store before the run to be profiled, and,
+ * before any process is forked, find out whether kernel samples are allowed.
+ * Other failures are left for prof_open() to report.
+ */
+void
+prof_setup(void)
+{
+	int fd;
+
+	if (prof_store == NULL) {
+		prof_store = mmap(NULL, sizeof(*prof_store),
+		    PROT_READ | PROT_WRITE, MAP_ANON | MAP_SHARED, -1, 0);
+		if (prof_store == MAP_FAILED)
+			err(EX_OSERR, "FAIL: mmap");
+		fd = prof_event_open(0);
+		if (fd >= 0)
+			close(fd);
+		else if (errno == EACCES || errno == EPERM)
+			prof_user_only = 1;
+	}
+	prof_store->ps_count = 0;
+	prof_store->ps_lost = 0;
+}
+
+void
+prof_open(struct prof_state *prp)
+{
+
+	prp->pr_fd = prof_event_open(prof_user_only);
+	if (prp->pr_fd < 0)
+		err(EX_UNAVAILABLE, "FAIL: perf_event_open %s",
+		    prof_event->pe_name);
+	prp->pr_ring = mmap(NULL, (PROF_RING_PAGES + 1) * getpagesize(),
+	    PROT_READ | PROT_WRITE, MAP_SHARED, prp->pr_fd, 0);
+	if (prp->pr_ring == MAP_FAILED)
+		err(EX_OSERR, "FAIL: mmap perf ring");
+}
+
+void
+prof_begin(struct prof_state *prp)
+{
+
+	if (ioctl(prp->pr_fd, PERF_EVENT_IOC_RESET, 0) < 0 ||
+	    ioctl(prp->pr_fd, PERF_EVENT_IOC_ENABLE, 0) < 0)
+		err(EX_OSERR, "FAIL: perf enable");
+}
+
+/*
+ * Copy 'len' bytes from ring offset 'off', which may wrap.
+ */
+static void
+prof_copy(const char *data, uint64_t off, void *dst, size_t len)
+{
+	const uint64_t size = (uint64_t)PROF_RING_PAGES * getpagesize();
+	size_t first;
+
+	off %= size;
+	first = min(len, size - off);
+	memcpy(dst, data + off, first);
+	memcpy((char *)dst + first, data, len - first);
+}
+
+/*
+ * Stop sampling, and drain and release the ring.
+ */
+void
+prof_end(struct prof_state *prp)
+{
+	struct perf_event_mmap_page *mp;
+	struct perf_event_header hdr;
+	struct {
+		uint64_t	id;
+		uint64_t	lost;
+	} lost;
+	uint64_t head, tail, ip, i;
+	const char *data;
+
+	(void)ioctl(prp->pr_fd, PERF_EVENT_IOC_DISABLE, 0);
+	mp = prp->pr_ring;
+	data = (const char *)prp->pr_ring + getpagesize();
+	head = __atomic_load_n(&mp->data_head, __ATOMIC_ACQUIRE);
+	for (tail = mp->data_tail; tail < head; tail += hdr.size) {
+		prof_copy(data, tail, &hdr, sizeof(hdr));
+		if (hdr.size == 0)
+			break;
+		switch (hdr.type) {
+		case PERF_RECORD_SAMPLE:
+			prof_copy(data, tail + sizeof(hdr), &ip, sizeof(ip));
+			i = __atomic_fetch_add(&prof_store->ps_count, 1,
+			    __ATOMIC_RELAXED);
+			if (i >= PROF_SAMPLES_MAX)
+				break;
+			prof_store->ps_ip[i] = ip;
+			prof_store->ps_kernel[i] =
+			    (hdr.misc & PERF_RECORD_MISC_CPUMODE_MASK) ==
+			    PERF_RECORD_MISC_KERNEL;
+			break;
+
+		case PERF_RECORD_LOST:
+			prof_copy(data, tail + sizeof(hdr), &lost,
+			    sizeof(lost));
+			__atomic_fetch_add(&prof_store->ps_lost, lost.lost,
+			    __ATOMIC_RELAXED);
+			break;
+		}
+	}
+	__atomic_store_n(&mp->data_tail, tail, __ATOMIC_RELEASE);
+	munmap(prp->pr_ring, (PROF_RING_PAGES + 1) * getpagesize());
+	close(prp->pr_fd);
+}
+
+/*
+ * Symbols, by start address.  Kernel symbols carry no size, so extend to
+ * the next one.
+ */
+struct prof_sym {
+	uint64_t	 psy_addr;
+	uint64_t	 psy_size;	/* 0 if unknown */
+	const char	*psy_name;
+};
+
+struct prof_symtab {
+	struct prof_sym	*pst_syms;
+	size_t		 pst_count;
+	size_t		 pst_cap;
+};
+
+static void
+prof_sym_add(struct prof_symtab *pstp, uint64_t addr, uint64_t size,
+    const char *name)
+{
+
+	if (pstp->pst_count == pstp->pst_cap) {
+		pstp->pst_cap = max(pstp->pst_cap * 2, 1024);
+		pstp->pst_syms = realloc(pstp->pst_syms,
+		    pstp->pst_cap * sizeof(*pstp->pst_syms));
+		if (pstp->pst_syms == NULL)
+			err(EX_OSERR, "FAIL: realloc");
+	}
+	pstp->pst_syms[pstp->pst_count].psy_addr = addr;
+	pstp->pst_syms[pstp->pst_count].psy_size = size;
+	pstp->pst_syms[pstp->pst_count].psy_name = name;
+	pstp->pst_count++;
+}
+
+static int
+prof_sym_compare(const void *a, const void *b)
+{
+	const struct prof_sym *sa = a, *sb = b;
+
+	return (sa->psy_addr < sb->psy_addr ? -1 :
+	    sa->psy_addr > sb->psy_addr);
+}
+
+static const char *
+prof_sym_lookup(const struct prof_symtab *pstp, uint64_t addr)
+{
+	const struct prof_sym *psyp;
+	size_t lo, hi, mid;
+
+	lo = 0;
+	hi = pstp->pst_count;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (pstp->pst_syms[mid].psy_addr <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == 0)
+		return (NULL);
+	psyp = &pstp->pst_syms[lo - 1];
+	if (psyp->psy_size != 0 && addr >= psyp->psy_addr + psyp->psy_size)
+		return (NULL);
+	return (psyp->psy_name);
+}
+
+/*
+ * Text symbols from /proc/kallsyms; without privilege, addresses read as
+ * zero and none are loaded.
+ */
+static void
+prof_kallsyms(struct prof_symtab *pstp)
+{
+	char line[512], name[256], type;
+	uint64_t addr;
+	FILE *fp;
+	char *s;
+
+	fp = fopen("/proc/kallsyms", "r");
+	if (fp == NULL)
+		return;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, "%" SCNx64 " %c %255s", &addr, &type,
+		    name) != 3 || addr == 0 || (type != 't' && type != 'T'))
+			continue;
+		if ((s = strdup(name)) == NULL)
+			err(EX_OSERR, "FAIL: strdup");
+		prof_sym_add(pstp, addr, 0, s);
+	}
+	fclose(fp);
+}
+
+/*
+ * Function symbols from our own executable, relocated by the load bias of
+ * its first mapping, for position-independent executables.
+ */
+static void
+prof_elfsyms(struct prof_symtab *pstp, uint64_t mapstart)
+{
+	const Elf64_Ehdr *eh;
+	const Elf64_Phdr *ph;
+	const Elf64_Shdr *sh, *symsh;
+	const Elf64_Sym *sym;
+	const char *strtab;
+	uint64_t bias, vaddr;
+	struct stat sb;
+	char *image, *s;
+	size_t i, n;
+	int fd;
+
+	fd = open("/proc/self/exe", O_RDONLY);
+	if (fd < 0)
+		return;
+	if (fstat(fd, &sb) < 0 || (image = mmap(NULL, sb.st_size, PROT_READ,
+	    MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		close(fd);
+		return;
+	}
+	close(fd);
+	eh = (const Elf64_Ehdr *)image;
+	if ((size_t)sb.st_size < sizeof(*eh) ||
+	    memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 ||
+	    eh->e_ident[EI_CLASS] != ELFCLASS64)
+		goto out;
+	vaddr = UINT64_MAX;
+	ph = (const Elf64_Phdr *)(image + eh->e_phoff);
+	for (i = 0; i < eh->e_phnum; i++)
+		if (ph[i].p_type == PT_LOAD)
+			vaddr = min(vaddr, ph[i].p_vaddr);
+	bias = eh->e_type == ET_DYN ?
+	    mapstart - (vaddr & ~((uint64_t)getpagesize() - 1)) : 0;
+	sh = (const Elf64_Shdr *)(image + eh->e_shoff);
+	symsh = NULL;
+	for (i = 0; i < eh->e_shnum; i++) {
+		if (sh[i].sh_type == SHT_SYMTAB)
+			symsh = &sh[i];
+		else if (sh[i].sh_type == SHT_DYNSYM && symsh == NULL)
+			symsh = &sh[i];
+	}
+	if (symsh == NULL)
+		goto out;
+	sym = (const Elf64_Sym *)(image + symsh->sh_offset);
+	strtab = image + sh[symsh->sh_link].sh_offset;
+	n = symsh->sh_size / sizeof(*sym);
+	for (i = 0; i < n; i++) {
+		if (ELF64_ST_TYPE(sym[i].st_info) != STT_FUNC ||
+		    sym[i].st_value == 0)
+			continue;
+		if ((s = strdup(strtab + sym[i].st_name)) == NULL)
+			err(EX_OSERR, "FAIL: strdup");
+		prof_sym_add(pstp, sym[i].st_value + bias, sym[i].st_size, s);
+	}
+out:
+	munmap(image, sb.st_size);
+}
+
+/*
+ * Executable mappings other than our own, labelled by file.
+ */
+static void
+prof_maps(struct prof_symtab *pstp, uint64_t *mapstartp)
+{
+	char line[1024], perms[8], path[PATH_MAX], exe[PATH_MAX], *s;
+	unsigned long start, end, offset;
+	ssize_t len;
+	FILE *fp;
+
+	*mapstartp = 0;
+	len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+	exe[len < 0 ? 0 : len] = '\0';
+	fp = fopen("/proc/self/maps", "r");
+	if (fp == NULL)
+		return;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		path[0] = '\0';
+		if (sscanf(line, "%lx-%lx %7s %lx %*s %*s %1023s", &start,
+		    &end, perms, &offset, path) < 4)
+			continue;
+		if (strcmp(path, exe) == 0) {
+			if (offset == 0 && *mapstartp == 0)
+				*mapstartp = start;
+			continue;
+		}
+		if (perms[2] != 'x')
+			continue;
+		if (asprintf(&s, "[%s]", path[0] == '\0' ? "anon" :
+		    strrchr(path, '/') != NULL ? strrchr(path, '/') + 1 :
+		    path) < 0)
+			err(EX_OSERR, "FAIL: asprintf");
+		prof_sym_add(pstp, start, end - start, s);
+	}
+	fclose(fp);
+}
+
+struct prof_hit {
+	const char	*ph_name;
+	uint64_t	 ph_count;
+	int		 ph_kernel;
+};
+
+static int
+prof_hit_compare(const void *a, const void *b)
+{
+	const struct prof_hit *ha = a, *hb = b;
+
+	if (ha->ph_name != hb->ph_name)
+		return (ha->ph_name < hb->ph_name ? -1 : 1);
+	return (0);
+}
+
+static int
+prof_hit_rank(const void *a, const void *b)
+{
+	const struct prof_hit *ha = a, *hb = b;
+
+	return (ha->ph_count > hb->ph_count ? -1 :
+	    ha->ph_count < hb->ph_count);
+}
+
+void
+prof_report(void)
+{
+	struct prof_symtab kernel, user;
+	struct prof_hit *hits;
+	uint64_t count, i, n, mapstart;
+	const char *name;
+
+	count = min(prof_store->ps_count, PROF_SAMPLES_MAX);
+	printf("profile: %s every %ju, %ju samples, %ju lost%s\n",
+	    prof_event->pe_name, (uintmax_t)prof_period,
+	    (uintmax_t)prof_store->ps_count,
+	    (uintmax_t)(prof_store->ps_lost + prof_store->ps_count - count),
+	    prof_user_only ? " (user only)" : "");
+	if (count == 0)
+		return;
+	bzero(&kernel, sizeof(kernel));
+	bzero(&user, sizeof(user));
+	prof_kallsyms(&kernel);
+	prof_maps(&user, &mapstart);
+	prof_elfsyms(&user, mapstart);
+	qsort(kernel.pst_syms, kernel.pst_count, sizeof(*kernel.pst_syms),
+	    prof_sym_compare);
+	qsort(user.pst_syms, user.pst_count, sizeof(*user.pst_syms),
+	    prof_sym_compare);
+
+	/*
+	 * Attribute each sample, then count runs of the same symbol.
+	 */
+	hits = calloc(count, sizeof(*hits));
+	if (hits == NULL)
+		err(EX_OSERR, "FAIL: calloc");
+	for (i = 0; i < count; i++) {
+		hits[i].ph_kernel = prof_store->ps_kernel[i];
+		name = prof_sym_lookup(hits[i].ph_kernel ? &kernel : &user,
+		    prof_store->ps_ip[i]);
+		hits[i].ph_name = name != NULL ? name : hits[i].ph_kernel ?
+		    "[kernel]" : "[unknown]";
+		hits[i].ph_count = 1;
+	}
+	qsort(hits, count, sizeof(*hits), prof_hit_compare);
+	for (i = n = 0; i < count; i++) {
+		if (n > 0 && hits[n - 1].ph_name == hits[i].ph_name)
+			hits[n - 1].ph_count++;
+		else
+			hits[n++] = hits[i];
+	}
+	qsort(hits, n, sizeof(*hits), prof_hit_rank);
+	printf("  %6s %9s  %s\n", "%", "samples", "symbol");
+	for (i = 0; i < n && i < PROF_HOTSPOTS; i++)
+		printf("  %5.1F%% %9ju  [%c] %s\n",
+		    100.0 * hits[i].ph_count / count,
+		    (uintmax_t)hits[i].ph_count,
+		    hits[i].ph_kernel ? 'k' : 'u', hits[i].ph_name);
+	free(hits);
+}
+#endif /* WITH_PERF */
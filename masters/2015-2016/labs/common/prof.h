@@ -0,0 +1,55 @@
+/*-
+ * Copyright (c) 2026 The io and ipc benchmark contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _PROF_H_
+#define	_PROF_H_
+
+/*
+ * Sampling profiler (-X) for io and ipc; Linux perf only.  prof_parse() the
+ * option argument, prof_setup() before each run (and before any fork()),
+ * then, in each thread in the timed region, prof_open() before it,
+ * prof_begin() at its start and prof_end() at its end; prof_report() after
+ * the run.
+ */
+struct prof_event;
+extern const struct prof_event *prof_event;	/* NULL if not profiling. */
+
+/*
+ * A thread's sampling event and its ring.
+ */
+struct prof_state {
+	int	 pr_fd;
+	void	*pr_ring;
+};
+
+int	prof_parse(char *spec);
+void	prof_setup(void);
+void	prof_open(struct prof_state *prp);
+void	prof_begin(struct prof_state *prp);
+void	prof_end(struct prof_state *prp);
+void	prof_report(void);
+
+#endif /* !_PROF_H_ */
@@ -0,0 +1,113 @@
+/*-
+ * Copyright (c) 2026 The io and ipc benchmark contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <err.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+#include <time.h>
+
+#include "sampler.h"
+
+/*
+ * Periodic sampler, shared by io's and ipc's -I and ipc's -y.  The sampling
+ * thread keeps to absolute deadlines, so that the time taken to sample does
+ * not accumulate as drift, and writes into a ring that is allocated and
+ * faulted in before the first run, so that sampling neither allocates nor
+ * takes page faults inside the timed region.
+ */
+static void *
+sampler_thread(void *arg)
+{
+	struct sampler *sp = arg;
+	struct timespec next, now;
+
+	if (clock_gettime(CLOCK_REALTIME, &next) < 0)
+		err(EX_OSERR, "FAIL: clock_gettime");
+	while (!__atomic_load_n(&sp->sp_stop, __ATOMIC_ACQUIRE)) {
+		if (clock_gettime(CLOCK_REALTIME, &now) < 0)
+			err(EX_OSERR, "FAIL: clock_gettime");
+		sp->sp_sample(sampler_slot(sp, sp->sp_count), now, sp->sp_arg);
+		sp->sp_count++;
+
+		next.tv_nsec += sp->sp_interval;
+		while (next.tv_nsec >= 1000000000) {
+			next.tv_sec++;
+			next.tv_nsec -= 1000000000;
+		}
+		while (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &next,
+		    NULL) == EINTR);
+	}
+	return (NULL);
+}
+
+/*
+ * Start sampling every 'interval_ns' into a ring of 'ringsize' slots of
+ * 'size' bytes, calling 'sample' with 'arg'.  The ring is kept for later
+ * runs, which must use the same 'size' and 'ringsize'.
+ */
+void
+sampler_start(struct sampler *sp, long interval_ns, size_t size,
+    long ringsize, sampler_fn *sample, void *arg)
+{
+
+	if (sp->sp_ring == NULL) {
+		sp->sp_ring = calloc(ringsize, size);
+		if (sp->sp_ring == NULL)
+			err(EX_OSERR, "FAIL: calloc");
+		memset(sp->sp_ring, 0xff, ringsize * size);
+		sp->sp_size = size;
+		sp->sp_ringsize = ringsize;
+	}
+	sp->sp_sample = sample;
+	sp->sp_arg = arg;
+	sp->sp_interval = interval_ns;
+	sp->sp_count = 0;
+	sp->sp_stop = 0;
+	if (pthread_create(&sp->sp_thread, NULL, sampler_thread, sp) != 0)
+		err(EX_OSERR, "FAIL: pthread_create");
+}
+
+void
+sampler_stop(struct sampler *sp)
+{
+
+	__atomic_store_n(&sp->sp_stop, 1, __ATOMIC_RELEASE);
+	if (pthread_join(sp->sp_thread, NULL) != 0)
+		err(EX_OSERR, "FAIL: pthread_join");
+}
+
+/*
+ * The slot that holds, or will hold, sample 'n'.
+ */
+void *
+sampler_slot(const struct sampler *sp, long n)
+{
+
+	return ((char *)sp->sp_ring + (n % sp->sp_ringsize) * sp->sp_size);
+}
@@ -0,0 +1,61 @@
+/*-
+ * Copyright (c) 2026 The io and ipc benchmark contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _SAMPLER_H_
+#define	_SAMPLER_H_
+
+#include <sys/types.h>
+
+#include <pthread.h>
+#include <time.h>
+
+/*
+ * Periodic sampler for io and ipc's time series (-I, -y).  sampler_start()
+ * before the run starts a thread that calls 'sp_sample' every interval,
+ * filling in one slot of a preallocated ring; sampler_stop() after the run
+ * joins it; then sampler_slot() gives back each of the sp_count samples
+ * still in the ring, the last sp_ringsize of them.
+ */
+typedef void	sampler_fn(void *slot, struct timespec now, void *arg);
+
+struct sampler {
+	pthread_t	 sp_thread;
+	sampler_fn	*sp_sample;
+	void		*sp_arg;
+	void		*sp_ring;
+	size_t		 sp_size;	/* Bytes per slot */
+	long		 sp_ringsize;	/* Slots */
+	long		 sp_interval;	/* Nanoseconds */
+	long		 sp_count;	/* Samples taken */
+	int		 sp_stop;
+};
+
+void	sampler_start(struct sampler *sp, long interval_ns, size_t size,
+	    long ringsize, sampler_fn *sample, void *arg);
+void	sampler_stop(struct sampler *sp);
+void	*sampler_slot(const struct sampler *sp, long n);
+
+#endif /* !_SAMPLER_H_ */
@@ -0,0 +1,237 @@
+/*-
+ * Copyright (c) 2026 The io and ipc benchmark contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+
+#include <err.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+/*
+ * Event trace (-E), shared by io and ipc.  Each traced thread records begin
+ * and end events for the system calls of its benchmark loop into its own
+ * preallocated ring, stamped with the CPU's cycle counter (the TSC on x86,
+ * the generic timer on arm64, and CLOCK_MONOTONIC elsewhere), so that
+ * recording takes no locks and no system calls.  More than one ring is
+ * put in shared pages, so that ipc's 2proc senders record into memory the
+ * parent can read; a single ring, as in io, is private.  Each holds the
+ * most recent TRACE_EVENTS / rings events.  After the
+ * run, counter ticks are converted to time against CLOCK_MONOTONIC readings
+ * taken either side, and the rings are written out as Chrome trace JSON,
+ * for chrome://tracing or Perfetto.  The cost of recording an event is
+ * measured beforehand, and reported with the estimated share of the run
+ * that it accounts for.
+ */
+#define	TRACE_EVENTS		(1024 * 1024)	/* All rings; power of two */
+#define	TRACE_CALIBRATE		(256 * 1024)	/* Events timed */
+
+const char *trace_path;
+__thread struct trace_ring *trace_ring;
+
+static const char **trace_names;	/* Indexed by event type. */
+static struct trace_ring *trace_rings;	/* NULL until set up. */
+static unsigned int trace_nrings;
+static size_t trace_len;
+static uint64_t trace_tsc0, trace_ns0;	/* Counter and time at setup. */
+static double trace_event_ns;		/* Measured cost of an event. */
+
+static uint64_t
+monotonic_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		err(EX_OSERR, "FAIL: clock_gettime");
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static double
+timespec_ns(struct timespec ts)
+{
+
+	return ((double)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+/*
+ * Time back-to-back events into a scratch ring, to estimate the cost of
+ * recording one.
+ */
+static void
+trace_calibrate(void)
+{
+	struct trace_ring scratch;
+	uint64_t start;
+	long i;
+
+	bzero(&scratch, sizeof(scratch));
+	scratch.tr_mask = 4096 - 1;
+	scratch.tr_events = calloc(scratch.tr_mask + 1,
+	    sizeof(*scratch.tr_events));
+	if (scratch.tr_events == NULL)
+		err(EX_OSERR, "FAIL: calloc");
+	trace_ring = &scratch;
+	start = monotonic_ns();
+	for (i = 0; i < TRACE_CALIBRATE / 2; i++) {
+		trace_event(TRACE_READ, TRACE_BEGIN, i);
+		trace_event(TRACE_READ, TRACE_END, i);
+	}
+	trace_event_ns = (double)(monotonic_ns() - start) / TRACE_CALIBRATE;
+	trace_ring = NULL;
+	free(scratch.tr_events);
+}
+
+/*
+ * Allocate and fault in 'nrings' rings, before the timed run; 'names' are
+ * those of the event types.
+ */
+void
+trace_setup(unsigned int nrings, const char **names)
+{
+	struct trace_event *events;
+	uint64_t size;
+	unsigned int i;
+
+	size = TRACE_EVENTS;
+	while (size > 1 && size * nrings > TRACE_EVENTS)
+		size /= 2;
+	trace_len = nrings * (sizeof(*trace_rings) + size * sizeof(*events));
+	trace_rings = mmap(NULL, trace_len, PROT_READ | PROT_WRITE,
+	    MAP_ANON | (nrings > 1 ? MAP_SHARED : MAP_PRIVATE), -1, 0);
+	if (trace_rings == MAP_FAILED)
+		err(EX_OSERR, "FAIL: mmap");
+	memset(trace_rings, 0, trace_len);
+	events = (struct trace_event *)&trace_rings[nrings];
+	for (i = 0; i < nrings; i++) {
+		trace_rings[i].tr_mask = size - 1;
+		trace_rings[i].tr_events = &events[i * size];
+	}
+	trace_nrings = nrings;
+	trace_names = names;
+	trace_calibrate();
+	trace_tsc0 = trace_tsc();
+	trace_ns0 = monotonic_ns();
+}
+
+/*
+ * Start recording this thread's events into ring 'ring', if tracing.
+ */
+void
+trace_attach(unsigned int ring, const char *name)
+{
+
+	if (trace_rings == NULL || ring >= trace_nrings)
+		return;
+	trace_ring = &trace_rings[ring];
+	trace_ring->tr_pid = getpid();
+	snprintf(trace_ring->tr_name, sizeof(trace_ring->tr_name), "%s",
+	    name);
+}
+
+void
+trace_detach(void)
+{
+
+	trace_ring = NULL;
+}
+
+/*
+ * Write the rings out as Chrome trace JSON, with times in microseconds
+ * since setup, and report what was recorded against 'elapsed', the length
+ * of the timed region, unless 'quiet'.  Rings that wrapped start at their
+ * first begin event, so that every end has a begin.
+ */
+void
+trace_write(struct timespec elapsed, int quiet)
+{
+	struct trace_ring *trp;
+	struct trace_event *tep;
+	uint64_t events, first, n, overwritten, tsc1, ns1;
+	double ns_per_tick;
+	const char *sep;
+	unsigned int i;
+	FILE *fp;
+
+	tsc1 = trace_tsc();
+	ns1 = monotonic_ns();
+	ns_per_tick = tsc1 > trace_tsc0 ?
+	    (double)(ns1 - trace_ns0) / (tsc1 - trace_tsc0) : 1;
+	fp = fopen(trace_path, "w");
+	if (fp == NULL)
+		err(EX_CANTCREAT, "FAIL: %s", trace_path);
+	fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	sep = "\n";
+	events = overwritten = 0;
+	for (i = 0; i < trace_nrings; i++) {
+		trp = &trace_rings[i];
+		if (trp->tr_count == 0)
+			continue;
+		fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\","
+		    "\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", sep,
+		    (int)trp->tr_pid, i, trp->tr_name);
+		sep = ",\n";
+		first = 0;
+		if (trp->tr_count > trp->tr_mask + 1) {
+			first = trp->tr_count - (trp->tr_mask + 1);
+			overwritten += first;
+			while (first < trp->tr_count &&
+			    trp->tr_events[first & trp->tr_mask].te_phase !=
+			    TRACE_BEGIN)
+				first++;
+		}
+		for (n = first; n < trp->tr_count; n++) {
+			tep = &trp->tr_events[n & trp->tr_mask];
+			fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"%s\","
+			    "\"pid\":%d,\"tid\":%u,\"ts\":%.3F,"
+			    "\"args\":{\"%s\":%jd}}", sep,
+			    trace_names[tep->te_type],
+			    tep->te_phase == TRACE_BEGIN ? "B" : "E",
+			    (int)trp->tr_pid, i, ((double)tep->te_tsc -
+			    trace_tsc0) * ns_per_tick / 1000,
+			    tep->te_phase == TRACE_BEGIN ? "size" : "result",
+			    (intmax_t)tep->te_arg);
+		}
+		events += trp->tr_count;
+	}
+	fprintf(fp, "\n]}\n");
+	if (fclose(fp) != 0)
+		err(EX_IOERR, "FAIL: %s", trace_path);
+	if (!quiet)
+		printf("trace: %ju events (%ju overwritten) to %s; "
+		    "%.1F ns/event, ~%.2F%% of the timed region\n",
+		    (uintmax_t)events, (uintmax_t)overwritten, trace_path,
+		    trace_event_ns, 100.0 * events * trace_event_ns /
+		    timespec_ns(elapsed));
+	munmap(trace_rings, trace_len);
+	trace_rings = NULL;
+}
@@ -0,0 +1,105 @@
+/*-
+ * Copyright (c) 2026 The io and ipc benchmark contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _TRACE_H_
+#define	_TRACE_H_
+
+#include <sys/types.h>
+
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Event trace (-E) for io and ipc.  trace_setup() before the timed run,
+ * naming the event types; trace_attach() in each traced thread, which then
+ * brackets its system calls with trace_event(), and trace_detach(); then
+ * trace_write() after the run.  Types 0 to TRACE_WRITE are common; callers
+ * may add their own after them.
+ */
+#define	TRACE_BEGIN		0
+#define	TRACE_END		1
+
+#define	TRACE_BENCHMARK		0
+#define	TRACE_READ		1
+#define	TRACE_WRITE		2
+
+struct trace_event {
+	uint64_t	te_tsc;
+	int64_t		te_arg;		/* Size (begin) or result (end). */
+	uint32_t	te_type;
+	uint32_t	te_phase;
+};
+
+struct trace_ring {
+	pid_t		tr_pid;
+	char		tr_name[20];
+	uint64_t	tr_count;	/* Events recorded */
+	uint64_t	tr_mask;	/* Ring size - 1 */
+	struct trace_event *tr_events;
+};
+
+extern const char *trace_path;		/* NULL if not tracing. */
+extern __thread struct trace_ring *trace_ring;	/* This thread's ring. */
+
+static __inline uint64_t
+trace_tsc(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return (__builtin_ia32_rdtsc());
+#elif defined(__aarch64__)
+	uint64_t cnt;
+
+	__asm __volatile("mrs %0, cntvct_el0" : "=r" (cnt));
+	return (cnt);
+#else
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+#endif
+}
+
+static __inline void
+trace_event(unsigned int type, unsigned int phase, int64_t arg)
+{
+	struct trace_ring *trp = trace_ring;
+	struct trace_event *tep;
+
+	if (trp == NULL)
+		return;
+	tep = &trp->tr_events[trp->tr_count++ & trp->tr_mask];
+	tep->te_tsc = trace_tsc();
+	tep->te_arg = arg;
+	tep->te_type = type;
+	tep->te_phase = phase;
+}
+
+void	trace_setup(unsigned int nrings, const char **names);
+void	trace_attach(unsigned int ring, const char *name);
+void	trace_detach(void);
+void	trace_write(struct timespec elapsed, int quiet);
+
+#endif /* !_TRACE_H_ */
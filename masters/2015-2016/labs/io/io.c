@@ -24,17 +24,36 @@
  * SUCH DAMAGE.
  */
 
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 
 #include <err.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sysexits.h>
 #include <time.h>
 #include <unistd.h>
 
+#ifdef WITH_USDT
+#include "io_probes.h"
+#endif
+#include "calibrate.h"
+#include "duration.h"
+#include "osacct.h"
+#include "trace.h"
+#ifdef WITH_PERF
+#include "prof.h"
+#endif
+
 /*
  * L41: Lab 1 - I/O tracing
  *
@@ -53,13 +72,35 @@
 		}							\
 	} while (0)
 
+/*
+ * USDT probes (io_probes.d).  With WITH_USDT, the probe macros come from a
+ * header generated by dtrace -h, whether DTrace's on FreeBSD or SystemTap's
+ * (using sys/sdt.h) on Linux; otherwise they compile away.  Every probe is
+ * guarded by its is-enabled test, so that a disabled probe costs no more
+ * than a predicted branch.
+ */
+#ifndef WITH_USDT
+#define	IOBENCH_BENCHMARK_START_ENABLED()	0
+#define	IOBENCH_BENCHMARK_START(buffersize, totalsize)	do { } while (0)
+#define	IOBENCH_BENCHMARK_END_ENABLED()		0
+#define	IOBENCH_BENCHMARK_END()			do { } while (0)
+#define	IOBENCH_READ_ENABLED()			0
+#define	IOBENCH_READ(fd, size, result)		do { } while (0)
+#define	IOBENCH_WRITE_ENABLED()			0
+#define	IOBENCH_WRITE(fd, size, result)		do { } while (0)
+#define	IOBENCH_FSYNC_ENABLED()			0
+#define	IOBENCH_FSYNC(fd, result)		do { } while (0)
+#endif
+
 #define	BLOCKSIZE	(16 * 1024UL)
 #define	TOTALSIZE	(16 * 1024 * 1024UL)
 
 static unsigned int Bflag;	/* bare */
+static unsigned int Cflag;	/* calibrate (and subtract if > 1) */
 static unsigned int cflag;	/* create */
 static unsigned int dflag;	/* O_DIRECT */
 static unsigned int qflag;	/* quiet */
+static unsigned int Rflag;	/* OS resource accounting */
 static unsigned int rflag;	/* read() */
 static unsigned int sflag;	/* fsync() */
 static unsigned int vflag;	/* verbose */
@@ -68,6 +109,35 @@ static unsigned int wflag;	/* write() */
 static long buffersize;		/* I/O buffer size */
 static long totalsize;		/* total I/O size; multiple of buffer size */
 
+/*
+ * Event types for the event trace (-E), after the common ones.
+ */
+#define	TRACE_FSYNC		3
+#define	TRACE_TYPES		4
+
+static const char *trace_names[TRACE_TYPES] = {
+	"benchmark", "read", "write", "fsync"
+};
+
+/*
+ * Null system calls for calibration (-C).
+ */
+static void
+calibrate_read(int fd, void *buf)
+{
+
+	if (read(fd, buf, 0) < 0)
+		err(EX_IOERR, "FAIL: read");
+}
+
+static void
+calibrate_write(int fd, void *buf)
+{
+
+	if (write(fd, buf, 0) < 0)
+		err(EX_IOERR, "FAIL: write");
+}
+
 /*
  * Print usage message and exit.
  */
@@ -76,8 +146,12 @@ usage(void)
 {
 
 	fprintf(stderr,
-	    "%s -c|-r|-w [-Bdqsv] [-b buffersize] [-t totalsize] path\n",
-	    PROGNAME);
+	    "%s -c|-r|-w [-BCdqRsv] [-b buffersize] [-E tracefile] [-I msec]\n"
+	    "    [-T seconds] [-t totalsize] "
+#ifdef WITH_PERF
+	    "[-X event[:period]] "
+#endif
+	    "path\n", PROGNAME);
 	fprintf(stderr,
   "\n"
   "Modes (pick one):\n"
@@ -87,13 +161,31 @@ usage(void)
   "\n"
   "Optional flags:\n"
   "    -B              Run in bare mode: no preparatory activities\n"
+  "    -b buffersize   Specify a buffer size (default: %ld)\n"
+  "    -C              Calibrate: measure clock reads, the empty loop and a\n"
+  "                    zero-length read()/write(), and estimate the harness\n"
+  "                    overhead; -CC also subtracts it\n"
   "    -d              Set O_DIRECT flag to bypass buffer cache\n"
+  "    -E tracefile    Record the benchmark's system calls, and write them\n"
+  "                    out as a Chrome trace (JSON) timeline\n"
+  "    -I msec         Report throughput every msec as a time series\n"
+  "                    after the run\n"
   "    -q              Just run the benchmark, don't print stuff out\n"
+  "    -R              Report OS resource accounting for the timed run:\n"
+  "                    rusage, and on Linux /proc/self/io, diskstats and\n"
+  "                    system-wide vmstat deltas\n"
   "    -s              Call fsync() on the file descriptor when complete\n"
-  "    -v              Provide a verbose benchmark description\n"
-  "    -b buffersize    Specify a buffer size (default: %ld)\n"
-  "    -t totalsize    Specify total I/O size (default: %ld)\n",
+  "    -T seconds      Run for this long, cycling through totalsize bytes\n"
+  "    -t totalsize    Specify total I/O size (default: %ld)\n"
+  "    -v              Provide a verbose benchmark description\n",
 	    BLOCKSIZE, TOTALSIZE);
+#ifdef WITH_PERF
+	fprintf(stderr,
+  "    -X event[:period]  Profile the timed region, sampling every period\n"
+  "                    events; report the hottest symbols. Events:\n"
+  "                      cycles, instructions, cache-misses,\n"
+  "                      cpu-clock (period in ns)\n");
+#endif
 	exit(EX_USAGE);
 }
 
@@ -106,11 +198,18 @@ static void
 io(const char *path)
 {
 	struct timespec ts_start, ts_finish;
-	long blockcount, i;
+	long blockcount, bytes, i;
 	char *buf;
 	ssize_t len;
-	int fd;
+	int fd, ret;
 	double secs, rate;
+	struct osacct oa_before, oa_after;
+	struct calibrate_call cc;
+	char counts[32];
+	long calls;
+#ifdef WITH_PERF
+	struct prof_state pr;
+#endif
 
 	if (totalsize % buffersize != 0)
 		errx(EX_USAGE, "FAIL: data size (%ld) is not a multiple of "
@@ -178,43 +277,126 @@ io(const char *path)
 	 * look only at clock_gettime() system calls from the benchmark as
 	 * other threads in the system may use the call as well!
 	 */
+#ifdef WITH_PERF
+	if (prof_event != NULL) {
+		prof_setup();
+		prof_open(&pr);
+	}
+#endif
+	if (Cflag) {
+		cc.cc_name = wflag ? "null write()" : "null read()";
+		cc.cc_call = wflag ? calibrate_write : calibrate_read;
+		cc.cc_fd = fd;
+		calibrate(&cc, 1, buf, buffersize);
+	}
+	if (trace_path != NULL) {
+		trace_setup(1, trace_names);
+		trace_attach(0, "io");
+	}
+	if (Rflag)
+		osacct_begin(&oa_before, fd);
+	if (duration_secs != 0)
+		duration_setup();
+	if (interval_ms != 0)
+		interval_start();
 	if (clock_gettime(CLOCK_REALTIME, &ts_start) < 0)
 		errx(EX_OSERR, "FAIL: clock_gettime");
+	if (duration_secs != 0)
+		duration_arm();
+#ifdef WITH_PERF
+	if (prof_event != NULL)
+		prof_begin(&pr);
+#endif
 
 	/*
 	 * HERE BEGINS THE BENCHMARK.
 	 */
+	if (IOBENCH_BENCHMARK_START_ENABLED())
+		IOBENCH_BENCHMARK_START(buffersize, totalsize);
+	bytes = 0;
+	trace_event(TRACE_BENCHMARK, TRACE_BEGIN, totalsize);
 	for (i = 0; i < blockcount; i++) {
-		if (wflag)
+		if (wflag) {
+			trace_event(TRACE_WRITE, TRACE_BEGIN, buffersize);
 			len = write(fd, buf, buffersize);
-		else
+			trace_event(TRACE_WRITE, TRACE_END, len);
+			if (IOBENCH_WRITE_ENABLED())
+				IOBENCH_WRITE(fd, buffersize, len);
+		} else {
+			trace_event(TRACE_READ, TRACE_BEGIN, buffersize);
 			len = read(fd, buf, buffersize);
+			trace_event(TRACE_READ, TRACE_END, len);
+			if (IOBENCH_READ_ENABLED())
+				IOBENCH_READ(fd, buffersize, len);
+		}
 		if (len < 0)
 			err(EX_IOERR, "FAIL: %s", wflag ? "write" : "read");
 		if (len != buffersize)
 			errx(EX_IOERR, "FAIL: partial %s", wflag ? "write" :
 			    "read");
+		bytes += len;
+		if (interval_ms != 0)
+			__atomic_store_n(&benchmark_bytes, bytes,
+			    __ATOMIC_RELAXED);
+		if (duration_secs == 0)
+			continue;
+		if (duration_expired)
+			break;
+
+		/*
+		 * With -T, rather than stopping after totalsize, go back to
+		 * the start of the file and round again: an lseek() per pass.
+		 */
+		if (i == blockcount - 1) {
+			if (lseek(fd, 0, SEEK_SET) < 0)
+				err(EX_IOERR, "FAIL: lseek");
+			i = -1;
+		}
 	}
-	if (sflag)
-		fsync(fd);
+	benchmark_bytes = bytes;
+	if (sflag) {
+		trace_event(TRACE_FSYNC, TRACE_BEGIN, 0);
+		ret = fsync(fd);
+		trace_event(TRACE_FSYNC, TRACE_END, ret);
+		if (IOBENCH_FSYNC_ENABLED())
+			IOBENCH_FSYNC(fd, ret);
+		if (ret < 0)
+			err(EX_IOERR, "FAIL: fsync");
+	}
+	trace_event(TRACE_BENCHMARK, TRACE_END, bytes);
+	trace_detach();
 	/*
 	 * HERE ENDS THE BENCHMARK.
 	 */
+	if (IOBENCH_BENCHMARK_END_ENABLED())
+		IOBENCH_BENCHMARK_END();
+#ifdef WITH_PERF
+	if (prof_event != NULL)
+		prof_end(&pr);
+#endif
 
 	if (clock_gettime(CLOCK_REALTIME, &ts_finish) < 0)
 		errx(EX_OSERR, "FAIL: clock_gettime");
+	if (interval_ms != 0)
+		interval_finish();
+	if (Rflag)
+		osacct_end(&oa_after, fd);
 
 	/*
 	 * Now we can disruptively print things -- if we're not in quiet mode.
 	 */
+	timespecsub(&ts_finish, &ts_start);
 	if (!qflag) {
-		timespecsub(&ts_finish, &ts_start);
 
 		if (vflag) {
 			printf("Benchmark configuration:\n");
 			printf("  buffersize: %ld\n", buffersize);
 			printf("  totalsize: %ld\n", totalsize);
 			printf("  blockcount: %ld\n", blockcount);
+			if (duration_secs != 0) {
+				printf("  duration: %ld\n", duration_secs);
+				printf("  bytes: %ld\n", benchmark_bytes);
+			}
 			printf("  operation: %s\n", cflag ? "create" :
 			    (wflag ? "write" : "read"));
 			printf("  path: %s\n", path);
@@ -228,13 +410,30 @@ io(const char *path)
 		    1000000000;
 
 		/* Bytes/second. */
-		rate = totalsize / secs;
+		rate = benchmark_bytes / secs;
 
 		/* Kilobytes/second. */
 		rate /= (1024);
 
 		printf("%.2F KBytes/sec\n", rate);
+		if (Cflag) {
+			calls = benchmark_bytes / buffersize;
+			snprintf(counts, sizeof(counts), "%ld calls", calls);
+			calibrate_print(ts_finish, benchmark_bytes,
+			    calibrate_harness(0, calls), counts, Cflag > 1);
+		}
+		if (interval_ms != 0)
+			interval_print(ts_start, ts_finish);
+		if (Rflag)
+			osacct_print(&oa_before, &oa_after, benchmark_bytes,
+			    rflag);
+#ifdef WITH_PERF
+		if (prof_event != NULL)
+			prof_report();
+#endif
 	}
+	if (trace_path != NULL)
+		trace_write(ts_finish, qflag);
 	close(fd);
 }
 
@@ -251,7 +450,11 @@ main(int argc, char *argv[])
 	buffersize = BLOCKSIZE;
 	totalsize = TOTALSIZE;
 	path = NULL;
-	while ((ch = getopt(argc, argv, "Bb:cdqrst:vw")) != -1) {
+	while ((ch = getopt(argc, argv, "Bb:CcdE:I:qRrsT:t:vw"
+#ifdef WITH_PERF
+	    "X:"
+#endif
+	    )) != -1) {
 		switch (ch) {
 		case 'B':
 			Bflag++;
@@ -263,6 +466,10 @@ main(int argc, char *argv[])
 				usage();
 			break;
 
+		case 'C':
+			Cflag++;
+			break;
+
 		case 'c':
 			cflag++;
 			break;
@@ -271,10 +478,25 @@ main(int argc, char *argv[])
 			dflag++;
 			break;
 
+		case 'E':
+			trace_path = optarg;
+			break;
+
+		case 'I':
+			interval_ms = strtol(optarg, &endp, 10);
+			if (*optarg == '\0' || *endp != '\0' ||
+			    interval_ms <= 0 || interval_ms >= 1000000)
+				usage();
+			break;
+
 		case 'q':
 			qflag++;
 			break;
 
+		case 'R':
+			Rflag++;
+			break;
+
 		case 'r':
 			rflag++;
 			break;
@@ -283,6 +505,13 @@ main(int argc, char *argv[])
 			sflag++;
 			break;
 
+		case 'T':
+			duration_secs = strtol(optarg, &endp, 10);
+			if (*optarg == '\0' || *endp != '\0' ||
+			    duration_secs <= 0)
+				usage();
+			break;
+
 		case 't':
 			totalsize = strtol(optarg, &endp, 10);
 			if (*optarg == '\0' || *endp != '\0' || totalsize <= 0)
@@ -297,6 +526,13 @@ main(int argc, char *argv[])
 			wflag++;
 			break;
 
+#ifdef WITH_PERF
+		case 'X':
+			if (prof_parse(optarg) < 0)
+				usage();
+			break;
+#endif
+
 		case '?':
 		default:
 			usage();
@@ -314,8 +550,14 @@ main(int argc, char *argv[])
 	 * reject if we find any.  However, we then force some flags on to
 	 * control behaviour in io() -- i.e., to write().
 	 */
-	if (cflag && (Bflag || dflag || qflag || rflag || sflag || vflag))
+	if (cflag && (Bflag || Cflag || dflag || qflag || Rflag || rflag ||
+	    sflag || vflag || duration_secs != 0 || interval_ms != 0 ||
+	    trace_path != NULL))
+		usage();
+#ifdef WITH_PERF
+	if (cflag && prof_event != NULL)
 		usage();
+#endif
 	if (cflag) {
 		Bflag = 1;	/* Don't do benchmark prep. */
 		vflag = 1;	/* Provide status information. */
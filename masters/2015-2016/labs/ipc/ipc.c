@@ -28,21 +28,63 @@
 #include <sys/types.h>
 #include <sys/time.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/select.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 
 #include <netinet/in.h>
+#ifdef __linux__
+#include <linux/tcp.h>	/* struct tcp_info with delivery rate */
+#else
+#include <netinet/tcp.h>
+#endif
+
+#include <arpa/inet.h>
+
+#ifdef __linux__
+#include <linux/errqueue.h>
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+#ifdef WITH_IO_URING
+#include <linux/io_uring.h>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef WITH_USDT
+#include "ipc_probes.h"
+#endif
+#include "calibrate.h"
+#include "duration.h"
+#include "osacct.h"
+#include "sampler.h"
+#include "trace.h"
+#ifdef WITH_PERF
+#include "prof.h"
+#endif
 
 #include <assert.h>
 #include <err.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <limits.h>
+#include <math.h>
 #ifdef WITH_PMC
 #include <pmc.h>
 #endif
+#include <poll.h>
 #include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -68,10 +110,54 @@
 		}							\
 	} while (0)
 
+/*
+ * USDT probes (ipc_probes.d).  With WITH_USDT, the probe macros come from
+ * a header generated by dtrace -h, whether DTrace's on FreeBSD or
+ * SystemTap's (using sys/sdt.h) on Linux; otherwise they compile away.
+ * Every probe is guarded by its is-enabled test, so that a disabled probe
+ * costs no more than a predicted branch.
+ */
+#ifndef WITH_USDT
+#define	IPCBENCH_BENCHMARK_START_ENABLED()	0
+#define	IPCBENCH_BENCHMARK_START(mode, ipctype, buffersize, totalsize)	\
+	do { } while (0)
+#define	IPCBENCH_BENCHMARK_END_ENABLED()	0
+#define	IPCBENCH_BENCHMARK_END()		do { } while (0)
+#define	IPCBENCH_READ_ENABLED()			0
+#define	IPCBENCH_READ(fd, size, result)		do { } while (0)
+#define	IPCBENCH_WRITE_ENABLED()		0
+#define	IPCBENCH_WRITE(fd, size, result)	do { } while (0)
+#define	IPCBENCH_SELECT_WAKEUP_ENABLED()	0
+#define	IPCBENCH_SELECT_WAKEUP(nready)		do { } while (0)
+#define	IPCBENCH_PMC_BEGIN_ENABLED()		0
+#define	IPCBENCH_PMC_BEGIN()			do { } while (0)
+#define	IPCBENCH_PMC_END_ENABLED()		0
+#define	IPCBENCH_PMC_END()			do { } while (0)
+#endif
+
+#define	timespecadd(vvp, uvp)						\
+	do {								\
+		(vvp)->tv_sec += (uvp)->tv_sec;				\
+		(vvp)->tv_nsec += (uvp)->tv_nsec;			\
+		if ((vvp)->tv_nsec >= 1000000000) {			\
+			(vvp)->tv_sec++;				\
+			(vvp)->tv_nsec -= 1000000000;			\
+		}							\
+	} while (0)
+
 static unsigned int Bflag;	/* bare */
+static unsigned int Cflag;	/* calibrate (and subtract if > 1) */
+static unsigned int Hflag;	/* per-chunk sequence/timestamp headers */
+static unsigned int Lflag;	/* connrate: one shared accept queue */
+static unsigned int lflag;	/* busy-poll receiver (and sender if > 1) */
+#ifdef WITH_IO_URING
+static unsigned int Sflag;	/* io_uring kernel submission polling */
+#endif
 static unsigned int qflag;	/* quiet */
+static unsigned int Rflag;	/* OS resource accounting */
 static unsigned int sflag;	/* set socket-buffer sizes */
 static unsigned int vflag;	/* verbose */
+static unsigned int Wflag;	/* sweep option values */
 
 /*
  * Which mode is the benchmark operating in?
@@ -80,11 +166,21 @@ static unsigned int vflag;	/* verbose */
 #define	BENCHMARK_MODE_1THREAD_STRING	"1thread"
 #define	BENCHMARK_MODE_2THREAD_STRING	"2thread"
 #define	BENCHMARK_MODE_2PROC_STRING	"2proc"
+#define	BENCHMARK_MODE_CONNRATE_STRING	"connrate"
+#define	BENCHMARK_MODE_SERVER_STRING	"server"
+#define	BENCHMARK_MODE_CLIENT_STRING	"client"
+#define	BENCHMARK_MODE_SCENARIO_STRING	"scenario"
+#define	BENCHMARK_MODE_SPAWN_STRING	"spawn"
 
 #define	BENCHMARK_MODE_INVALID		-1
 #define	BENCHMARK_MODE_1THREAD		1
 #define	BENCHMARK_MODE_2THREAD		2
 #define	BENCHMARK_MODE_2PROC		3
+#define	BENCHMARK_MODE_CONNRATE		4
+#define	BENCHMARK_MODE_SERVER		5
+#define	BENCHMARK_MODE_CLIENT		6
+#define	BENCHMARK_MODE_SCENARIO		7
+#define	BENCHMARK_MODE_SPAWN		8
 
 #define	BENCHMARK_MODE_DEFAULT		BENCHMARK_MODE_1THREAD
 static unsigned int benchmark_mode = BENCHMARK_MODE_DEFAULT;
@@ -93,27 +189,241 @@ static unsigned int benchmark_mode = BENCHMARK_MODE_DEFAULT;
 #define	BENCHMARK_IPC_PIPE_STRING	"pipe"
 #define	BENCHMARK_IPC_LOCAL_SOCKET_STRING	"local"
 #define	BENCHMARK_IPC_TCP_SOCKET_STRING		"tcp"
+#define	BENCHMARK_IPC_UDP_SOCKET_STRING		"udp"
+#define	BENCHMARK_IPC_LOCAL_DGRAM_STRING	"dgram"
+#define	BENCHMARK_IPC_LOCAL_SEQPACKET_STRING	"seqpacket"
 
 #define	BENCHMARK_IPC_INVALID		-1
 #define	BENCHMARK_IPC_PIPE		1
 #define	BENCHMARK_IPC_LOCAL_SOCKET		2
 #define	BENCHMARK_IPC_TCP_SOCKET		3
+#define	BENCHMARK_IPC_UDP_SOCKET		4
+#define	BENCHMARK_IPC_LOCAL_DGRAM		5
+#define	BENCHMARK_IPC_LOCAL_SEQPACKET		6
 
 #define	BENCHMARK_IPC_DEFAULT		BENCHMARK_IPC_PIPE
 static unsigned int ipc_type = BENCHMARK_IPC_DEFAULT;
 
+/*
+ * How does the benchmark move data in the 2-thread/2-proc sender and
+ * receiver loops?  Either with one blocking read()/write() system call per
+ * iteration, or (on Linux) by queueing batches of operations to io_uring,
+ * by splicing pages into and out of a pipe rather than copying them, or by
+ * sending with MSG_ZEROCOPY over TCP.
+ */
+#define	BENCHMARK_ENGINE_INVALID_STRING	"invalid"
+#define	BENCHMARK_ENGINE_RW_STRING	"rw"
+#define	BENCHMARK_ENGINE_URING_STRING	"uring"
+#define	BENCHMARK_ENGINE_VMSPLICE_STRING	"vmsplice"
+#define	BENCHMARK_ENGINE_SPLICE_STRING	"splice"
+#define	BENCHMARK_ENGINE_ZEROCOPY_STRING	"zerocopy"
+
+#define	BENCHMARK_ENGINE_INVALID	-1
+#define	BENCHMARK_ENGINE_RW		1
+#define	BENCHMARK_ENGINE_URING		2
+#define	BENCHMARK_ENGINE_VMSPLICE	3
+#define	BENCHMARK_ENGINE_SPLICE		4
+#define	BENCHMARK_ENGINE_ZEROCOPY	5
+
+#define	BENCHMARK_ENGINE_DEFAULT	BENCHMARK_ENGINE_RW
+static unsigned int benchmark_engine = BENCHMARK_ENGINE_DEFAULT;
+
 #define	BENCHMARK_TCP_PORT_DEFAULT	10141
 static unsigned short tcp_port = BENCHMARK_TCP_PORT_DEFAULT;
 
+/*
+ * IPv4 address used by the TCP and UDP IPC types: bound by the receiver (or
+ * server), and connected to by the sender (or client).
+ */
+#define	BENCHMARK_TCP_ADDR_DEFAULT	"127.0.0.1"
+static const char *tcp_addr_string = BENCHMARK_TCP_ADDR_DEFAULT;
+static struct in_addr tcp_addr;
+
 #define	BUFFERSIZE	(128 * 1024UL)
 static long buffersize = BUFFERSIZE;	/* I/O buffer size */
 
 #define	TOTALSIZE	(16 * 1024 * 1024UL)
 static long totalsize = TOTALSIZE;	/* total I/O size */
 
+#ifdef F_SETPIPE_SZ
+static long pipe_capacity;		/* pipe capacity; 0 for default */
+#endif
+
+/* Connection-rate (connrate) mode parameters. */
+#define	CONNRATE_CLIENTS_DEFAULT	1
+#define	CONNRATE_ACCEPTORS_DEFAULT	1
+#define	CONNRATE_THREADS_MAX		256
+#define	CONNRATE_MSGSIZE		64
+
+static unsigned int connrate_clients = CONNRATE_CLIENTS_DEFAULT;
+static unsigned int connrate_acceptors = CONNRATE_ACCEPTORS_DEFAULT;
+
+/* Iterations (-n): connections in connrate mode, creations in spawn mode. */
+#define	ITERATIONS_DEFAULT		10000
+static long iterations = ITERATIONS_DEFAULT;
+
+/*
+ * Process and thread creation (spawn) mode parameters.  The count of
+ * creations is given by -n, as for connrate.
+ */
+#define	SPAWN_METHOD_INVALID_STRING	"invalid"
+#define	SPAWN_METHOD_FORK_STRING	"fork"
+#define	SPAWN_METHOD_VFORK_STRING	"vfork"
+#define	SPAWN_METHOD_POSIX_SPAWN_STRING	"posix_spawn"
+#define	SPAWN_METHOD_PTHREAD_STRING	"pthread"
+#define	SPAWN_METHOD_CLONE_STRING	"clone"
+#define	SPAWN_METHOD_FORKEXEC_STRING	"forkexec"
+#define	SPAWN_METHOD_VFORKEXEC_STRING	"vforkexec"
+
+#define	SPAWN_METHOD_INVALID		-1
+#define	SPAWN_METHOD_FORK		1
+#define	SPAWN_METHOD_VFORK		2
+#define	SPAWN_METHOD_POSIX_SPAWN	3
+#define	SPAWN_METHOD_PTHREAD		4
+#define	SPAWN_METHOD_CLONE		5
+#define	SPAWN_METHOD_FORKEXEC		6
+#define	SPAWN_METHOD_VFORKEXEC		7
+
+#define	SPAWN_METHOD_DEFAULT		SPAWN_METHOD_FORK
+static int spawn_method = SPAWN_METHOD_DEFAULT;
+static const char *spawn_target;	/* exec target; NULL for ourselves */
+static const char *spawn_self;		/* ourselves, as invoked */
+static long spawn_rss;			/* parent resident bytes (-r) */
+
+extern char **environ;
+
+/*
+ * Given as the only argument, makes us exit at once: the default target
+ * of the exec methods, so that they measure exec() itself, run-time
+ * linking and C start-up, and nothing else.
+ */
+#define	SPAWN_EXIT_ARG			"spawn-exit"
+#define	SPAWN_CLONE_STACKSIZE		(64 * 1024)
+
+/* Fan-in (-k) producer count; 0 if not fanning in. */
+#define	FANIN_PRODUCERS_MAX		1024
+
+static unsigned int fanin_producers;
+
 #define	max(x, y)	((x) > (y) ? (x) : (y))
 #define	min(x, y)	((x) < (y) ? (x) : (y))
 
+static double
+timespec_ns(struct timespec ts)
+{
+
+	return ((double)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static uint64_t
+monotonic_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		err(EX_OSERR, "FAIL: clock_gettime");
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static uint64_t
+thread_cpu_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) < 0)
+		err(EX_OSERR, "FAIL: clock_gettime");
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static int
+uint64_compare(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x < y ? -1 : x > y);
+}
+
+/*
+ * Event types for the event trace (-E), after the common ones.
+ */
+#define	TRACE_SELECT		3
+#define	TRACE_TYPES		4
+
+static const char *trace_names[TRACE_TYPES] = {
+	"benchmark", "read", "write", "select"
+};
+
+/*
+ * Busy polling (-l).  The receiver -- and with -ll, the sender too -- puts
+ * its descriptor into non-blocking mode and spins on EAGAIN rather than
+ * sleeping in the kernel, as latency-critical consumers on dedicated cores
+ * do.  Each spell of spinning is timed in thread CPU time, from its first
+ * EAGAIN to the next successful call, costing two clock reads per spell
+ * rather than per call: the CPU wasted spinning, which unlike wall-clock
+ * time excludes any time the spinning thread was preempted.  For TCP,
+ * -O busy_poll=usec also has the kernel poll the device queue within each
+ * receive call.
+ */
+struct spin_stats {
+	long		 sp_spins;	/* Calls returning EAGAIN. */
+	uint64_t	 sp_spintime;	/* CPU time spent spinning (ns). */
+};
+
+static void
+spin_nonblock(int fd, int on)
+{
+	int flags;
+
+	flags = fcntl(fd, F_GETFL, 0);
+	if (flags < 0)
+		err(EX_OSERR, "FAIL: fcntl(fd, F_GETFL, 0)");
+	flags = on ? flags | O_NONBLOCK : flags & ~O_NONBLOCK;
+	if (fcntl(fd, F_SETFL, flags) < 0)
+		err(EX_OSERR, "FAIL: fcntl(fd, F_SETFL, flags)");
+}
+
+/*
+ * Account for a non-blocking call returning 'len'; true if it should simply
+ * be retried.
+ */
+static int
+spin_account(ssize_t len, uint64_t *spinstartp, struct spin_stats *spp)
+{
+
+	if (len < 0 && errno == EAGAIN) {
+		if (*spinstartp == 0)
+			*spinstartp = thread_cpu_ns();
+		spp->sp_spins++;
+		return (1);
+	}
+	if (*spinstartp != 0) {
+		spp->sp_spintime += thread_cpu_ns() - *spinstartp;
+		*spinstartp = 0;
+	}
+	return (0);
+}
+
+static void
+spin_write(int fd, const char *buf, size_t len, struct spin_stats *spp)
+{
+	uint64_t spinstart;
+	ssize_t done;
+	size_t off;
+
+	spinstart = 0;
+	for (off = 0; off < len; off += done) {
+		done = write(fd, buf + off, len - off);
+		if (IPCBENCH_WRITE_ENABLED())
+			IPCBENCH_WRITE(fd, len - off, done);
+		if (spin_account(done, &spinstart, spp)) {
+			done = 0;
+			continue;
+		}
+		if (done < 0)
+			err(EX_IOERR, "FAIL: write");
+	}
+}
+
 #ifdef WITH_PMC
 #define	COUNTERSET_MAX_EVENTS	4	/* Maximum hardware registers */
 
@@ -273,6 +583,8 @@ pmc_begin(void)
 		if (pmc_start(pmcid[i]) < 0)
 			err(EX_OSERR, "FAIL: pmc_start %s", counterset[i]);
 	}
+	if (IPCBENCH_PMC_BEGIN_ENABLED())
+		IPCBENCH_PMC_BEGIN();
 }
 
 static __inline void
@@ -280,6 +592,8 @@ pmc_end(void)
 {
 	int i;
 
+	if (IPCBENCH_PMC_END_ENABLED())
+		IPCBENCH_PMC_END();
 	for (i = 0; i < COUNTERSET_MAX_EVENTS; i++) {
 		if (counterset[i] == NULL)
 			continue;
@@ -343,406 +657,4699 @@ benchmark_pmc_to_string(int type)
 }
 #endif
 
-static int
-ipc_type_from_string(const char *string)
-{
+#ifdef WITH_PERF
+#ifdef WITH_PMC
+#error "WITH_PERF and WITH_PMC are mutually exclusive"
+#endif
+/*
+ * Linux perf_event_open(2) counters (-P).  Each named counter set is opened
+ * as one group, so that its events are always scheduled onto the PMU
+ * together and their ratios are meaningful; when more sets are requested
+ * than the hardware can count at once, the kernel multiplexes the groups,
+ * and we scale each group's counts by the ratio of its enabled to running
+ * time.  The sender and the receiver each count only themselves (any
+ * thread, or a process in 2proc mode), so that counts are attributed to one
+ * side or the other rather than merged.  Hardware sets also count cycles
+ * and instructions.  Sets that cannot be opened, as often in virtual
+ * machines, are reported as unavailable.
+ */
+#define	PERF_SET_EVENTS		4	/* Events per set */
+#define	PERF_SETS_MAX		8	/* Sets per run */
 
-	if (strcmp(BENCHMARK_IPC_PIPE_STRING, string) == 0)
-		return (BENCHMARK_IPC_PIPE);
-	else if (strcmp(BENCHMARK_IPC_LOCAL_SOCKET_STRING, string) == 0)
-		return (BENCHMARK_IPC_LOCAL_SOCKET);
-	else if (strcmp(BENCHMARK_IPC_TCP_SOCKET_STRING, string) == 0)
-		return (BENCHMARK_IPC_TCP_SOCKET);
-	else
-		return (BENCHMARK_IPC_INVALID);
-}
+#define	PERF_HW_CACHE(cache, op, result)				\
+	(PERF_COUNT_HW_CACHE_##cache | PERF_COUNT_HW_CACHE_OP_##op << 8 |	\
+	    PERF_COUNT_HW_CACHE_RESULT_##result << 16)
 
-static const char *
-ipc_type_to_string(int type)
-{
+#define	PERF_TRAILER							\
+	{ "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },	\
+	{ "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS }
 
-	switch (type) {
-	case BENCHMARK_IPC_PIPE:
-		return (BENCHMARK_IPC_PIPE_STRING);
+struct perf_event_spec {
+	const char	*pe_name;
+	uint32_t	 pe_type;
+	uint64_t	 pe_config;
+};
 
-	case BENCHMARK_IPC_LOCAL_SOCKET:
-		return (BENCHMARK_IPC_LOCAL_SOCKET_STRING);
+struct perf_counterset {
+	const char		*pcs_name;
+	struct perf_event_spec	 pcs_events[PERF_SET_EVENTS];
+};
 
-	case BENCHMARK_IPC_TCP_SOCKET:
-		return (BENCHMARK_IPC_TCP_SOCKET_STRING);
+static const struct perf_counterset perf_countersets[] = {
+	{ "llc", {
+	    { "LLC-references", PERF_TYPE_HARDWARE,
+	      PERF_COUNT_HW_CACHE_REFERENCES },
+	    { "LLC-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+	    PERF_TRAILER } },
+	{ "l1d", {
+	    { "L1-dcache-loads", PERF_TYPE_HW_CACHE,
+	      PERF_HW_CACHE(L1D, READ, ACCESS) },
+	    { "L1-dcache-load-misses", PERF_TYPE_HW_CACHE,
+	      PERF_HW_CACHE(L1D, READ, MISS) },
+	    PERF_TRAILER } },
+	{ "branch", {
+	    { "branches", PERF_TYPE_HARDWARE,
+	      PERF_COUNT_HW_BRANCH_INSTRUCTIONS },
+	    { "branch-misses", PERF_TYPE_HARDWARE,
+	      PERF_COUNT_HW_BRANCH_MISSES },
+	    PERF_TRAILER } },
+	{ "dtlb", {
+	    /* On x86, dTLB misses are those that cause page walks. */
+	    { "dTLB-load-misses", PERF_TYPE_HW_CACHE,
+	      PERF_HW_CACHE(DTLB, READ, MISS) },
+	    { "dTLB-store-misses", PERF_TYPE_HW_CACHE,
+	      PERF_HW_CACHE(DTLB, WRITE, MISS) },
+	    PERF_TRAILER } },
+	{ "ctxsw", {
+	    { "context-switches", PERF_TYPE_SOFTWARE,
+	      PERF_COUNT_SW_CONTEXT_SWITCHES },
+	    { "cpu-migrations", PERF_TYPE_SOFTWARE,
+	      PERF_COUNT_SW_CPU_MIGRATIONS },
+	    { "page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+	    { "task-clock (ns)", PERF_TYPE_SOFTWARE,
+	      PERF_COUNT_SW_TASK_CLOCK } } },
+};
+#define	PERF_COUNTERSETS						\
+	(sizeof(perf_countersets) / sizeof(perf_countersets[0]))
 
-	default:
-		return (BENCHMARK_IPC_INVALID_STRING);
-	}
-}
+static const struct perf_counterset *perf_sets[PERF_SETS_MAX];
+static unsigned int perf_nsets;		/* 0 if not counting (-P). */
+
+/*
+ * One side's counters, open for the duration of a run.
+ */
+struct perf_state {
+	int	ps_fd[PERF_SETS_MAX][PERF_SET_EVENTS];
+};
 
+/*
+ * ... and what they counted.
+ */
+struct perf_counts {
+	uint64_t	pc_value[PERF_SETS_MAX][PERF_SET_EVENTS];
+	double		pc_running[PERF_SETS_MAX];	/* Fraction counted. */
+	int		pc_valid[PERF_SETS_MAX];
+};
+
+/*
+ * Parse a comma-separated list of set names; returns -1 if invalid.
+ */
 static int
-benchmark_mode_from_string(const char *string)
+perf_parse(char *list)
 {
+	char *name;
+	unsigned int i;
+
+	while ((name = strsep(&list, ",")) != NULL) {
+		for (i = 0; i < PERF_COUNTERSETS; i++)
+			if (strcmp(name, perf_countersets[i].pcs_name) == 0)
+				break;
+		if (i == PERF_COUNTERSETS || perf_nsets == PERF_SETS_MAX)
+			return (-1);
+		perf_sets[perf_nsets++] = &perf_countersets[i];
+	}
+	return (0);
+}
 
-	if (strcmp(BENCHMARK_MODE_1THREAD_STRING, string) == 0)
-		return (BENCHMARK_MODE_1THREAD);
-	else if (strcmp(BENCHMARK_MODE_2THREAD_STRING, string) == 0)
-		return (BENCHMARK_MODE_2THREAD);
-	else if (strcmp(BENCHMARK_MODE_2PROC_STRING, string) == 0)
-		return (BENCHMARK_MODE_2PROC);
-	else
-		return (BENCHMARK_MODE_INVALID);
+static void
+perf_open(struct perf_state *psp)
+{
+	struct perf_event_attr attr;
+	const struct perf_event_spec *pep;
+	unsigned int s, e;
+	int leader;
+
+	for (s = 0; s < perf_nsets; s++) {
+		for (e = 0; e < PERF_SET_EVENTS; e++)
+			psp->ps_fd[s][e] = -1;
+		for (e = 0; e < PERF_SET_EVENTS; e++) {
+			pep = &perf_sets[s]->pcs_events[e];
+			if (pep->pe_name == NULL)
+				continue;
+			leader = psp->ps_fd[s][0];
+			bzero(&attr, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = pep->pe_type;
+			attr.config = pep->pe_config;
+			attr.disabled = (leader < 0);
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_GROUP |
+			    PERF_FORMAT_TOTAL_TIME_ENABLED |
+			    PERF_FORMAT_TOTAL_TIME_RUNNING;
+			psp->ps_fd[s][e] = syscall(__NR_perf_event_open,
+			    &attr, 0, -1, leader, 0);
+			if (psp->ps_fd[s][e] < 0) {
+				/* Lose the whole group. */
+				for (e = 0; e < PERF_SET_EVENTS; e++) {
+					if (psp->ps_fd[s][e] >= 0)
+						close(psp->ps_fd[s][e]);
+					psp->ps_fd[s][e] = -1;
+				}
+				break;
+			}
+		}
+	}
 }
 
-static const char *
-benchmark_mode_to_string(int mode)
+static void
+perf_begin(struct perf_state *psp)
 {
+	unsigned int s;
 
-	switch (mode) {
-	case BENCHMARK_MODE_1THREAD:
-		return (BENCHMARK_MODE_1THREAD_STRING);
+	for (s = 0; s < perf_nsets; s++) {
+		if (psp->ps_fd[s][0] < 0)
+			continue;
+		if (ioctl(psp->ps_fd[s][0], PERF_EVENT_IOC_RESET,
+		    PERF_IOC_FLAG_GROUP) < 0 ||
+		    ioctl(psp->ps_fd[s][0], PERF_EVENT_IOC_ENABLE,
+		    PERF_IOC_FLAG_GROUP) < 0)
+			err(EX_OSERR, "FAIL: perf enable %s",
+			    perf_sets[s]->pcs_name);
+	}
+	if (IPCBENCH_PMC_BEGIN_ENABLED())
+		IPCBENCH_PMC_BEGIN();
+}
 
-	case BENCHMARK_MODE_2THREAD:
-		return (BENCHMARK_MODE_2THREAD_STRING);
+/*
+ * Stop counting, and store scaled counts.  Also closes the counters.
+ */
+static void
+perf_end(struct perf_state *psp, struct perf_counts *pcp)
+{
+	struct {
+		uint64_t	nr;
+		uint64_t	time_enabled;
+		uint64_t	time_running;
+		uint64_t	values[PERF_SET_EVENTS];
+	} group;
+	unsigned int s, e;
+
+	if (IPCBENCH_PMC_END_ENABLED())
+		IPCBENCH_PMC_END();
+	for (s = 0; s < perf_nsets; s++)
+		if (psp->ps_fd[s][0] >= 0)
+			(void)ioctl(psp->ps_fd[s][0], PERF_EVENT_IOC_DISABLE,
+			    PERF_IOC_FLAG_GROUP);
+	bzero(pcp, sizeof(*pcp));
+	for (s = 0; s < perf_nsets; s++) {
+		if (psp->ps_fd[s][0] < 0)
+			continue;
+		if (read(psp->ps_fd[s][0], &group, sizeof(group)) < 0)
+			err(EX_IOERR, "FAIL: perf read %s",
+			    perf_sets[s]->pcs_name);
+		pcp->pc_valid[s] = 1;
+		if (group.time_running != 0) {
+			pcp->pc_running[s] = (double)group.time_running /
+			    group.time_enabled;
+			for (e = 0; e < group.nr && e < PERF_SET_EVENTS; e++)
+				pcp->pc_value[s][e] = group.values[e] /
+				    pcp->pc_running[s];
+		}
+		for (e = 0; e < PERF_SET_EVENTS; e++)
+			if (psp->ps_fd[s][e] >= 0)
+				close(psp->ps_fd[s][e]);
+	}
+}
 
-	case BENCHMARK_MODE_2PROC:
-		return (BENCHMARK_MODE_2PROC_STRING);
+/*
+ * Fold one thread's counts into another's, as for fan-in producers.
+ */
+static void
+perf_add(struct perf_counts *to, const struct perf_counts *from)
+{
+	unsigned int s, e;
 
-	default:
-		return (BENCHMARK_MODE_INVALID_STRING);
+	for (s = 0; s < perf_nsets; s++) {
+		if (!from->pc_valid[s])
+			continue;
+		if (!to->pc_valid[s])
+			to->pc_running[s] = from->pc_running[s];
+		to->pc_valid[s] = 1;
+		to->pc_running[s] = min(to->pc_running[s],
+		    from->pc_running[s]);
+		for (e = 0; e < PERF_SET_EVENTS; e++)
+			to->pc_value[s][e] += from->pc_value[s][e];
 	}
 }
 
 /*
- * Print usage message and exit.
+ * Whether the -P sets count cycles; if so, and 'pcp' is not NULL, store
+ * the count it holds in '*cyclesp'.
  */
+static int
+perf_cycles(const struct perf_counts *pcp, uint64_t *cyclesp)
+{
+	const struct perf_event_spec *pep;
+	unsigned int s, e;
+
+	for (s = 0; s < perf_nsets; s++) {
+		for (e = 0; e < PERF_SET_EVENTS; e++) {
+			pep = &perf_sets[s]->pcs_events[e];
+			if (pep->pe_name == NULL ||
+			    strcmp(pep->pe_name, "cycles") != 0)
+				continue;
+			if (pcp != NULL && pcp->pc_valid[s])
+				*cyclesp = pcp->pc_value[s][e];
+			return (1);
+		}
+	}
+	return (0);
+}
+
 static void
-usage(void)
+perf_print_side(const struct perf_counts *pcp, unsigned int s,
+    unsigned int e)
 {
 
-	fprintf(stderr,
-	    "%s [-Bqsv] [-b buffersize] [-i pipe|local|tcp] [-p tcp_port]\n\t"
-#ifdef WITH_PMC
-	    "[-P l1d|l1i|l2|mem|tlb|axi] "
-#endif
-	    "[-t totalsize] mode\n", PROGNAME);
-	fprintf(stderr,
-  "\n"
-  "Modes (pick one - default %s):\n"
-  "    1thread                IPC within a single thread\n"
-  "    2thread                IPC between two threads in one process\n"
-  "    2proc                  IPC between two threads in two different processes\n"
-  "\n"
-  "Optional flags:\n"
-  "    -B                     Run in bare mode: no preparatory activities\n"
-  "    -i pipe|local|tcp      Select pipe, local sockets, or TCP (default: %s)\n"
-  "    -p tcp_port            Set TCP port number (default: %u)\n"
-#ifdef WITH_PMC
-  "    -P l1d|l1i|l2|mem|tlb|axi  Enable hardware performance counters\n"
-#endif
-  "    -q                     Just run the benchmark, don't print stuff out\n"
-  "    -s                     Set send/receive socket-buffer sizes to buffersize\n"
-  "    -v                     Provide a verbose benchmark description\n"
-  "    -b buffersize          Specify a buffer size (default: %ld)\n"
-  "    -t totalsize           Specify total I/O size (default: %ld)\n",
-	    benchmark_mode_to_string(BENCHMARK_MODE_DEFAULT),
-	    ipc_type_to_string(BENCHMARK_IPC_DEFAULT),
-	    BENCHMARK_TCP_PORT_DEFAULT,
-	    BUFFERSIZE, TOTALSIZE);
-	exit(EX_USAGE);
+	if (pcp == NULL)
+		return;
+	if (pcp->pc_valid[s])
+		printf(" %16ju", (uintmax_t)pcp->pc_value[s][e]);
+	else
+		printf(" %16s", "unavailable");
 }
 
 /*
- * The IPC benchmark itself.
- * XXX
- *
- * The I/O benchmark itself.  Perform any necessary setup.  Open the file or
- * device.  Take a timestamp.  Perform the work.  Take another timestamp.
- * (Optionally) print the results.
+ * Print counts by set, one column per side; either may be NULL.
  */
+static void
+perf_print(const struct perf_counts *sender, const struct perf_counts *receiver)
+{
+	const struct perf_event_spec *pep;
+	unsigned int s, e;
+
+	for (s = 0; s < perf_nsets; s++) {
+		printf("perf %-19s", perf_sets[s]->pcs_name);
+		if (sender != NULL)
+			printf(" %16s", "sender");
+		if (receiver != NULL)
+			printf(" %16s", sender != NULL ? "receiver" : "thread");
+		printf("\n");
+		for (e = 0; e < PERF_SET_EVENTS; e++) {
+			pep = &perf_sets[s]->pcs_events[e];
+			if (pep->pe_name == NULL)
+				continue;
+			printf("  %-22s", pep->pe_name);
+			perf_print_side(sender, s, e);
+			perf_print_side(receiver, s, e);
+			printf("\n");
+		}
+		printf("  %-22s", "counted (%)");
+		if (sender != NULL && sender->pc_valid[s])
+			printf(" %16.1F", 100 * sender->pc_running[s]);
+		else if (sender != NULL)
+			printf(" %16s", "-");
+		if (receiver != NULL && receiver->pc_valid[s])
+			printf(" %16.1F", 100 * receiver->pc_running[s]);
+		else if (receiver != NULL)
+			printf(" %16s", "-");
+		printf("\n");
+	}
+}
+#endif /* WITH_PERF */
 
+#ifdef WITH_IO_URING
 /*
- * Whether using threads or processes, we have the second thread/process do
- * the sending, and the first do the receiving, so that it reliably knows when
- * the benchmark is done.  The sender will write the timestamp to shared
- * memory before sending any bytes, so the receipt of any byte means that the
- * timestamp has been stored.
- *
- * XXXRW: If we run this benchmark on multicore, we may want to put in a
- * memory barrier of some sort on either side, although because a system call
- * is involved, it is probably not necessary.  I wonder what C and POSIX have
- * to say about that.
+ * A minimal io_uring submission engine, talking to the kernel directly via
+ * io_uring_setup(2), io_uring_enter(2) and io_uring_register(2) so as not to
+ * depend on liburing.  Each sender or receiver sets up its own ring, and
+ * registers both its file descriptor and its I/O buffer with the kernel, so
+ * that per-operation file lookups and page pinning are avoided.  Up to
+ * uring_qdepth reads or writes are kept in flight at once, and a single
+ * io_uring_enter(2) both submits newly queued operations and waits for
+ * completions.  With SQPOLL (-S), a kernel thread polls the submission queue
+ * and system calls are needed only to wait for completions.
  */
-struct sender_argument {
-	struct timespec	 sa_starttime;	/* Sender stores start time here. */
-	int		 sa_writefd;	/* Caller provides send fd here. */
-	long		 sa_blockcount;	/* Caller provides block count here. */
-	void		*sa_buffer;	/* Caller provides buffer here. */
+#define	URING_QDEPTH_DEFAULT	8
+#define	URING_QDEPTH_MAX	4096
+static unsigned int uring_qdepth = URING_QDEPTH_DEFAULT;
+
+#define	URING_SQ_THREAD_IDLE	1000	/* SQPOLL idle time (ms) */
+
+struct uring {
+	int			 u_fd;		/* io_uring file descriptor */
+	void			*u_sq_ring;	/* Submission-queue ring */
+	size_t			 u_sq_ring_len;
+	void			*u_cq_ring;	/* Completion-queue ring */
+	size_t			 u_cq_ring_len;
+	struct io_uring_sqe	*u_sqes;	/* Submission-queue entries */
+	size_t			 u_sqes_len;
+	unsigned int		*u_sq_head;
+	unsigned int		*u_sq_tail;
+	unsigned int		*u_sq_mask;
+	unsigned int		*u_sq_flags;
+	unsigned int		*u_sq_array;
+	unsigned int		*u_cq_head;
+	unsigned int		*u_cq_tail;
+	unsigned int		*u_cq_mask;
+	struct io_uring_cqe	*u_cqes;
+	unsigned int		 u_to_submit;	/* Queued but not yet submitted */
+	void			*u_buffer;	/* Registered I/O buffer */
+	size_t			 u_buflen;
 };
 
 static void
-sender(struct sender_argument *sap)
+uring_setup(struct uring *up, int fd, void *buffer, size_t buflen)
 {
-	ssize_t len;
-	long write_sofar;
-
-	if (clock_gettime(CLOCK_REALTIME, &sap->sa_starttime) < 0)
-		err(EX_OSERR, "FAIL: clock_gettime");
-#ifdef WITH_PMC
-	if (benchmark_pmc != BENCHMARK_PMC_NONE)
-		pmc_begin();
-#endif
+	struct io_uring_params p;
+	struct iovec iov;
+	char *sq, *cq;
+
+	bzero(up, sizeof(*up));
+	bzero(&p, sizeof(p));
+	if (Sflag) {
+		p.flags |= IORING_SETUP_SQPOLL;
+		p.sq_thread_idle = URING_SQ_THREAD_IDLE;
+	}
+	up->u_fd = syscall(__NR_io_uring_setup, uring_qdepth, &p);
+	if (up->u_fd < 0)
+		err(EX_OSERR, "FAIL: io_uring_setup");
+
+	up->u_sq_ring_len = p.sq_off.array + p.sq_entries *
+	    sizeof(unsigned int);
+	up->u_cq_ring_len = p.cq_off.cqes + p.cq_entries *
+	    sizeof(struct io_uring_cqe);
+	up->u_sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+	up->u_sq_ring = mmap(NULL, up->u_sq_ring_len, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_POPULATE, up->u_fd, IORING_OFF_SQ_RING);
+	if (up->u_sq_ring == MAP_FAILED)
+		err(EX_OSERR, "FAIL: mmap IORING_OFF_SQ_RING");
+	up->u_cq_ring = mmap(NULL, up->u_cq_ring_len, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_POPULATE, up->u_fd, IORING_OFF_CQ_RING);
+	if (up->u_cq_ring == MAP_FAILED)
+		err(EX_OSERR, "FAIL: mmap IORING_OFF_CQ_RING");
+	up->u_sqes = mmap(NULL, up->u_sqes_len, PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_POPULATE, up->u_fd, IORING_OFF_SQES);
+	if (up->u_sqes == MAP_FAILED)
+		err(EX_OSERR, "FAIL: mmap IORING_OFF_SQES");
+
+	sq = up->u_sq_ring;
+	up->u_sq_head = (unsigned int *)(sq + p.sq_off.head);
+	up->u_sq_tail = (unsigned int *)(sq + p.sq_off.tail);
+	up->u_sq_mask = (unsigned int *)(sq + p.sq_off.ring_mask);
+	up->u_sq_flags = (unsigned int *)(sq + p.sq_off.flags);
+	up->u_sq_array = (unsigned int *)(sq + p.sq_off.array);
+	cq = up->u_cq_ring;
+	up->u_cq_head = (unsigned int *)(cq + p.cq_off.head);
+	up->u_cq_tail = (unsigned int *)(cq + p.cq_off.tail);
+	up->u_cq_mask = (unsigned int *)(cq + p.cq_off.ring_mask);
+	up->u_cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
 
 	/*
-	 * HERE BEGINS THE BENCHMARK (2-thread/2-proc).
+	 * Register the file descriptor and buffer so that every operation
+	 * can use IOSQE_FIXED_FILE and IORING_OP_{READ,WRITE}_FIXED.
 	 */
-	write_sofar = 0;
-	while (write_sofar < totalsize) {
-		const size_t bytes_to_write = min(buffersize, totalsize - write_sofar);
-		len = write(sap->sa_writefd, sap->sa_buffer,
-		    min(buffersize, totalsize - write_sofar));
-		/*printf("write(%d, %zd, %zd) = %zd\n", sap->sa_writefd, 0, bytes_to_write, len);*/
-		if (len != bytes_to_write) {
-			errx(EX_IOERR, "blocking write() returned early: %zd != %zd", len, bytes_to_write);
-		}
-		if (len < 0)
-			err(EX_IOERR, "FAIL: write");
+	if (syscall(__NR_io_uring_register, up->u_fd,
+	    IORING_REGISTER_FILES, &fd, 1) < 0)
+		err(EX_OSERR, "FAIL: io_uring_register IORING_REGISTER_FILES");
+	iov.iov_base = buffer;
+	iov.iov_len = buflen;
+	if (syscall(__NR_io_uring_register, up->u_fd,
+	    IORING_REGISTER_BUFFERS, &iov, 1) < 0)
+		err(EX_OSERR, "FAIL: io_uring_register "
+		    "IORING_REGISTER_BUFFERS");
+	up->u_buffer = buffer;
+	up->u_buflen = buflen;
+}
+
+static void
+uring_teardown(struct uring *up)
+{
+
+	munmap(up->u_sqes, up->u_sqes_len);
+	munmap(up->u_cq_ring, up->u_cq_ring_len);
+	munmap(up->u_sq_ring, up->u_sq_ring_len);
+	close(up->u_fd);
+}
+
+/*
+ * Queue a fixed-buffer read or write of 'len' bytes at 'offset' into the
+ * registered buffer.  The operation is tagged with 'user_data' so that its
+ * completion can be matched up later.
+ */
+static void
+uring_queue(struct uring *up, int opcode, size_t offset, size_t len,
+    uint64_t user_data)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int index, tail;
+
+	tail = *up->u_sq_tail;
+	index = tail & *up->u_sq_mask;
+	sqe = &up->u_sqes[index];
+	bzero(sqe, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->flags = IOSQE_FIXED_FILE;
+	sqe->fd = 0;			/* Index into registered files. */
+	sqe->off = (uint64_t)-1;	/* Use (and update) file offset. */
+	sqe->addr = (uintptr_t)up->u_buffer + offset;
+	sqe->len = len;
+	sqe->buf_index = 0;		/* Index into registered buffers. */
+	sqe->user_data = user_data;
+	up->u_sq_array[index] = index;
+	__atomic_store_n(up->u_sq_tail, tail + 1, __ATOMIC_RELEASE);
+	up->u_to_submit++;
+}
+
+/*
+ * Submit any queued operations and, if no completions are already pending,
+ * wait for at least one.  With SQPOLL, the kernel thread picks up
+ * submissions itself, and need only be woken if it has gone idle.
+ */
+static void
+uring_submit_and_wait(struct uring *up)
+{
+	unsigned int flags, min_complete, to_submit;
+
+	flags = 0;
+	to_submit = up->u_to_submit;
+	min_complete = (*up->u_cq_head == __atomic_load_n(up->u_cq_tail,
+	    __ATOMIC_ACQUIRE)) ? 1 : 0;
+	if (Sflag) {
+		to_submit = 0;
+		if (__atomic_load_n(up->u_sq_flags, __ATOMIC_ACQUIRE) &
+		    IORING_SQ_NEED_WAKEUP)
+			flags |= IORING_ENTER_SQ_WAKEUP;
+	}
+	if (min_complete > 0)
+		flags |= IORING_ENTER_GETEVENTS;
+	up->u_to_submit = 0;
+	if (to_submit == 0 && flags == 0)
+		return;
+	if (syscall(__NR_io_uring_enter, up->u_fd, to_submit, min_complete,
+	    flags, NULL, 0) < 0 && errno != EINTR)
+		err(EX_OSERR, "FAIL: io_uring_enter");
+}
+
+/*
+ * Return the next completion, if any, without blocking.  The caller must
+ * call uring_cqe_seen() once done with it.
+ */
+static struct io_uring_cqe *
+uring_peek_cqe(struct uring *up)
+{
+	unsigned int head;
+
+	head = *up->u_cq_head;
+	if (head == __atomic_load_n(up->u_cq_tail, __ATOMIC_ACQUIRE))
+		return (NULL);
+	return (&up->u_cqes[head & *up->u_cq_mask]);
+}
+
+static void
+uring_cqe_seen(struct uring *up)
+{
+
+	__atomic_store_n(up->u_cq_head, *up->u_cq_head + 1,
+	    __ATOMIC_RELEASE);
+}
+
+/*
+ * Move 'totalsize' bytes with up to uring_qdepth reads or writes in flight.
+ * We never have more bytes outstanding than remain to be transferred, or
+ * the final reads would block waiting for data that will never be sent.
+ * Reads use one buffersize slot each of the registered buffer, so that
+ * concurrent operations don't land on the same memory; writes all send
+ * from the start of the buffer.  Short transfers are simply accounted for,
+ * and the remainder is picked up by the next operation queued.
+ *
+ * NB: Operations in flight at the same time are not ordered with respect to
+ * one another.  As the payload is never inspected, this doesn't matter here.
+ */
+static void
+uring_transfer(struct uring *up, int opcode)
+{
+	struct io_uring_cqe *cqe;
+	unsigned int inflight, slot, *slots, nslots;
+	long sofar, outstanding;
+	size_t len;
+
+	slots = calloc(uring_qdepth, sizeof(*slots));
+	if (slots == NULL)
+		err(EX_OSERR, "FAIL: calloc");
+	for (nslots = 0; nslots < uring_qdepth; nslots++)
+		slots[nslots] = nslots;
+
+	sofar = outstanding = 0;
+	inflight = 0;
+	while (sofar < totalsize) {
+		while (inflight < uring_qdepth &&
+		    sofar + outstanding < totalsize) {
+			len = min(buffersize, totalsize - sofar - outstanding);
+			slot = slots[--nslots];
+			uring_queue(up, opcode, opcode == IORING_OP_READ_FIXED ?
+			    slot * buffersize : 0, len,
+			    ((uint64_t)len << 32) | slot);
+			outstanding += len;
+			inflight++;
+		}
+		uring_submit_and_wait(up);
+		while ((cqe = uring_peek_cqe(up)) != NULL) {
+			if (cqe->res < 0) {
+				errno = -cqe->res;
+				err(EX_IOERR, "FAIL: io_uring %s",
+				    opcode == IORING_OP_READ_FIXED ? "read" :
+				    "write");
+			}
+			if (cqe->res == 0)
+				errx(EX_IOERR, "FAIL: io_uring %s returned 0",
+				    opcode == IORING_OP_READ_FIXED ? "read" :
+				    "write");
+			sofar += cqe->res;
+			outstanding -= cqe->user_data >> 32;
+			slots[nslots++] = cqe->user_data & 0xffffffff;
+			inflight--;
+			uring_cqe_seen(up);
+		}
+	}
+	free(slots);
+}
+#endif
+
+
+#ifdef SPLICE_F_GIFT
+/*
+ * Zero-copy pipe transfers on Linux.  Rather than copying each buffer into
+ * the pipe with write(), the sender uses vmsplice() with SPLICE_F_GIFT to
+ * place references to its own pages in the pipe.  The receiver either
+ * copies the data out with vmsplice() ('vmsplice' engine), or moves it
+ * entirely within the kernel with splice() to a sink file such as /dev/null
+ * ('splice' engine).
+ *
+ * As the pipe holds references to the sender's pages rather than copies,
+ * those pages must not be rewritten until the receiver has consumed them.
+ * We enforce this by requiring that the buffer size be a multiple of the
+ * page size (so that only whole, page-aligned pages are gifted) and by
+ * sending from a ring of buffers large enough that a buffer is reused only
+ * once the pipe's entire capacity has been written since, at which point
+ * none of its pages can still be in the pipe.
+ */
+#define	SPLICE_SINK_DEFAULT	"/dev/null"
+static const char *splice_sink;		/* NULL until set by -f */
+
+static long
+vmsplice_ringsize(int writefd)
+{
+	long capacity;
+
+	capacity = fcntl(writefd, F_GETPIPE_SZ);
+	if (capacity < 0)
+		err(EX_OSERR, "FAIL: fcntl(writefd, F_GETPIPE_SZ)");
+	return (((capacity + buffersize - 1) / buffersize + 1) * buffersize);
+}
+
+static void *
+vmsplice_ring(long ringsize)
+{
+	void *ring;
+
+	ring = mmap(NULL, ringsize, PROT_READ | PROT_WRITE,
+	    MAP_ANON | MAP_PRIVATE, -1, 0);
+	if (ring == MAP_FAILED)
+		err(EX_OSERR, "FAIL: mmap");
+
+	/* Fault in private pages up front, rather than in the timed loop. */
+	memset(ring, 0, ringsize);
+	return (ring);
+}
+
+static void
+vmsplice_sender(int writefd, void *ring, long ringsize)
+{
+	struct iovec iov;
+	ssize_t len;
+	long write_sofar;
+
+	write_sofar = 0;
+	while (write_sofar < totalsize) {
+		iov.iov_base = (char *)ring + write_sofar % ringsize;
+		iov.iov_len = min(buffersize - write_sofar % buffersize,
+		    totalsize - write_sofar);
+		len = vmsplice(writefd, &iov, 1, SPLICE_F_GIFT);
+		if (len < 0)
+			err(EX_IOERR, "FAIL: vmsplice");
 		write_sofar += len;
 	}
 }
 
-static struct timespec
-receiver(int readfd, long blockcount, void *buf)
+static void
+vmsplice_receiver(int readfd, void *buf)
 {
-	struct timespec finishtime;
+	struct iovec iov;
 	ssize_t len;
 	long read_sofar;
 
 	read_sofar = 0;
-	/** read() always returns as soon as there is something to read,
-	 * i.e. one pipe/socket buffer size. Make sure we use the whole buffer */
 	while (read_sofar < totalsize) {
-		const size_t offset = read_sofar % buffersize;
-		const size_t bytes_to_read = min(totalsize - read_sofar, buffersize - offset);
-		len = read(readfd, buf + offset, bytes_to_read);
-		/*printf("read(%d, %zd, %zd) = %zd\n", readfd, offset, bytes_to_read, len);*/
-		/* if (len != bytes_to_read) {
-			warn("blocking read returned early: %zd != %zd", len, bytes_to_read);
-		} */
+		iov.iov_base = (char *)buf + read_sofar % buffersize;
+		iov.iov_len = min(totalsize - read_sofar,
+		    buffersize - read_sofar % buffersize);
+		len = vmsplice(readfd, &iov, 1, 0);
 		if (len < 0)
-			err(EX_IOERR, "FAIL: read");
+			err(EX_IOERR, "FAIL: vmsplice");
+		if (len == 0)
+			errx(EX_IOERR, "FAIL: vmsplice returned 0");
 		read_sofar += len;
 	}
+}
 
-	/*
-	 * HERE ENDS THE BENCHMARK (2-thread/2-proc).
-	 */
-#ifdef WITH_PMC
-	if (benchmark_pmc != BENCHMARK_PMC_NONE)
-		pmc_end();
+static void
+splice_receiver(int readfd, int sinkfd)
+{
+	ssize_t len;
+	long read_sofar;
+
+	read_sofar = 0;
+	while (read_sofar < totalsize) {
+		len = splice(readfd, NULL, sinkfd, NULL,
+		    min(totalsize - read_sofar, buffersize), SPLICE_F_MOVE);
+		if (len < 0)
+			err(EX_IOERR, "FAIL: splice");
+		if (len == 0)
+			errx(EX_IOERR, "FAIL: splice returned 0");
+		read_sofar += len;
+	}
+}
 #endif
-	if (clock_gettime(CLOCK_REALTIME, &finishtime) < 0)
-		err(EX_OSERR, "FAIL: clock_gettime");
-	return (finishtime);
+
+/*
+ * Set while a zero-copy engine is compared with the copying path, across
+ * both runs, for which senders count their cycles.
+ */
+static int zerocopy_compare;
+
+#ifdef __linux__
+/*
+ * Count the CPU cycles, in both user and kernel mode, consumed by the
+ * calling thread.  Many virtual machines expose no cycle counter, in which
+ * case -1 is returned and cycles will be reported as unavailable.
+ */
+static int
+thread_cycles_open(void)
+{
+	struct perf_event_attr attr;
+
+	bzero(&attr, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.exclude_hv = 1;
+	return (syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
 }
 
-static void *
-second_thread(void *arg)
+static uint64_t
+thread_cycles_read(int fd)
 {
-	struct sender_argument *sap = arg;
+	uint64_t cycles;
 
-	if (!Bflag)
-		sleep(1);
-	sender(sap);
+	if (fd < 0 || read(fd, &cycles, sizeof(cycles)) != sizeof(cycles))
+		return (0);
+	return (cycles);
+}
+#endif
 
-	/*
-	 * No action needed to terminate thread other than to return.
-	 */
-	return (NULL);
+#ifdef SO_ZEROCOPY
+/*
+ * MSG_ZEROCOPY TCP sends.  The kernel pins the pages of each buffer passed
+ * to send() rather than copying them, so a buffer may not be reused until
+ * the kernel says that it is done with it.  We therefore send from a pool
+ * of buffers, used in rotation.  Each MSG_ZEROCOPY send() is implicitly
+ * assigned the next 32-bit id, and completions arrive on the socket error
+ * queue as ranges of ids, also indicating whether the kernel fell back to
+ * copying (as it always does over loopback, for example).  A buffer is
+ * reused only once every send from it has completed.
+ */
+#define	ZEROCOPY_NBUFS_DEFAULT	8
+#define	ZEROCOPY_NBUFS_MAX	1024
+static unsigned int zerocopy_nbufs = ZEROCOPY_NBUFS_DEFAULT;
+
+#define	ZEROCOPY_IDMAP		4096	/* Sends in flight; power of 2. */
+
+struct zerocopy_pool {
+	char		*zp_buffers;		/* nbufs * buffersize bytes */
+	unsigned int	*zp_refs;		/* Sends in flight per buffer */
+	unsigned int	 zp_idmap[ZEROCOPY_IDMAP]; /* Send id -> buffer */
+	uint32_t	 zp_nextid;		/* Id of next send() */
+	unsigned int	 zp_inflight;		/* Sends not yet completed */
+	long		 zp_sends;		/* Completed sends */
+	long		 zp_copied;		/* ... that fell back to copying */
+};
+
+/*
+ * Drain the socket error queue of completion notifications, first waiting
+ * for at least one if 'wait' is set.
+ */
+static void
+zerocopy_reap(struct zerocopy_pool *zpp, int fd, int wait)
+{
+	char control[CMSG_SPACE(sizeof(struct sock_extended_err))];
+	struct sock_extended_err *serr;
+	struct cmsghdr *cmsg;
+	struct pollfd pfd;
+	struct msghdr msg;
+	uint32_t id;
+
+	if (wait) {
+		pfd.fd = fd;
+		pfd.events = 0;		/* POLLERR is always reported. */
+		if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+			err(EX_OSERR, "FAIL: poll");
+	}
+	for (;;) {
+		bzero(&msg, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+			if (errno == EAGAIN)
+				return;
+			err(EX_IOERR, "FAIL: recvmsg MSG_ERRQUEUE");
+		}
+		cmsg = CMSG_FIRSTHDR(&msg);
+		if (cmsg == NULL || cmsg->cmsg_level != SOL_IP ||
+		    cmsg->cmsg_type != IP_RECVERR)
+			errx(EX_IOERR, "FAIL: unexpected error-queue message");
+		serr = (struct sock_extended_err *)CMSG_DATA(cmsg);
+		if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY ||
+		    serr->ee_errno != 0)
+			errx(EX_IOERR, "FAIL: zerocopy completion error %u",
+			    serr->ee_errno);
+		for (id = serr->ee_info; id != serr->ee_data + 1; id++) {
+			zpp->zp_refs[zpp->zp_idmap[id % ZEROCOPY_IDMAP]]--;
+			zpp->zp_inflight--;
+			zpp->zp_sends++;
+			if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+				zpp->zp_copied++;
+		}
+	}
 }
 
-static struct sender_argument sa;
+static void
+zerocopy_setup(struct zerocopy_pool *zpp, int fd)
+{
+	int i;
 
-static struct timespec
-do_2thread(int readfd, int writefd, long blockcount, void *readbuf,
-    void *writebuf)
+	bzero(zpp, sizeof(*zpp));
+	i = 1;
+	if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &i, sizeof(i)) < 0)
+		err(EX_OSERR, "FAIL: setsockopt SO_ZEROCOPY");
+	zpp->zp_buffers = mmap(NULL, zerocopy_nbufs * buffersize,
+	    PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+	if (zpp->zp_buffers == MAP_FAILED)
+		err(EX_OSERR, "FAIL: mmap");
+	memset(zpp->zp_buffers, 0, zerocopy_nbufs * buffersize);
+	zpp->zp_refs = calloc(zerocopy_nbufs, sizeof(*zpp->zp_refs));
+	if (zpp->zp_refs == NULL)
+		err(EX_OSERR, "FAIL: calloc");
+}
+
+static void
+zerocopy_teardown(struct zerocopy_pool *zpp)
 {
-	struct timespec finishtime;
-	pthread_t thread;
 
-	/*
-	 * We can just use ordinary shared memory between the two threads --
-	 * no need to do anything special.
-	 */
-	sa.sa_writefd = writefd;
-	sa.sa_blockcount = blockcount;
-	sa.sa_buffer = writebuf;
-	if (pthread_create(&thread, NULL, second_thread, &sa) < 0)
-		err(EX_OSERR, "FAIL: pthread_create");
-	finishtime = receiver(readfd, blockcount, readbuf);
-	if (pthread_join(thread, NULL) < 0)
-		err(EX_OSERR, "FAIL: pthread_join");
-	timespecsub(&finishtime, &sa.sa_starttime);
-	return (finishtime);
+	munmap(zpp->zp_buffers, zerocopy_nbufs * buffersize);
+	free(zpp->zp_refs);
 }
 
-static struct timespec
-do_2proc(int readfd, int writefd, long blockcount, void *readbuf,
-    void *writebuf)
+static void
+zerocopy_sender(struct zerocopy_pool *zpp, int fd)
 {
-	struct sender_argument *sap;
-	struct timespec finishtime;
-	pid_t pid, pid2;
+	unsigned int b;
+	long write_sofar;
+	ssize_t len;
+	size_t off, todo;
+	char *buf;
+
+	b = 0;
+	write_sofar = 0;
+	while (write_sofar < totalsize) {
+		while (zpp->zp_refs[b] != 0)
+			zerocopy_reap(zpp, fd, 1);
+		buf = zpp->zp_buffers + b * buffersize;
+		todo = min(buffersize, totalsize - write_sofar);
+		for (off = 0; off < todo; off += len) {
+			while (zpp->zp_inflight == ZEROCOPY_IDMAP)
+				zerocopy_reap(zpp, fd, 1);
+			len = send(fd, buf + off, todo - off, MSG_ZEROCOPY);
+			if (len < 0) {
+				/* Out of option memory for notifications. */
+				if (errno == ENOBUFS) {
+					zerocopy_reap(zpp, fd, 1);
+					len = 0;
+					continue;
+				}
+				err(EX_IOERR, "FAIL: send MSG_ZEROCOPY");
+			}
+			zpp->zp_idmap[zpp->zp_nextid % ZEROCOPY_IDMAP] = b;
+			zpp->zp_nextid++;
+			zpp->zp_refs[b]++;
+			zpp->zp_inflight++;
+		}
+		write_sofar += todo;
+		b = (b + 1) % zerocopy_nbufs;
+		zerocopy_reap(zpp, fd, 0);
+	}
 
 	/*
-	 * Set up a shared page across fork() that will allow not just
-	 * passing arguments, but also getting back the starting timestamp
- 	 * that may be somewhat after the time of fork() in this process.
+	 * Wait for all sends to complete so that buffers can be released and
+	 * fallback counts are complete.
 	 */
-	if ((sap = mmap(NULL, getpagesize(), PROT_READ | PROT_WRITE, MAP_ANON,
-	    -1, 0)) == MAP_FAILED)
-		err(EX_OSERR, "mmap");
-	if (minherit(sap, getpagesize(), INHERIT_SHARE) < 0)
-		err(EX_OSERR, "minherit");
-	sap->sa_writefd = writefd;
-	sap->sa_blockcount = blockcount;
-	sap->sa_buffer = writebuf;
-	pid = fork();
-	if (pid == 0) {
-		if (!Bflag)
-			sleep(1);
-		sender(sap);
-		if (!Bflag)
-			sleep(1);
-		_exit(0);
-	}
-	finishtime = receiver(readfd, blockcount, readbuf);
-	if ((pid2 = waitpid(pid, NULL, 0)) < 0)
-		err(EX_OSERR, "FAIL: waitpid");
-	if (pid2 != pid)
-		err(EX_OSERR, "FAIL: waitpid PID mismatch");
-	timespecsub(&finishtime, &sap->sa_starttime);
-	return (finishtime);
+	while (zpp->zp_inflight > 0)
+		zerocopy_reap(zpp, fd, 1);
 }
+#endif
 
 /*
- * The single threading case is quite different from the two-thread/process
- * case, as we need to manually interleave the sender and recipient.  Note the
- * opportunity for deadlock if the buffer size is greater than what the IPC
- * primitive provides.
- *
- * The buffer pointer must point at a buffer of size 'buffersize' here.
+ * Message-oriented IPC types.  Each buffersize message begins with a 64-bit
+ * sequence number, allowing the receiver to count lost and out-of-order
+ * messages.  With -m, up to that many messages are moved per sendmmsg() or
+ * recvmmsg() system call; otherwise, one send() or recv() is used per
+ * message.
  *
- * XXXRW: Should we be explicitly setting the buffer size for the file
- * descriptor?  Pipes appear not to offer a way to do this.
+ * UDP may silently drop messages if the receiver falls behind, so a
+ * receiver that sees no message for DGRAM_IDLE_TIMEOUT after the first
+ * assumes that the remainder were lost, and ends the measurement at the
+ * last message it received.  The local datagram and seqpacket types are
+ * reliable.
  */
-static struct timespec
-do_1thread(int readfd, int writefd, long blockcount, void *readbuf,
-    void *writebuf)
+#define	DGRAM_BATCH_DEFAULT	1
+#define	DGRAM_BATCH_MAX		1024
+static unsigned int dgram_batch = DGRAM_BATCH_DEFAULT;
+
+#define	DGRAM_IDLE_TIMEOUT	1	/* Seconds */
+
+#define	DGRAM_UDP_MAX		65507	/* Largest UDP payload over IPv4. */
+
+struct receiver_stats {
+	long		 rs_messages;	/* Messages received. */
+	long		 rs_lost;	/* Messages never received. */
+	long		 rs_reordered;	/* Messages received out of order. */
+	long		 rs_bytes;	/* Bytes received. */
+	long		 rs_reads;	/* read() calls (and 1thread ... */
+	long		 rs_writes;	/* ... write() calls) for -C. */
+	uint64_t	 rs_checksum;	/* Payload checksum (-u checksum). */
+	struct timespec	 rs_cputime;	/* Receiver thread CPU time (-l). */
+	struct spin_stats rs_spin;	/* Busy polling (-l). */
+	int		 rs_timedout;	/* Ended by idle timeout. */
+	struct timespec	 rs_lastrecv;	/* Last message received (UDP). */
+#ifdef WITH_PERF
+	struct perf_counts rs_perf;	/* Receiver (or 1thread) counts. */
+#endif
+};
+
+/*
+ * Statistics from the receiver in the most recent run.
+ */
+static struct receiver_stats receiver_stats;
+
+static int
+ipc_type_datagram(int type)
 {
-	struct timespec starttime, finishtime;
-	fd_set fdset_read, fdset_write;
-	long read_sofar, write_sofar;
-	ssize_t len_read, len_write;
-	int flags;
 
-	flags = fcntl(readfd, F_GETFL, 0);
-	if (flags < 0)
-		err(EX_OSERR, "FAIL: fcntl(readfd, F_GETFL, 0)");
-	if (fcntl(readfd, F_SETFL, flags | O_NONBLOCK) < 0)
-		err(EX_OSERR, "FAIL: fcntl(readfd, F_SETFL, "
-		    "flags | O_NONBLOCK)");
-	flags = fcntl(writefd, F_GETFL, 0);
-	if (flags < 0)
-		err(EX_OSERR, "FAIL: fcntl(writefd, F_GETFL, 0)");
-	if (fcntl(writefd, F_SETFL, flags | O_NONBLOCK) < 0)
-		err(EX_OSERR, "FAIL: fcntl(writefd, F_SETFL, "
-		    "flags | O_NONBLOCK)");
+	return (type == BENCHMARK_IPC_UDP_SOCKET ||
+	    type == BENCHMARK_IPC_LOCAL_DGRAM ||
+	    type == BENCHMARK_IPC_LOCAL_SEQPACKET);
+}
+
+/*
+ * Allocate an array of message headers pointing into a buffer of 'count'
+ * consecutive messages.
+ */
+static struct mmsghdr *
+dgram_msgs(char *buf, struct iovec *iov, unsigned int count)
+{
+	struct mmsghdr *msgs;
+	unsigned int i;
+
+	msgs = calloc(count, sizeof(*msgs));
+	if (msgs == NULL)
+		err(EX_OSERR, "FAIL: calloc");
+	for (i = 0; i < count; i++) {
+		iov[i].iov_base = buf + i * buffersize;
+		iov[i].iov_len = buffersize;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	return (msgs);
+}
+
+static void
+dgram_sender(int writefd, char *buf)
+{
+	struct mmsghdr *msgs;
+	struct iovec *iov;
+	uint64_t seq;
+	unsigned int i, n;
+	ssize_t len;
+	int sent;
+
+	if (dgram_batch == 1) {
+		for (seq = 0; seq < totalsize / buffersize; seq++) {
+			memcpy(buf, &seq, sizeof(seq));
+			len = send(writefd, buf, buffersize, 0);
+			if (len < 0)
+				err(EX_IOERR, "FAIL: send");
+		}
+		return;
+	}
+
+	iov = calloc(dgram_batch, sizeof(*iov));
+	if (iov == NULL)
+		err(EX_OSERR, "FAIL: calloc");
+	msgs = dgram_msgs(buf, iov, dgram_batch);
+	seq = 0;
+	while (seq < totalsize / buffersize) {
+		n = min(dgram_batch, totalsize / buffersize - seq);
+		for (i = 0; i < n; i++)
+			memcpy(buf + i * buffersize, &(uint64_t){seq + i},
+			    sizeof(seq));
+		for (i = 0; i < n; i += sent) {
+			sent = sendmmsg(writefd, msgs + i, n - i, 0);
+			if (sent < 0)
+				err(EX_IOERR, "FAIL: sendmmsg");
+		}
+		seq += n;
+	}
+	free(msgs);
+	free(iov);
+}
+
+/*
+ * Account for the arrival of message 'seq' when 'expected' was next in
+ * sequence.  A gap is provisionally counted as lost, and a late arrival
+ * later filling it is counted as reordered instead.
+ */
+static void
+dgram_account(struct receiver_stats *rsp, uint64_t *expectedp, char *msg,
+    size_t len)
+{
+	uint64_t seq;
+
+	if (len != (size_t)buffersize)
+		errx(EX_IOERR, "FAIL: message length %zu != %ld", len,
+		    buffersize);
+	memcpy(&seq, msg, sizeof(seq));
+	rsp->rs_messages++;
+	rsp->rs_bytes += len;
+	if (seq >= *expectedp) {
+		rsp->rs_lost += seq - *expectedp;
+		*expectedp = seq + 1;
+	} else {
+		rsp->rs_lost--;
+		rsp->rs_reordered++;
+	}
+}
+
+static void
+dgram_receiver(int readfd, char *buf, struct receiver_stats *rsp)
+{
+	struct mmsghdr *msgs;
+	struct iovec *iov;
+	struct timeval tv;
+	uint64_t expected;
+	ssize_t len;
+	int i, n;
+
+	iov = calloc(dgram_batch, sizeof(*iov));
+	if (iov == NULL)
+		err(EX_OSERR, "FAIL: calloc");
+	msgs = dgram_msgs(buf, iov, dgram_batch);
+	expected = 0;
+	while (expected < (uint64_t)(totalsize / buffersize)) {
+		if (dgram_batch == 1) {
+			len = recv(readfd, buf, buffersize, 0);
+			n = (len < 0) ? -1 : 1;
+			msgs[0].msg_len = len;
+		} else
+			n = recvmmsg(readfd, msgs, dgram_batch,
+			    MSG_WAITFORONE, NULL);
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				rsp->rs_lost += totalsize / buffersize -
+				    expected;
+				rsp->rs_timedout = 1;
+				break;
+			}
+			err(EX_IOERR, "FAIL: %s", dgram_batch == 1 ? "recv" :
+			    "recvmmsg");
+		}
+
+		/*
+		 * Arm the idle timeout only once the sender has started, and
+		 * note when each message arrives, to end a run that times out
+		 * there.
+		 */
+		if (ipc_type == BENCHMARK_IPC_UDP_SOCKET &&
+		    clock_gettime(CLOCK_REALTIME, &rsp->rs_lastrecv) < 0)
+			err(EX_OSERR, "FAIL: clock_gettime");
+		if (ipc_type == BENCHMARK_IPC_UDP_SOCKET &&
+		    rsp->rs_messages == 0) {
+			tv.tv_sec = DGRAM_IDLE_TIMEOUT;
+			tv.tv_usec = 0;
+			if (setsockopt(readfd, SOL_SOCKET, SO_RCVTIMEO, &tv,
+			    sizeof(tv)) < 0)
+				err(EX_OSERR, "FAIL: setsockopt SO_RCVTIMEO");
+		}
+		for (i = 0; i < n; i++)
+			dgram_account(rsp, &expected, buf + i * buffersize,
+			    msgs[i].msg_len);
+	}
+	free(msgs);
+	free(iov);
+}
+
+static int
+ipc_type_from_string(const char *string)
+{
+
+	if (strcmp(BENCHMARK_IPC_PIPE_STRING, string) == 0)
+		return (BENCHMARK_IPC_PIPE);
+	else if (strcmp(BENCHMARK_IPC_LOCAL_SOCKET_STRING, string) == 0)
+		return (BENCHMARK_IPC_LOCAL_SOCKET);
+	else if (strcmp(BENCHMARK_IPC_TCP_SOCKET_STRING, string) == 0)
+		return (BENCHMARK_IPC_TCP_SOCKET);
+	else if (strcmp(BENCHMARK_IPC_UDP_SOCKET_STRING, string) == 0)
+		return (BENCHMARK_IPC_UDP_SOCKET);
+	else if (strcmp(BENCHMARK_IPC_LOCAL_DGRAM_STRING, string) == 0)
+		return (BENCHMARK_IPC_LOCAL_DGRAM);
+	else if (strcmp(BENCHMARK_IPC_LOCAL_SEQPACKET_STRING, string) == 0)
+		return (BENCHMARK_IPC_LOCAL_SEQPACKET);
+	else
+		return (BENCHMARK_IPC_INVALID);
+}
+
+static const char *
+ipc_type_to_string(int type)
+{
+
+	switch (type) {
+	case BENCHMARK_IPC_PIPE:
+		return (BENCHMARK_IPC_PIPE_STRING);
+
+	case BENCHMARK_IPC_LOCAL_SOCKET:
+		return (BENCHMARK_IPC_LOCAL_SOCKET_STRING);
+
+	case BENCHMARK_IPC_TCP_SOCKET:
+		return (BENCHMARK_IPC_TCP_SOCKET_STRING);
+
+	case BENCHMARK_IPC_UDP_SOCKET:
+		return (BENCHMARK_IPC_UDP_SOCKET_STRING);
+
+	case BENCHMARK_IPC_LOCAL_DGRAM:
+		return (BENCHMARK_IPC_LOCAL_DGRAM_STRING);
+
+	case BENCHMARK_IPC_LOCAL_SEQPACKET:
+		return (BENCHMARK_IPC_LOCAL_SEQPACKET_STRING);
+
+	default:
+		return (BENCHMARK_IPC_INVALID_STRING);
+	}
+}
+
+static int
+benchmark_mode_from_string(const char *string)
+{
+
+	if (strcmp(BENCHMARK_MODE_1THREAD_STRING, string) == 0)
+		return (BENCHMARK_MODE_1THREAD);
+	else if (strcmp(BENCHMARK_MODE_2THREAD_STRING, string) == 0)
+		return (BENCHMARK_MODE_2THREAD);
+	else if (strcmp(BENCHMARK_MODE_2PROC_STRING, string) == 0)
+		return (BENCHMARK_MODE_2PROC);
+	else if (strcmp(BENCHMARK_MODE_CONNRATE_STRING, string) == 0)
+		return (BENCHMARK_MODE_CONNRATE);
+	else if (strcmp(BENCHMARK_MODE_SERVER_STRING, string) == 0)
+		return (BENCHMARK_MODE_SERVER);
+	else if (strcmp(BENCHMARK_MODE_CLIENT_STRING, string) == 0)
+		return (BENCHMARK_MODE_CLIENT);
+	else if (strcmp(BENCHMARK_MODE_SCENARIO_STRING, string) == 0)
+		return (BENCHMARK_MODE_SCENARIO);
+	else if (strcmp(BENCHMARK_MODE_SPAWN_STRING, string) == 0)
+		return (BENCHMARK_MODE_SPAWN);
+	else
+		return (BENCHMARK_MODE_INVALID);
+}
+
+static const char *
+benchmark_mode_to_string(int mode)
+{
+
+	switch (mode) {
+	case BENCHMARK_MODE_1THREAD:
+		return (BENCHMARK_MODE_1THREAD_STRING);
+
+	case BENCHMARK_MODE_2THREAD:
+		return (BENCHMARK_MODE_2THREAD_STRING);
+
+	case BENCHMARK_MODE_2PROC:
+		return (BENCHMARK_MODE_2PROC_STRING);
+
+	case BENCHMARK_MODE_CONNRATE:
+		return (BENCHMARK_MODE_CONNRATE_STRING);
+
+	case BENCHMARK_MODE_SERVER:
+		return (BENCHMARK_MODE_SERVER_STRING);
+
+	case BENCHMARK_MODE_CLIENT:
+		return (BENCHMARK_MODE_CLIENT_STRING);
+
+	case BENCHMARK_MODE_SCENARIO:
+		return (BENCHMARK_MODE_SCENARIO_STRING);
+
+	case BENCHMARK_MODE_SPAWN:
+		return (BENCHMARK_MODE_SPAWN_STRING);
+
+	default:
+		return (BENCHMARK_MODE_INVALID_STRING);
+	}
+}
+
+static int
+spawn_method_from_string(const char *string)
+{
+
+	if (strcmp(SPAWN_METHOD_FORK_STRING, string) == 0)
+		return (SPAWN_METHOD_FORK);
+	else if (strcmp(SPAWN_METHOD_VFORK_STRING, string) == 0)
+		return (SPAWN_METHOD_VFORK);
+	else if (strcmp(SPAWN_METHOD_POSIX_SPAWN_STRING, string) == 0)
+		return (SPAWN_METHOD_POSIX_SPAWN);
+	else if (strcmp(SPAWN_METHOD_PTHREAD_STRING, string) == 0)
+		return (SPAWN_METHOD_PTHREAD);
+#ifdef __linux__
+	else if (strcmp(SPAWN_METHOD_CLONE_STRING, string) == 0)
+		return (SPAWN_METHOD_CLONE);
+#endif
+	else if (strcmp(SPAWN_METHOD_FORKEXEC_STRING, string) == 0)
+		return (SPAWN_METHOD_FORKEXEC);
+	else if (strcmp(SPAWN_METHOD_VFORKEXEC_STRING, string) == 0)
+		return (SPAWN_METHOD_VFORKEXEC);
+	else
+		return (SPAWN_METHOD_INVALID);
+}
+
+static const char *
+spawn_method_to_string(int method)
+{
+
+	switch (method) {
+	case SPAWN_METHOD_FORK:
+		return (SPAWN_METHOD_FORK_STRING);
+
+	case SPAWN_METHOD_VFORK:
+		return (SPAWN_METHOD_VFORK_STRING);
+
+	case SPAWN_METHOD_POSIX_SPAWN:
+		return (SPAWN_METHOD_POSIX_SPAWN_STRING);
+
+	case SPAWN_METHOD_PTHREAD:
+		return (SPAWN_METHOD_PTHREAD_STRING);
+
+	case SPAWN_METHOD_CLONE:
+		return (SPAWN_METHOD_CLONE_STRING);
+
+	case SPAWN_METHOD_FORKEXEC:
+		return (SPAWN_METHOD_FORKEXEC_STRING);
+
+	case SPAWN_METHOD_VFORKEXEC:
+		return (SPAWN_METHOD_VFORKEXEC_STRING);
+
+	default:
+		return (SPAWN_METHOD_INVALID_STRING);
+	}
+}
+
+/*
+ * Methods that exec() a target.
+ */
+static int
+spawn_method_exec(int method)
+{
+
+	return (method == SPAWN_METHOD_POSIX_SPAWN ||
+	    method == SPAWN_METHOD_FORKEXEC ||
+	    method == SPAWN_METHOD_VFORKEXEC);
+}
+
+static int
+benchmark_engine_from_string(const char *string)
+{
+
+	if (strcmp(BENCHMARK_ENGINE_RW_STRING, string) == 0)
+		return (BENCHMARK_ENGINE_RW);
+#ifdef WITH_IO_URING
+	else if (strcmp(BENCHMARK_ENGINE_URING_STRING, string) == 0)
+		return (BENCHMARK_ENGINE_URING);
+#endif
+#ifdef SPLICE_F_GIFT
+	else if (strcmp(BENCHMARK_ENGINE_VMSPLICE_STRING, string) == 0)
+		return (BENCHMARK_ENGINE_VMSPLICE);
+	else if (strcmp(BENCHMARK_ENGINE_SPLICE_STRING, string) == 0)
+		return (BENCHMARK_ENGINE_SPLICE);
+#endif
+#ifdef SO_ZEROCOPY
+	else if (strcmp(BENCHMARK_ENGINE_ZEROCOPY_STRING, string) == 0)
+		return (BENCHMARK_ENGINE_ZEROCOPY);
+#endif
+	else
+		return (BENCHMARK_ENGINE_INVALID);
+}
+
+static const char *
+benchmark_engine_to_string(int engine)
+{
+
+	switch (engine) {
+	case BENCHMARK_ENGINE_RW:
+		return (BENCHMARK_ENGINE_RW_STRING);
+
+	case BENCHMARK_ENGINE_URING:
+		return (BENCHMARK_ENGINE_URING_STRING);
+
+	case BENCHMARK_ENGINE_VMSPLICE:
+		return (BENCHMARK_ENGINE_VMSPLICE_STRING);
+
+	case BENCHMARK_ENGINE_SPLICE:
+		return (BENCHMARK_ENGINE_SPLICE_STRING);
+
+	case BENCHMARK_ENGINE_ZEROCOPY:
+		return (BENCHMARK_ENGINE_ZEROCOPY_STRING);
+
+	default:
+		return (BENCHMARK_ENGINE_INVALID_STRING);
+	}
+}
+
+/*
+ * Zero-copy engines are reported next to the copying read()/write() path.
+ */
+static int
+benchmark_engine_zerocopy(int engine)
+{
+
+	return (engine == BENCHMARK_ENGINE_VMSPLICE ||
+	    engine == BENCHMARK_ENGINE_SPLICE ||
+	    engine == BENCHMARK_ENGINE_ZEROCOPY);
+}
+
+/*
+ * Print usage message and exit.
+ */
+static void
+usage(void)
+{
+
+	fprintf(stderr,
+	    "%s [-BCHlLqRsvW] [-A address] [-a acceptors] [-b buffersize] [-c clients]\n\t"
+	    "[-D dist] [-g payload] [-i ipctype] [-k producers] "
+	    "[-M method[:target]] [-m batch] [-n count] [-O sockopts] [-p port] "
+#ifdef WITH_PMC
+	    "[-P l1d|l1i|l2|mem|tlb|axi] "
+#endif
+#ifdef WITH_PERF
+	    "[-P set[,set...]] "
+#endif
+	    "[-E tracefile] [-e engine] "
+#ifdef SPLICE_F_GIFT
+	    "[-f sink] "
+#endif
+#ifdef SO_ZEROCOPY
+	    "[-N nbufs] "
+#endif
+#ifdef WITH_IO_URING
+	    "[-Q qdepth] [-S] "
+#endif
+	    "[-I msec] [-r rss] [-T seconds] [-t totalsize] [-u payload] "
+#ifdef WITH_PERF
+	    "[-X event[:period]] "
+#endif
+	    "[-y usec] [-Z profiles] "
+#ifdef F_SETPIPE_SZ
+	    "[-z capacity] "
+#endif
+	    "mode\n", PROGNAME);
+	fprintf(stderr,
+  "\n"
+  "Modes (pick one - default %s):\n"
+  "    1thread                IPC within a single thread\n"
+  "    2thread                IPC between two threads in one process\n"
+  "    2proc                  IPC between two threads in two different processes\n"
+  "    connrate               TCP connection setup rate (requires -i tcp)\n"
+  "    server                 Receive from one TCP client (requires -i tcp)\n"
+  "    client                 Send to a TCP server (requires -i tcp)\n"
+#ifdef __linux__
+  "    scenario               Sweep -O values across a veth pair under each\n"
+  "                           netem profile (requires -i tcp and root)\n"
+#endif
+  "    spawn                  Process/thread creation and teardown (see -M)\n"
+  "\n"
+  "Optional flags:\n"
+  "    -A address             Set TCP/UDP IPv4 address (default: %s)\n"
+  "    -a acceptors           Set connrate acceptor threads (default: %u)\n"
+  "    -B                     Run in bare mode: no preparatory activities\n"
+  "    -C                     Calibrate: measure clock reads, the empty loop and\n"
+  "                           zero-length read()/write(), and estimate the\n"
+  "                           harness overhead; -CC also subtracts it\n"
+  "    -c clients             Set connrate client threads (default: %u)\n"
+  "    -D dist[:param...]     Draw message sizes, capped at buffersize, from:\n"
+  "                             fixed[:size]          (default: buffersize)\n"
+  "                             uniform:min:max\n"
+  "                             bimodal:small:large:percent-large\n"
+  "                             lognormal:median:sigma\n"
+  "                             file:path             \"size weight\" lines\n"
+  "    -E tracefile           Record each thread's system calls, and write them\n"
+  "                           out as a Chrome trace (JSON) timeline\n"
+  "    -e engine              Select data-transfer engine (default: %s)\n"
+  "                             rw     read() and write() system calls\n"
+#ifdef WITH_IO_URING
+  "                             uring  io_uring batched submission\n"
+#endif
+#ifdef SPLICE_F_GIFT
+  "                             vmsplice  zero-copy pipe send; vmsplice() receive\n"
+  "                             splice    zero-copy pipe send; splice() to sink\n"
+#endif
+#ifdef SO_ZEROCOPY
+  "                             zerocopy  TCP send() with MSG_ZEROCOPY\n"
+#endif
+#ifdef SPLICE_F_GIFT
+  "    -f sink                Set splice sink file (default: %s)\n"
+#endif
+  "    -g payload             Produce each sent buffer by (default: none):\n"
+  "                             touch     storing one byte per cache line\n"
+  "                             memcpy    memcpy() from an application buffer\n"
+  "                             checksum  generating and checksumming data\n"
+  "                             stream    non-temporal copy from an app buffer\n"
+  "    -H                     Add sequence/timestamp headers to each buffer and\n"
+  "                           report one-way latency per buffer\n"
+  "    -I msec                Report receive throughput every msec as a time\n"
+  "                           series after the run\n"
+  "    -i ipctype             Select IPC object type (default: %s)\n"
+  "                             pipe       pipe\n"
+  "                             local      local stream socket pair\n"
+  "                             tcp        TCP socket over loopback\n"
+  "                             udp        UDP socket over loopback\n"
+  "                             dgram      local datagram socket pair\n"
+  "                             seqpacket  local seqpacket socket pair\n"
+  "    -k producers           Fan in from this many sender threads/processes,\n"
+  "                           verifying their tagged records (max %d)\n"
+  "    -l                     Busy-poll: spin on non-blocking reads, and compare\n"
+  "                           with blocking; -ll also spins the sender\n"
+  "    -L                     Share one connrate accept queue, not SO_REUSEPORT\n"
+  "    -M method[:target]     Select spawn creation method (default: %s):\n"
+  "                             fork         fork(); the child exits\n"
+  "                             vfork        vfork(); the child exits\n"
+#ifdef __linux__
+  "                             clone        clone() sharing memory, files\n"
+  "                                          and signal handlers\n"
+#endif
+  "                             pthread      pthread_create(), pthread_join()\n"
+  "                             forkexec     fork(), then exec target\n"
+  "                             vforkexec    vfork(), then exec target\n"
+  "                             posix_spawn  posix_spawn() target\n"
+  "                           Target defaults to this program, which exits at\n"
+  "                           once; e.g. compare ipc-static and ipc-dynamic\n"
+  "    -m batch               Messages per sendmmsg()/recvmmsg() (default: %u)\n"
+  "    -n count               Set connrate connections or spawn creations\n"
+  "                           (default: %d)\n"
+  "    -O opt=value[:value...][,...]\n"
+  "                           Set TCP socket options; one or more of:\n"
+  "                             sndbuf=bytes, rcvbuf=bytes, nodelay[=0|1],\n"
+  "                             cork[=0|1], rcvlowat=bytes,\n"
+#ifdef TCP_NOTSENT_LOWAT
+  "                             notsent_lowat=bytes,\n"
+#endif
+#ifdef TCP_CONGESTION
+  "                             cc=algorithm,\n"
+#endif
+#ifdef SO_BUSY_POLL
+  "                             busy_poll=usec\n"
+#endif
+#ifdef SO_ZEROCOPY
+  "    -N nbufs               Set MSG_ZEROCOPY send-buffer pool size (default: %u)\n"
+#endif
+  "    -p port                Set TCP/UDP port number (default: %u)\n"
+#ifdef WITH_PMC
+  "    -P l1d|l1i|l2|mem|tlb|axi  Enable hardware performance counters\n"
+#endif
+#ifdef WITH_PERF
+  "    -P set[,set...]        Count perf events per sender and receiver:\n"
+  "                             llc     last-level cache references, misses\n"
+  "                             l1d     L1 data-cache loads, load misses\n"
+  "                             branch  branches, branch misses\n"
+  "                             dtlb    dTLB load and store misses (walks)\n"
+  "                             ctxsw   context switches, migrations, faults\n"
+#endif
+  "    -q                     Just run the benchmark, don't print stuff out\n"
+#ifdef WITH_IO_URING
+  "    -Q qdepth              Set io_uring queue depth (default: %u)\n"
+  "    -S                     Use io_uring kernel submission polling (SQPOLL)\n"
+#endif
+  "    -R                     Report rusage, /proc/self/io and vmstat deltas,\n"
+  "                           and CPU, syscalls and switches per unit of data\n"
+  "    -r rss                 Fault in this many bytes of spawn parent memory\n"
+  "    -s                     Set send/receive socket-buffer sizes to buffersize\n"
+  "    -T seconds             Run for this long rather than for totalsize\n"
+  "    -u payload             Consume each received buffer by (default: none):\n"
+  "                             touch     loading one byte per cache line\n"
+  "                             memcpy    memcpy() to an application buffer\n"
+  "                             checksum  checksumming (verified against -g)\n"
+  "                             stream    non-temporal copy to an app buffer\n"
+  "    -v                     Provide a verbose benchmark description\n"
+  "    -W                     Sweep all combinations of -O values on TCP\n"
+#ifdef F_SETPIPE_SZ
+  "                           or of pipe capacity and buffer size on pipes\n"
+#endif
+#ifdef WITH_PERF
+  "    -X event[:period]      Profile the timed region, sampling every period\n"
+  "                           events; report the hottest symbols. Events:\n"
+  "                             cycles, instructions, cache-misses,\n"
+  "                             cpu-clock (period in ns)\n"
+#endif
+  "    -y usec                Sample TCP_INFO on both endpoints every usec\n"
+#ifdef F_SETPIPE_SZ
+  "    -z capacity            Set pipe capacity with F_SETPIPE_SZ\n"
+#endif
+#ifdef __linux__
+  "    -Z profile[,...]       Select scenario profiles (default: all):\n"
+  "                             rtt0, rtt1, rtt10, rtt50, rtt100,\n"
+  "                             jitter (rtt50, 10ms), lossy (rtt50, 0.1%%),\n"
+  "                             wan100 (rtt50, 100mbit)\n"
+#endif
+  "    -b buffersize          Specify a buffer size (default: %ld)\n"
+  "    -t totalsize           Specify total I/O size (default: %ld)\n",
+	    benchmark_mode_to_string(BENCHMARK_MODE_DEFAULT),
+	    BENCHMARK_TCP_ADDR_DEFAULT,
+	    CONNRATE_ACCEPTORS_DEFAULT, CONNRATE_CLIENTS_DEFAULT,
+	    benchmark_engine_to_string(BENCHMARK_ENGINE_DEFAULT),
+#ifdef SPLICE_F_GIFT
+	    SPLICE_SINK_DEFAULT,
+#endif
+	    ipc_type_to_string(BENCHMARK_IPC_DEFAULT), FANIN_PRODUCERS_MAX,
+	    spawn_method_to_string(SPAWN_METHOD_DEFAULT),
+	    DGRAM_BATCH_DEFAULT, ITERATIONS_DEFAULT,
+#ifdef SO_ZEROCOPY
+	    ZEROCOPY_NBUFS_DEFAULT,
+#endif
+	    BENCHMARK_TCP_PORT_DEFAULT,
+#ifdef WITH_IO_URING
+	    URING_QDEPTH_DEFAULT,
+#endif
+	    BUFFERSIZE, TOTALSIZE);
+	exit(EX_USAGE);
+}
+
+/*
+ * Chunk headers (-H).  The sender stamps the start of each buffersize chunk
+ * with a sequence number and a CLOCK_MONOTONIC send time, just before its
+ * write().  The receiver's read loop already lands each chunk at the same
+ * offsets in its buffer however the reads are split, so when the last byte
+ * of a chunk arrives its header is intact at the start of the buffer, and
+ * we record that chunk's one-way latency.  Latency by position within the
+ * transfer shows queueing delay building up as the IPC buffer fills.
+ */
+struct chunk_header {
+	uint64_t	ch_seq;
+	uint64_t	ch_sendtime;	/* CLOCK_MONOTONIC ns */
+};
+
+#define	CHUNK_HISTOGRAM_BUCKETS	32	/* Powers of two, in us */
+#define	CHUNK_POSITIONS		10	/* Deciles of the transfer */
+
+static uint64_t *chunk_latencies;	/* ns, indexed by sequence number */
+
+static void
+chunk_stamp(void *buf, uint64_t seq)
+{
+	struct chunk_header ch;
+
+	ch.ch_seq = seq;
+	ch.ch_sendtime = monotonic_ns();
+	memcpy(buf, &ch, sizeof(ch));
+}
+
+static void
+chunk_receive(const void *buf, uint64_t seq)
+{
+	struct chunk_header ch;
+	uint64_t now;
+
+	now = monotonic_ns();
+	memcpy(&ch, buf, sizeof(ch));
+	if (ch.ch_seq != seq)
+		errx(EX_SOFTWARE, "FAIL: chunk %ju arrived as chunk %ju",
+		    (uintmax_t)ch.ch_seq, (uintmax_t)seq);
+	chunk_latencies[seq] = now - ch.ch_sendtime;
+}
+
+/*
+ * Median chunk latency in ns; reorders the latencies.
+ */
+static double
+chunk_median(long blockcount)
+{
+
+	qsort(chunk_latencies, blockcount, sizeof(*chunk_latencies),
+	    uint64_compare);
+	return (chunk_latencies[blockcount / 2]);
+}
+
+static void
+chunk_print(long blockcount)
+{
+	uint64_t histogram[CHUNK_HISTOGRAM_BUCKETS], *l;
+	double position[CHUNK_POSITIONS], sum;
+	const char *sep;
+	long i, n;
+	int b;
+
+	bzero(histogram, sizeof(histogram));
+	bzero(position, sizeof(position));
+	sum = 0;
+	for (i = 0; i < blockcount; i++) {
+		for (b = 0; b < CHUNK_HISTOGRAM_BUCKETS - 1 &&
+		    chunk_latencies[i] / 1000 >= (1ULL << b); b++);
+		histogram[b]++;
+		position[i * CHUNK_POSITIONS / blockcount] +=
+		    chunk_latencies[i];
+		sum += chunk_latencies[i];
+	}
+	printf("chunk latency by position (mean us):");
+	sep = " ";
+	for (b = 0; b < CHUNK_POSITIONS; b++) {
+		n = (b + 1) * blockcount / CHUNK_POSITIONS -
+		    b * blockcount / CHUNK_POSITIONS;
+		if (n == 0)
+			continue;
+		printf("%s%d%%: %.1F", sep, b * 100 / CHUNK_POSITIONS,
+		    position[b] / n / 1000);
+		sep = ", ";
+	}
+	printf("\n");
+
+	l = chunk_latencies;
+	qsort(l, blockcount, sizeof(*l), uint64_compare);
+	printf("chunk latency (us): min %.1F, p50 %.1F, p90 %.1F, p99 %.1F, "
+	    "max %.1F, mean %.1F\n", l[0] / 1000.0,
+	    l[blockcount * 50 / 100] / 1000.0,
+	    l[blockcount * 90 / 100] / 1000.0,
+	    l[blockcount * 99 / 100] / 1000.0, l[blockcount - 1] / 1000.0,
+	    sum / blockcount / 1000);
+	printf("chunk latency histogram (us):\n");
+	for (b = 0; b < CHUNK_HISTOGRAM_BUCKETS; b++) {
+		if (histogram[b] == 0)
+			continue;
+		if (b == 0)
+			printf("  %10s < %-10llu", "", 1ULL);
+		else
+			printf("  %10llu - %-10llu", 1ULL << (b - 1), 1ULL << b);
+		printf(" %8ju (%.1F%%)\n", (uintmax_t)histogram[b],
+		    100.0 * histogram[b] / blockcount);
+	}
+}
+
+/*
+ * Payload modelling (-g, -u).  By default the sender rewrites an untouched
+ * buffer and the receiver never looks at what it read, so both stay hot in
+ * the cache.  Instead the sender can produce each buffer before writing it,
+ * and the receiver consume each buffer once it is complete, by touching one
+ * byte per cache line, by memcpy() from or to a separate application
+ * buffer, by generating or checksumming every word, or by non-temporal
+ * streaming stores that bypass the cache (SSE2 only; elsewhere, ordinary
+ * stores).  If both ends checksum, the receiver verifies the data.
+ */
+#define	PAYLOAD_NONE_STRING	"none"
+#define	PAYLOAD_TOUCH_STRING	"touch"
+#define	PAYLOAD_MEMCPY_STRING	"memcpy"
+#define	PAYLOAD_CHECKSUM_STRING	"checksum"
+#define	PAYLOAD_STREAM_STRING	"stream"
+
+#define	PAYLOAD_INVALID		-1
+#define	PAYLOAD_NONE		0
+#define	PAYLOAD_TOUCH		1
+#define	PAYLOAD_MEMCPY		2
+#define	PAYLOAD_CHECKSUM	3
+#define	PAYLOAD_STREAM		4
+
+#define	PAYLOAD_CACHELINE	64	/* Bytes; true of most current CPUs */
+
+static int payload_produce = PAYLOAD_NONE;	/* Sender (-g) */
+static int payload_consume = PAYLOAD_NONE;	/* Receiver (-u) */
+
+/*
+ * Results of touching are stored here so that the loads are not elided.
+ */
+static volatile uint64_t payload_sink;
+
+static int
+payload_from_string(const char *string)
+{
+
+	if (strcmp(PAYLOAD_TOUCH_STRING, string) == 0)
+		return (PAYLOAD_TOUCH);
+	else if (strcmp(PAYLOAD_MEMCPY_STRING, string) == 0)
+		return (PAYLOAD_MEMCPY);
+	else if (strcmp(PAYLOAD_CHECKSUM_STRING, string) == 0)
+		return (PAYLOAD_CHECKSUM);
+	else if (strcmp(PAYLOAD_STREAM_STRING, string) == 0)
+		return (PAYLOAD_STREAM);
+	else
+		return (PAYLOAD_INVALID);
+}
+
+static const char *
+payload_to_string(int payload)
+{
+
+	switch (payload) {
+	case PAYLOAD_TOUCH:
+		return (PAYLOAD_TOUCH_STRING);
+
+	case PAYLOAD_MEMCPY:
+		return (PAYLOAD_MEMCPY_STRING);
+
+	case PAYLOAD_CHECKSUM:
+		return (PAYLOAD_CHECKSUM_STRING);
+
+	case PAYLOAD_STREAM:
+		return (PAYLOAD_STREAM_STRING);
+
+	default:
+		return (PAYLOAD_NONE_STRING);
+	}
+}
+
+/*
+ * Application buffer for memcpy() and streaming, aligned for the latter and
+ * faulted in up front.
+ */
+static void *
+payload_appbuf(int payload)
+{
+	void *appbuf;
+
+	if (payload != PAYLOAD_MEMCPY && payload != PAYLOAD_STREAM)
+		return (NULL);
+	if (posix_memalign(&appbuf, PAYLOAD_CACHELINE, buffersize) != 0)
+		err(EX_OSERR, "FAIL: posix_memalign");
+	memset(appbuf, 0xa5, buffersize);
+	return (appbuf);
+}
+
+/*
+ * Copy with non-temporal stores to 'dst', which must be 16-byte aligned.
+ */
+static void
+payload_stream_copy(void *dst, const void *src, size_t len)
+{
+#ifdef __SSE2__
+	const __m128i *s = src;
+	__m128i *d = dst;
+	size_t i;
+
+	for (i = 0; i < len / sizeof(*d); i++)
+		_mm_stream_si128(&d[i], _mm_loadu_si128(&s[i]));
+	_mm_sfence();
+	memcpy(&d[i], &s[i], len % sizeof(*d));
+#else
+	memcpy(dst, src, len);
+#endif
+}
+
+static uint64_t
+payload_checksum(const void *buf, size_t len)
+{
+	const unsigned char *p = buf;
+	uint64_t sum, word;
+	size_t i;
+
+	sum = 0;
+	for (i = 0; i + sizeof(word) <= len; i += sizeof(word)) {
+		memcpy(&word, p + i, sizeof(word));
+		sum += word;
+	}
+	for (; i < len; i++)
+		sum += p[i];
+	return (sum);
+}
+
+static void
+payload_produce_buffer(void *buf, size_t len, void *appbuf, uint64_t seq)
+{
+	unsigned char *p = buf;
+	uint64_t word;
+	size_t i;
+
+	switch (payload_produce) {
+	case PAYLOAD_TOUCH:
+		for (i = 0; i < len; i += PAYLOAD_CACHELINE)
+			p[i] = seq;
+		break;
+
+	case PAYLOAD_MEMCPY:
+		memcpy(buf, appbuf, len);
+		break;
+
+	case PAYLOAD_CHECKSUM:
+		/* Generate data that differs between buffers: xorshift64. */
+		word = seq + 1;
+		for (i = 0; i + sizeof(word) <= len; i += sizeof(word)) {
+			word ^= word << 13;
+			word ^= word >> 7;
+			word ^= word << 17;
+			memcpy(p + i, &word, sizeof(word));
+		}
+		for (; i < len; i++)
+			p[i] = seq;
+		break;
+
+	case PAYLOAD_STREAM:
+		payload_stream_copy(buf, appbuf, len);
+		break;
+	}
+}
+
+/*
+ * Consume a complete buffer, returning its checksum if required.
+ */
+static uint64_t
+payload_consume_buffer(const void *buf, size_t len, void *appbuf)
+{
+	const unsigned char *p = buf;
+	uint64_t sum;
+	size_t i;
+
+	switch (payload_consume) {
+	case PAYLOAD_TOUCH:
+		sum = 0;
+		for (i = 0; i < len; i += PAYLOAD_CACHELINE)
+			sum += p[i];
+		payload_sink = sum;
+		break;
+
+	case PAYLOAD_MEMCPY:
+		memcpy(appbuf, buf, len);
+		break;
+
+	case PAYLOAD_CHECKSUM:
+		return (payload_checksum(buf, len));
+
+	case PAYLOAD_STREAM:
+		payload_stream_copy(appbuf, buf, len);
+		break;
+	}
+	return (0);
+}
+
+/*
+ * Message-size distributions (-D).  Rather than writing buffersize bytes
+ * every time, the sender can write messages whose sizes are drawn from a
+ * distribution: fixed, uniform over a range, bimodal (a percentage of large
+ * messages among small ones), log-normal (by median and sigma), or replayed
+ * from a histogram file of "size weight" lines.  Sizes are capped at
+ * buffersize, and drawn with a fixed seed before the run, so that every run
+ * writes the same sequence and drawing costs nothing while timed; the last
+ * message is trimmed so that the sizes sum to totalsize, which the receiver
+ * reads as usual.  The sender times each write(), and results are broken
+ * down by power-of-two size class.
+ */
+#define	MSGSIZE_FIXED_STRING		"fixed"
+#define	MSGSIZE_UNIFORM_STRING		"uniform"
+#define	MSGSIZE_BIMODAL_STRING		"bimodal"
+#define	MSGSIZE_LOGNORMAL_STRING	"lognormal"
+#define	MSGSIZE_FILE_STRING		"file"
+
+#define	MSGSIZE_NONE		0
+#define	MSGSIZE_FIXED		1
+#define	MSGSIZE_UNIFORM		2
+#define	MSGSIZE_BIMODAL		3
+#define	MSGSIZE_LOGNORMAL	4
+#define	MSGSIZE_FILE		5
+
+#define	MSGSIZE_CLASSES		32
+#define	MSGSIZE_SEED		41
+
+static unsigned int msgsize_dist = MSGSIZE_NONE;
+static double msgsize_param[3];		/* Distribution parameters. */
+static const char *msgsize_path;	/* Histogram file. */
+static long *msgsize_hist;		/* Histogram sizes ... */
+static double *msgsize_weight;		/* ... and cumulative weights. */
+static long msgsize_nhist;
+
+static long *msgsizes;			/* The messages to send. */
+static long msgsize_count;
+
+/*
+ * Parse "name[:param...]"; returns -1 if the specification is invalid.
+ */
+static int
+msgsize_parse(char *spec)
+{
+	static const struct {
+		const char	*ms_name;
+		unsigned int	 ms_dist;
+		int		 ms_nparams;
+	} dists[] = {
+		{ MSGSIZE_FIXED_STRING, MSGSIZE_FIXED, 1 },
+		{ MSGSIZE_UNIFORM_STRING, MSGSIZE_UNIFORM, 2 },
+		{ MSGSIZE_BIMODAL_STRING, MSGSIZE_BIMODAL, 3 },
+		{ MSGSIZE_LOGNORMAL_STRING, MSGSIZE_LOGNORMAL, 2 },
+	};
+	char *name, *param, *endp;
+	unsigned int i;
+	int n;
+
+	name = strsep(&spec, ":");
+	if (strcmp(name, MSGSIZE_FILE_STRING) == 0) {
+		if (spec == NULL || *spec == '\0')
+			return (-1);
+		msgsize_dist = MSGSIZE_FILE;
+		msgsize_path = spec;
+		return (0);
+	}
+	for (i = 0; i < sizeof(dists) / sizeof(dists[0]); i++)
+		if (strcmp(name, dists[i].ms_name) == 0)
+			break;
+	if (i == sizeof(dists) / sizeof(dists[0]))
+		return (-1);
+	msgsize_dist = dists[i].ms_dist;
+	for (n = 0; (param = strsep(&spec, ":")) != NULL; n++) {
+		if (n == dists[i].ms_nparams)
+			return (-1);
+		msgsize_param[n] = strtod(param, &endp);
+		if (*param == '\0' || *endp != '\0' || msgsize_param[n] < 0)
+			return (-1);
+	}
+
+	/* A fixed size defaults to buffersize. */
+	if (msgsize_dist == MSGSIZE_FIXED && n == 0)
+		return (0);
+	if (n != dists[i].ms_nparams)
+		return (-1);
+	switch (msgsize_dist) {
+	case MSGSIZE_UNIFORM:
+		if (msgsize_param[0] > msgsize_param[1])
+			return (-1);
+		break;
+
+	case MSGSIZE_BIMODAL:
+		if (msgsize_param[2] > 100)
+			return (-1);
+		break;
+	}
+	return (0);
+}
+
+static const char *
+msgsize_to_string(unsigned int dist)
+{
+
+	switch (dist) {
+	case MSGSIZE_FIXED:
+		return (MSGSIZE_FIXED_STRING);
+	case MSGSIZE_UNIFORM:
+		return (MSGSIZE_UNIFORM_STRING);
+	case MSGSIZE_BIMODAL:
+		return (MSGSIZE_BIMODAL_STRING);
+	case MSGSIZE_LOGNORMAL:
+		return (MSGSIZE_LOGNORMAL_STRING);
+	case MSGSIZE_FILE:
+		return (MSGSIZE_FILE_STRING);
+	default:
+		return (NULL);
+	}
+}
+
+static void
+msgsize_load(void)
+{
+	char line[128];
+	double weight, total;
+	long lineno, size;
+	FILE *fp;
+
+	fp = fopen(msgsize_path, "r");
+	if (fp == NULL)
+		err(EX_NOINPUT, "FAIL: %s", msgsize_path);
+	total = 0;
+	for (lineno = 1; fgets(line, sizeof(line), fp) != NULL; lineno++) {
+		if (line[0] == '#' || line[strspn(line, " \t\n")] == '\0')
+			continue;
+		if (sscanf(line, "%ld %lf", &size, &weight) != 2 ||
+		    size <= 0 || weight < 0)
+			errx(EX_DATAERR, "FAIL: %s:%ld: expected \"size weight\"",
+			    msgsize_path, lineno);
+		msgsize_hist = realloc(msgsize_hist,
+		    (msgsize_nhist + 1) * sizeof(*msgsize_hist));
+		msgsize_weight = realloc(msgsize_weight,
+		    (msgsize_nhist + 1) * sizeof(*msgsize_weight));
+		if (msgsize_hist == NULL || msgsize_weight == NULL)
+			err(EX_OSERR, "FAIL: realloc");
+		total += weight;
+		msgsize_hist[msgsize_nhist] = size;
+		msgsize_weight[msgsize_nhist] = total;
+		msgsize_nhist++;
+	}
+	if (ferror(fp))
+		err(EX_IOERR, "FAIL: %s", msgsize_path);
+	fclose(fp);
+	if (total <= 0)
+		errx(EX_DATAERR, "FAIL: %s: no weighted sizes", msgsize_path);
+}
+
+static long
+msgsize_draw(void)
+{
+	double r, u1, u2;
+	long lo, hi, mid;
+
+	switch (msgsize_dist) {
+	case MSGSIZE_FIXED:
+		return (msgsize_param[0] > 0 ? msgsize_param[0] : buffersize);
+
+	case MSGSIZE_UNIFORM:
+		return (msgsize_param[0] + drand48() *
+		    (msgsize_param[1] - msgsize_param[0] + 1));
+
+	case MSGSIZE_BIMODAL:
+		return (drand48() * 100 < msgsize_param[2] ?
+		    msgsize_param[1] : msgsize_param[0]);
+
+	case MSGSIZE_LOGNORMAL:
+		/* Box-Muller for a standard normal deviate. */
+		u1 = 1 - drand48();
+		u2 = drand48();
+		return (msgsize_param[0] * exp(msgsize_param[1] *
+		    sqrt(-2 * log(u1)) * cos(2 * M_PI * u2)));
+
+	case MSGSIZE_FILE:
+		r = drand48() * msgsize_weight[msgsize_nhist - 1];
+		lo = 0;
+		hi = msgsize_nhist - 1;
+		while (lo < hi) {
+			mid = (lo + hi) / 2;
+			if (msgsize_weight[mid] <= r)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return (msgsize_hist[lo]);
+
+	default:
+		assert(0);
+	}
+}
+
+static void
+msgsize_generate(void)
+{
+	long cap, size, sum;
+
+	if (msgsize_dist == MSGSIZE_FILE)
+		msgsize_load();
+	srand48(MSGSIZE_SEED);
+	cap = 0;
+	for (sum = 0; sum < totalsize; sum += size) {
+		size = min(max(msgsize_draw(), 1), buffersize);
+		size = min(size, totalsize - sum);
+		if (msgsize_count == cap) {
+			cap = max(cap * 2, 1024);
+			msgsizes = realloc(msgsizes, cap * sizeof(*msgsizes));
+			if (msgsizes == NULL)
+				err(EX_OSERR, "FAIL: realloc");
+		}
+		msgsizes[msgsize_count++] = size;
+	}
+}
+
+static unsigned int
+msgsize_class(long size)
+{
+	unsigned int c;
+
+	for (c = 0; c < MSGSIZE_CLASSES - 1 && size >= (2L << c); c++);
+	return (c);
+}
+
+/*
+ * Print messages, their share of the bytes, and the sender's mean write()
+ * time and throughput, by size class.
+ */
+static void
+msgsize_print(const uint64_t *class_ns)
+{
+	long count[MSGSIZE_CLASSES], bytes[MSGSIZE_CLASSES];
+	unsigned int c;
+	long i;
+
+	bzero(count, sizeof(count));
+	bzero(bytes, sizeof(bytes));
+	for (i = 0; i < msgsize_count; i++) {
+		c = msgsize_class(msgsizes[i]);
+		count[c]++;
+		bytes[c] += msgsizes[i];
+	}
+	printf("message sizes: %s, %ld messages, mean %.1F bytes\n",
+	    msgsize_to_string(msgsize_dist), msgsize_count,
+	    (double)totalsize / msgsize_count);
+	for (c = 0; c < MSGSIZE_CLASSES; c++) {
+		if (count[c] == 0)
+			continue;
+		printf("  %10ld - %-10ld %9ld (%5.1F%%), %5.1F%% of bytes, "
+		    "%9.2F us/write, %.2F KBytes/sec\n", 1L << c,
+		    (2L << c) - 1, count[c], 100.0 * count[c] / msgsize_count,
+		    100.0 * bytes[c] / totalsize,
+		    class_ns[c] / 1000.0 / count[c], class_ns[c] == 0 ? 0 :
+		    bytes[c] / (class_ns[c] / 1000000000.0) / 1024);
+	}
+}
+
+/*
+ * Fan-in (-k).  Several producers -- threads in 2thread mode, processes in
+ * 2proc mode -- share the one write descriptor, each writing its share of
+ * the blocks as buffersize records.  Every 64-bit word of a record holds
+ * the producer number and that producer's sequence number, so the receiver
+ * can tell a record torn by interleaving from an intact one, and check that
+ * each producer's records arrive in order: a record older than one already
+ * seen is out of order, whereas a record that never arrives intact, as when
+ * torn, is missing, and only leaves a gap.  POSIX only promises that pipe
+ * writes of up to PIPE_BUF bytes are atomic.  Each producer's throughput
+ * runs from the common start to the arrival of its last record; Jain's
+ * index summarises how fairly they shared the descriptor (1.0 is perfectly
+ * fair, 1/K is one producer taking everything).
+ */
+struct fanin_stats {
+	long		fs_expected;	/* Records this producer sends. */
+	long		fs_records;	/* Intact records received. */
+	long		fs_reordered;	/* ... older than one already seen. */
+	uint32_t	fs_next;	/* One past the newest seen. */
+	struct timespec	fs_finishtime;	/* Arrival of the last record. */
+};
+
+static struct fanin_stats *fanin_stats;
+static long fanin_torn;
+
+static void
+fanin_tag(void *buf, unsigned int producer, uint32_t seq)
+{
+	uint64_t tag, *p;
+	long i;
+
+	tag = (uint64_t)producer << 32 | seq;
+	p = buf;
+	for (i = 0; i < buffersize / (long)sizeof(tag); i++)
+		p[i] = tag;
+}
+
+static void
+fanin_reset(long blockcount)
+{
+	unsigned int i;
+
+	fanin_torn = 0;
+	bzero(fanin_stats, fanin_producers * sizeof(*fanin_stats));
+	for (i = 0; i < fanin_producers; i++)
+		fanin_stats[i].fs_expected = blockcount / fanin_producers +
+		    (i < blockcount % fanin_producers);
+}
+
+static void
+fanin_receive(const void *buf)
+{
+	struct fanin_stats *fsp;
+	const uint64_t *p;
+	uint64_t tag;
+	long i;
+
+	p = buf;
+	tag = p[0];
+	for (i = 1; i < buffersize / (long)sizeof(tag); i++) {
+		if (p[i] != tag) {
+			fanin_torn++;
+			return;
+		}
+	}
+	if (tag >> 32 >= fanin_producers) {
+		fanin_torn++;
+		return;
+	}
+	fsp = &fanin_stats[tag >> 32];
+	if ((uint32_t)tag < fsp->fs_next)
+		fsp->fs_reordered++;
+	else
+		fsp->fs_next = (uint32_t)tag + 1;
+	if (++fsp->fs_records == fsp->fs_expected &&
+	    clock_gettime(CLOCK_REALTIME, &fsp->fs_finishtime) < 0)
+		err(EX_OSERR, "FAIL: clock_gettime");
+}
+
+/*
+ * A producer whose records did not all arrive intact is taken to have
+ * finished with the run.
+ */
+static void
+fanin_print(struct timespec starttime, struct timespec ts)
+{
+	struct fanin_stats *fsp;
+	struct timespec elapsed;
+	double rate, sum, sumsq, slowest, fastest;
+	long missing, reordered;
+	unsigned int i;
+
+	missing = reordered = 0;
+	for (i = 0; i < fanin_producers; i++) {
+		missing += fanin_stats[i].fs_expected -
+		    fanin_stats[i].fs_records;
+		reordered += fanin_stats[i].fs_reordered;
+	}
+	printf("fan-in: %u producers, %ld torn records, %ld missing, %ld out "
+	    "of order", fanin_producers, fanin_torn, missing, reordered);
+	if (ipc_type == BENCHMARK_IPC_PIPE)
+		printf(" (PIPE_BUF %d)", PIPE_BUF);
+	printf("\n");
+	sum = sumsq = fastest = 0;
+	slowest = -1;
+	for (i = 0; i < fanin_producers; i++) {
+		fsp = &fanin_stats[i];
+		elapsed = ts;
+		if (fsp->fs_records == fsp->fs_expected) {
+			elapsed = fsp->fs_finishtime;
+			timespecsub(&elapsed, &starttime);
+		}
+		rate = fsp->fs_records * buffersize /
+		    (timespec_ns(elapsed) / 1000000000) / 1024;
+		printf("  producer %u: %ld of %ld records, %ld missing, %ld out "
+		    "of order, %.2F KBytes/sec\n", i, fsp->fs_records,
+		    fsp->fs_expected, fsp->fs_expected - fsp->fs_records,
+		    fsp->fs_reordered, rate);
+		sum += rate;
+		sumsq += rate * rate;
+		fastest = max(fastest, rate);
+		if (slowest < 0 || rate < slowest)
+			slowest = rate;
+	}
+	printf("fan-in fairness: Jain %.3F, slowest/fastest %.3F\n",
+	    sumsq > 0 ? sum * sum / (fanin_producers * sumsq) : 0,
+	    fastest > 0 ? slowest / fastest : 0);
+}
+
+/*
+ * Duration-limited runs (-T).  The sender arms the timer (see duration.c).
+ * On expiry, it publishes the byte count at which it will stop, and only
+ * then writes its last buffer: the receiver rereads that limit after every
+ * read(), so it cannot block waiting for data that will never come.  -t
+ * still sizes the buffers, but no longer bounds the run.  With -I, it is
+ * the receiver's byte count that is sampled, as the TCP_INFO sampler does.
+ *
+ * Shared across fork() with 2proc senders.
+ */
+struct duration_shared {
+	long	ds_limit;	/* Bytes to be sent; LONG_MAX until expiry. */
+};
+
+static struct duration_shared *duration_shared;
+
+static void
+duration_limit_setup(void)
+{
+
+	if (duration_shared == NULL) {
+		duration_shared = mmap(NULL, sizeof(*duration_shared),
+		    PROT_READ | PROT_WRITE, MAP_ANON | MAP_SHARED, -1, 0);
+		if (duration_shared == MAP_FAILED)
+			err(EX_OSERR, "FAIL: mmap");
+	}
+	duration_shared->ds_limit = LONG_MAX;
+	duration_setup();
+}
+
+/*
+ * Null system calls for calibration (-C), on the IPC object itself.  The
+ * two sides' harness costs add up in 1thread mode, but overlap in the
+ * others, where the dearer side sets the pace.
+ */
+static void
+calibrate_read(int fd, void *buf)
+{
+
+	if (read(fd, buf, 0) < 0)
+		err(EX_IOERR, "FAIL: read");
+}
+
+static void
+calibrate_write(int fd, void *buf)
+{
+
+	if (write(fd, buf, 0) < 0)
+		err(EX_IOERR, "FAIL: write");
+}
+
+/*
+ * The IPC benchmark itself.
+ * XXX
+ *
+ * The I/O benchmark itself.  Perform any necessary setup.  Open the file or
+ * device.  Take a timestamp.  Perform the work.  Take another timestamp.
+ * (Optionally) print the results.
+ */
+
+/*
+ * Whether using threads or processes, we have the second thread/process do
+ * the sending, and the first do the receiving, so that it reliably knows when
+ * the benchmark is done.  The sender will write the timestamp to shared
+ * memory before sending any bytes, so the receipt of any byte means that the
+ * timestamp has been stored.
+ *
+ * XXXRW: If we run this benchmark on multicore, we may want to put in a
+ * memory barrier of some sort on either side, although because a system call
+ * is involved, it is probably not necessary.  I wonder what C and POSIX have
+ * to say about that.
+ */
+struct sender_stats {
+	struct timespec	 ss_cputime;	/* Sender thread CPU time. */
+	uint64_t	 ss_cycles;	/* Sender thread CPU cycles, or 0. */
+	long		 ss_zc_sends;	/* MSG_ZEROCOPY sends completed. */
+	long		 ss_zc_copied;	/* ... where the kernel copied. */
+	uint64_t	 ss_checksum;	/* Payload checksum (-g checksum). */
+	long		 ss_writes;	/* write() calls, for -C. */
+	struct spin_stats ss_spin;	/* Busy polling (-ll). */
+	uint64_t	 ss_class_ns[MSGSIZE_CLASSES];	/* write() by -D class. */
+#ifdef WITH_PERF
+	struct perf_counts ss_perf;	/* Sender counts (-P). */
+#endif
+};
+
+struct sender_argument {
+	struct timespec	 sa_starttime;	/* Sender stores start time here. */
+	int		 sa_writefd;	/* Caller provides send fd here. */
+	long		 sa_blockcount;	/* Caller provides block count here. */
+	void		*sa_buffer;	/* Caller provides buffer here. */
+	unsigned int	 sa_producer;	/* Caller provides fan-in producer. */
+	struct sender_stats sa_stats;	/* Sender stores statistics here. */
+};
+
+/*
+ * Statistics from the sender in the most recent 2thread/2proc run.
+ */
+static struct sender_stats sender_stats;
+
+/*
+ * Start of the timed region in the most recent run.
+ */
+static struct timespec benchmark_starttime;
+
+static void
+sender(struct sender_argument *sap)
+{
+	struct timespec cputime;
+	uint64_t writestart;
+	ssize_t len, more;
+	long msg, sendsize, write_sofar;
+	void *appbuf, *dgram_buf;
+	char name[20];
+#ifdef __linux__
+	int cyclesfd;
+#endif
+#ifdef WITH_PERF
+	struct perf_state ps;
+	struct prof_state pr;
+#endif
+#ifdef WITH_IO_URING
+	struct uring u;
+#endif
+#ifdef SPLICE_F_GIFT
+	void *ring;
+	long ringsize;
+#endif
+#ifdef SO_ZEROCOPY
+	struct zerocopy_pool zp;
+#endif
+
+	bzero(&sap->sa_stats, sizeof(sap->sa_stats));
+	switch (benchmark_engine) {
+	case BENCHMARK_ENGINE_RW:
+		if (ipc_type_datagram(ipc_type)) {
+			dgram_buf = calloc(dgram_batch, buffersize);
+			if (dgram_buf == NULL)
+				err(EX_OSERR, "FAIL: calloc");
+		}
+		appbuf = payload_appbuf(payload_produce);
+		if (lflag > 1)
+			spin_nonblock(sap->sa_writefd, 1);
+		break;
+
+#ifdef WITH_IO_URING
+	case BENCHMARK_ENGINE_URING:
+		uring_setup(&u, sap->sa_writefd, sap->sa_buffer, buffersize);
+		break;
+#endif
+#ifdef SPLICE_F_GIFT
+	case BENCHMARK_ENGINE_VMSPLICE:
+	case BENCHMARK_ENGINE_SPLICE:
+		ringsize = vmsplice_ringsize(sap->sa_writefd);
+		ring = vmsplice_ring(ringsize);
+		break;
+#endif
+#ifdef SO_ZEROCOPY
+	case BENCHMARK_ENGINE_ZEROCOPY:
+		zerocopy_setup(&zp, sap->sa_writefd);
+		break;
+#endif
+	}
+#ifdef __linux__
+	/*
+	 * Only zero-copy comparisons need sender cycles, so that other runs
+	 * do not pay for a hardware counter; -P's, if it counts them, serve.
+	 */
+	cyclesfd = -1;
+	if (zerocopy_compare) {
+#ifdef WITH_PERF
+		if (!perf_cycles(NULL, NULL))
+#endif
+			cyclesfd = thread_cycles_open();
+	}
+#endif
+#ifdef WITH_PERF
+	if (perf_nsets != 0)
+		perf_open(&ps);
+	if (prof_event != NULL)
+		prof_open(&pr);
+#endif
+	if (fanin_producers)
+		snprintf(name, sizeof(name), "sender %u", sap->sa_producer);
+	else
+		snprintf(name, sizeof(name), "sender");
+	trace_attach(1 + sap->sa_producer, name);
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cputime) < 0)
+		err(EX_OSERR, "FAIL: clock_gettime");
+
+	if (clock_gettime(CLOCK_REALTIME, &sap->sa_starttime) < 0)
+		err(EX_OSERR, "FAIL: clock_gettime");
+	if (duration_secs != 0)
+		duration_arm();
+#ifdef WITH_PMC
+	if (benchmark_pmc != BENCHMARK_PMC_NONE)
+		pmc_begin();
+#endif
+#ifdef WITH_PERF
+	if (perf_nsets != 0)
+		perf_begin(&ps);
+	if (prof_event != NULL)
+		prof_begin(&pr);
+#endif
+
+	/*
+	 * HERE BEGINS THE BENCHMARK (2-thread/2-proc).  The benchmark probes
+	 * fire in the process that times the run, which is the receiver's,
+	 * except in client mode, where there is no local receiver.
+	 */
+	if (benchmark_mode == BENCHMARK_MODE_CLIENT &&
+	    IPCBENCH_BENCHMARK_START_ENABLED())
+		IPCBENCH_BENCHMARK_START(benchmark_mode, ipc_type, buffersize,
+		    totalsize);
+	switch (benchmark_engine) {
+#ifdef WITH_IO_URING
+	case BENCHMARK_ENGINE_URING:
+		uring_transfer(&u, IORING_OP_WRITE_FIXED);
+		break;
+#endif
+#ifdef SPLICE_F_GIFT
+	case BENCHMARK_ENGINE_VMSPLICE:
+	case BENCHMARK_ENGINE_SPLICE:
+		vmsplice_sender(sap->sa_writefd, ring, ringsize);
+		break;
+#endif
+#ifdef SO_ZEROCOPY
+	case BENCHMARK_ENGINE_ZEROCOPY:
+		zerocopy_sender(&zp, sap->sa_writefd);
+		break;
+#endif
+
+	case BENCHMARK_ENGINE_RW:
+		if (ipc_type_datagram(ipc_type)) {
+			dgram_sender(sap->sa_writefd, dgram_buf);
+			break;
+		}
+		sendsize = duration_secs != 0 ? LONG_MAX :
+		    sap->sa_blockcount * buffersize;
+		write_sofar = 0;
+		trace_event(TRACE_BENCHMARK, TRACE_BEGIN, sendsize);
+		for (msg = 0; write_sofar < sendsize; msg++) {
+			const size_t bytes_to_write = msgsize_count != 0 ?
+			    msgsizes[msg] : min(buffersize, sendsize - write_sofar);
+			if (duration_expired && sendsize == LONG_MAX) {
+				sendsize = write_sofar + bytes_to_write;
+				__atomic_store_n(&duration_shared->ds_limit,
+				    sendsize, __ATOMIC_RELEASE);
+			}
+			if (fanin_producers)
+				fanin_tag(sap->sa_buffer, sap->sa_producer,
+				    write_sofar / buffersize);
+			if (payload_produce != PAYLOAD_NONE)
+				payload_produce_buffer(sap->sa_buffer,
+				    bytes_to_write, appbuf, msg);
+			if (Hflag)
+				chunk_stamp(sap->sa_buffer,
+				    write_sofar / buffersize);
+			if (payload_produce == PAYLOAD_CHECKSUM)
+				sap->sa_stats.ss_checksum += payload_checksum(
+				    sap->sa_buffer, bytes_to_write);
+			if (msgsize_count != 0)
+				writestart = monotonic_ns();
+			trace_event(TRACE_WRITE, TRACE_BEGIN, bytes_to_write);
+			if (lflag > 1) {
+				spin_write(sap->sa_writefd, sap->sa_buffer,
+				    bytes_to_write, &sap->sa_stats.ss_spin);
+				len = bytes_to_write;
+			} else
+				len = write(sap->sa_writefd, sap->sa_buffer,
+				    bytes_to_write);
+			trace_event(TRACE_WRITE, TRACE_END, len);
+			sap->sa_stats.ss_writes++;
+			if (IPCBENCH_WRITE_ENABLED())
+				IPCBENCH_WRITE(sap->sa_writefd, bytes_to_write,
+				    len);
+			/* SIGALRM from -T may cut a write short; finish it. */
+			while (duration_expired && len > 0 &&
+			    (size_t)len < bytes_to_write) {
+				trace_event(TRACE_WRITE, TRACE_BEGIN,
+				    bytes_to_write - len);
+				more = write(sap->sa_writefd, (char *)
+				    sap->sa_buffer + len, bytes_to_write - len);
+				trace_event(TRACE_WRITE, TRACE_END, more);
+				sap->sa_stats.ss_writes++;
+				if (more < 0)
+					err(EX_IOERR, "FAIL: write");
+				len += more;
+			}
+			/*printf("write(%d, %zd, %zd) = %zd\n", sap->sa_writefd, 0, bytes_to_write, len);*/
+			if (len != bytes_to_write) {
+				errx(EX_IOERR, "blocking write() returned early: %zd != %zd", len, bytes_to_write);
+			}
+			if (len < 0)
+				err(EX_IOERR, "FAIL: write");
+			if (msgsize_count != 0)
+				sap->sa_stats.ss_class_ns[msgsize_class(len)] +=
+				    monotonic_ns() - writestart;
+			write_sofar += len;
+		}
+		trace_event(TRACE_BENCHMARK, TRACE_END, write_sofar);
+		break;
+
+	default:
+		assert(0);
+	}
+
+	/*
+	 * Record sender-side CPU use, and release engine resources, outside
+	 * of the receiver's timed region where possible.
+	 */
+#ifdef WITH_PERF
+	if (perf_nsets != 0)
+		perf_end(&ps, &sap->sa_stats.ss_perf);
+	if (prof_event != NULL)
+		prof_end(&pr);
+#endif
+	trace_detach();
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &sap->sa_stats.ss_cputime)
+	    < 0)
+		err(EX_OSERR, "FAIL: clock_gettime");
+	timespecsub(&sap->sa_stats.ss_cputime, &cputime);
+#ifdef __linux__
+	sap->sa_stats.ss_cycles = thread_cycles_read(cyclesfd);
+	if (cyclesfd >= 0)
+		close(cyclesfd);
+#endif
+#ifdef WITH_PERF
+	if (zerocopy_compare)
+		(void)perf_cycles(&sap->sa_stats.ss_perf,
+		    &sap->sa_stats.ss_cycles);
+#endif
+	switch (benchmark_engine) {
+	case BENCHMARK_ENGINE_RW:
+		if (ipc_type_datagram(ipc_type))
+			free(dgram_buf);
+		free(appbuf);
+		if (lflag > 1)
+			spin_nonblock(sap->sa_writefd, 0);
+		break;
+
+#ifdef WITH_IO_URING
+	case BENCHMARK_ENGINE_URING:
+		uring_teardown(&u);
+		break;
+#endif
+#ifdef SPLICE_F_GIFT
+	case BENCHMARK_ENGINE_VMSPLICE:
+	case BENCHMARK_ENGINE_SPLICE:
+		munmap(ring, ringsize);
+		break;
+#endif
+#ifdef SO_ZEROCOPY
+	case BENCHMARK_ENGINE_ZEROCOPY:
+		sap->sa_stats.ss_zc_sends = zp.zp_sends;
+		sap->sa_stats.ss_zc_copied = zp.zp_copied;
+		zerocopy_teardown(&zp);
+		break;
+#endif
+	}
+}
+
+static struct timespec
+receiver(int readfd, long blockcount, void *buf)
+{
+	struct timespec cputime, finishtime;
+	uint64_t spinstart;
+	ssize_t len;
+	long read_sofar, readsize;
+#ifdef WITH_IO_URING
+	struct uring u;
+	void *uring_buf;
+#endif
+#ifdef SPLICE_F_GIFT
+	int sinkfd;
+#endif
+#ifdef WITH_PERF
+	struct perf_state ps;
+	struct prof_state pr;
+#endif
+	void *appbuf, *dgram_buf;
+
+	appbuf = NULL;
+	bzero(&receiver_stats, sizeof(receiver_stats));
+	trace_attach(0, "receiver");
+#ifdef WITH_PERF
+	if (perf_nsets != 0) {
+		perf_open(&ps);
+		perf_begin(&ps);
+	}
+	if (prof_event != NULL) {
+		prof_open(&pr);
+		prof_begin(&pr);
+	}
+#endif
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cputime) < 0)
+		err(EX_OSERR, "FAIL: clock_gettime");
+	if (IPCBENCH_BENCHMARK_START_ENABLED())
+		IPCBENCH_BENCHMARK_START(benchmark_mode, ipc_type, buffersize,
+		    totalsize);
+	if (ipc_type_datagram(ipc_type)) {
+		dgram_buf = calloc(dgram_batch, buffersize);
+		if (dgram_buf == NULL)
+			err(EX_OSERR, "FAIL: calloc");
+		dgram_receiver(readfd, dgram_buf, &receiver_stats);
+		goto done;
+	}
+
+#ifdef WITH_IO_URING
+	/*
+	 * Each operation in flight gets its own buffersize slot to read into.
+	 */
+	if (benchmark_engine == BENCHMARK_ENGINE_URING) {
+		uring_buf = mmap(NULL, uring_qdepth * buffersize,
+		    PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+		if (uring_buf == MAP_FAILED)
+			err(EX_OSERR, "FAIL: mmap");
+		uring_setup(&u, readfd, uring_buf, uring_qdepth * buffersize);
+		uring_transfer(&u, IORING_OP_READ_FIXED);
+		goto done;
+	}
+#endif
+#ifdef SPLICE_F_GIFT
+	switch (benchmark_engine) {
+	case BENCHMARK_ENGINE_VMSPLICE:
+		vmsplice_receiver(readfd, buf);
+		goto done;
+
+	case BENCHMARK_ENGINE_SPLICE:
+		sinkfd = open(splice_sink, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+		if (sinkfd < 0)
+			err(EX_CANTCREAT, "FAIL: %s", splice_sink);
+		splice_receiver(readfd, sinkfd);
+		close(sinkfd);
+		goto done;
+	}
+#endif
+
+	appbuf = payload_appbuf(payload_consume);
+	if (fanin_producers)
+		fanin_reset(blockcount);
+	if (lflag)
+		spin_nonblock(readfd, 1);
+	spinstart = 0;
+	read_sofar = 0;
+	readsize = duration_secs != 0 ? LONG_MAX : totalsize;
+	trace_event(TRACE_BENCHMARK, TRACE_BEGIN, readsize);
+	/** read() always returns as soon as there is something to read,
+	 * i.e. one pipe/socket buffer size. Make sure we use the whole buffer */
+	while (read_sofar < readsize) {
+		const size_t offset = read_sofar % buffersize;
+		const size_t bytes_to_read = min(readsize - read_sofar, buffersize - offset);
+		trace_event(TRACE_READ, TRACE_BEGIN, bytes_to_read);
+		len = read(readfd, buf + offset, bytes_to_read);
+		trace_event(TRACE_READ, TRACE_END, len);
+		receiver_stats.rs_reads++;
+		if (IPCBENCH_READ_ENABLED())
+			IPCBENCH_READ(readfd, bytes_to_read, len);
+		if (lflag && spin_account(len, &spinstart,
+		    &receiver_stats.rs_spin))
+			continue;
+		/*printf("read(%d, %zd, %zd) = %zd\n", readfd, offset, bytes_to_read, len);*/
+		/* if (len != bytes_to_read) {
+			warn("blocking read returned early: %zd != %zd", len, bytes_to_read);
+		} */
+		if (len < 0)
+			err(EX_IOERR, "FAIL: read");
+		if (len == 0)
+			errx(EX_IOERR, "FAIL: EOF after %ld of %ld bytes",
+			    read_sofar, readsize);
+		read_sofar += len;
+		if (interval_ms != 0)
+			__atomic_store_n(&benchmark_bytes, read_sofar,
+			    __ATOMIC_RELAXED);
+		if (duration_secs != 0)
+			readsize = __atomic_load_n(&duration_shared->ds_limit,
+			    __ATOMIC_ACQUIRE);
+		if (read_sofar % buffersize != 0)
+			continue;
+		if (Hflag)
+			chunk_receive(buf, read_sofar / buffersize - 1);
+		if (fanin_producers)
+			fanin_receive(buf);
+		if (payload_consume != PAYLOAD_NONE)
+			receiver_stats.rs_checksum += payload_consume_buffer(buf,
+			    buffersize, appbuf);
+	}
+	trace_event(TRACE_BENCHMARK, TRACE_END, read_sofar);
+	if (lflag)
+		spin_nonblock(readfd, 0);
+	benchmark_bytes = read_sofar;
+done:
+	trace_detach();
+
+	/*
+	 * HERE ENDS THE BENCHMARK (2-thread/2-proc).
+	 */
+	if (IPCBENCH_BENCHMARK_END_ENABLED())
+		IPCBENCH_BENCHMARK_END();
+#ifdef WITH_PMC
+	if (benchmark_pmc != BENCHMARK_PMC_NONE)
+		pmc_end();
+#endif
+#ifdef WITH_PERF
+	if (perf_nsets != 0)
+		perf_end(&ps, &receiver_stats.rs_perf);
+	if (prof_event != NULL)
+		prof_end(&pr);
+#endif
+	if (clock_gettime(CLOCK_REALTIME, &finishtime) < 0)
+		err(EX_OSERR, "FAIL: clock_gettime");
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &receiver_stats.rs_cputime)
+	    < 0)
+		err(EX_OSERR, "FAIL: clock_gettime");
+	timespecsub(&receiver_stats.rs_cputime, &cputime);
+	if (ipc_type_datagram(ipc_type)) {
+		if (receiver_stats.rs_timedout)
+			finishtime = receiver_stats.rs_lastrecv;
+		free(dgram_buf);
+	}
+#ifdef WITH_IO_URING
+	if (benchmark_engine == BENCHMARK_ENGINE_URING) {
+		uring_teardown(&u);
+		munmap(uring_buf, uring_qdepth * buffersize);
+	}
+#endif
+	free(appbuf);
+	return (finishtime);
+}
+
+static void *
+second_thread(void *arg)
+{
+	struct sender_argument *sap = arg;
+
+	if (!Bflag)
+		sleep(1);
+	sender(sap);
+
+	/*
+	 * No action needed to terminate thread other than to return.
+	 */
+	return (NULL);
+}
+
+/*
+ * Split the blocks among the senders: just the one unless fanning in (-k).
+ * Each sender needs its own buffer to tag, which separate processes get
+ * from fork() anyway.
+ */
+static unsigned int
+fanin_split(struct sender_argument *saps, int writefd, long blockcount,
+    void *writebuf, int shared)
+{
+	unsigned int i, n;
+
+	n = max(fanin_producers, 1);
+	for (i = 0; i < n; i++) {
+		saps[i].sa_writefd = writefd;
+		saps[i].sa_blockcount = blockcount / n + (i < blockcount % n);
+		saps[i].sa_producer = i;
+		saps[i].sa_buffer = writebuf;
+		if (i == 0 || !shared)
+			continue;
+		saps[i].sa_buffer = calloc(buffersize, 1);
+		if (saps[i].sa_buffer == NULL)
+			err(EX_OSERR, "FAIL: calloc");
+	}
+	return (n);
+}
+
+/*
+ * The run starts with the earliest sender; sender CPU use is summed.
+ */
+static void
+fanin_collect(struct sender_argument *saps, unsigned int n, int shared)
+{
+	unsigned int i;
+
+	sender_stats = saps[0].sa_stats;
+	benchmark_starttime = saps[0].sa_starttime;
+	for (i = 1; i < n; i++) {
+		if (saps[i].sa_starttime.tv_sec <
+		    benchmark_starttime.tv_sec ||
+		    (saps[i].sa_starttime.tv_sec ==
+		    benchmark_starttime.tv_sec &&
+		    saps[i].sa_starttime.tv_nsec <
+		    benchmark_starttime.tv_nsec))
+			benchmark_starttime = saps[i].sa_starttime;
+		timespecadd(&sender_stats.ss_cputime,
+		    &saps[i].sa_stats.ss_cputime);
+		sender_stats.ss_cycles += saps[i].sa_stats.ss_cycles;
+		sender_stats.ss_writes += saps[i].sa_stats.ss_writes;
+		sender_stats.ss_spin.sp_spins +=
+		    saps[i].sa_stats.ss_spin.sp_spins;
+		sender_stats.ss_spin.sp_spintime +=
+		    saps[i].sa_stats.ss_spin.sp_spintime;
+#ifdef WITH_PERF
+		perf_add(&sender_stats.ss_perf, &saps[i].sa_stats.ss_perf);
+#endif
+		if (shared)
+			free(saps[i].sa_buffer);
+	}
+}
+
+static struct sender_argument sa;
+
+static struct timespec
+do_2thread(int readfd, int writefd, long blockcount, void *readbuf,
+    void *writebuf)
+{
+	struct sender_argument *saps;
+	struct timespec finishtime;
+	pthread_t *threads;
+	unsigned int i, n;
+
+	/*
+	 * We can just use ordinary shared memory between the two threads --
+	 * no need to do anything special.
+	 */
+	saps = &sa;
+	if (fanin_producers > 1) {
+		saps = calloc(fanin_producers, sizeof(*saps));
+		if (saps == NULL)
+			err(EX_OSERR, "FAIL: calloc");
+	}
+	n = fanin_split(saps, writefd, blockcount, writebuf, 1);
+	threads = calloc(n, sizeof(*threads));
+	if (threads == NULL)
+		err(EX_OSERR, "FAIL: calloc");
+	for (i = 0; i < n; i++)
+		if (pthread_create(&threads[i], NULL, second_thread, &saps[i])
+		    < 0)
+			err(EX_OSERR, "FAIL: pthread_create");
+	finishtime = receiver(readfd, blockcount, readbuf);
+	for (i = 0; i < n; i++)
+		if (pthread_join(threads[i], NULL) < 0)
+			err(EX_OSERR, "FAIL: pthread_join");
+	fanin_collect(saps, n, 1);
+	timespecsub(&finishtime, &benchmark_starttime);
+	free(threads);
+	if (saps != &sa)
+		free(saps);
+	return (finishtime);
+}
+
+static struct timespec
+do_2proc(int readfd, int writefd, long blockcount, void *readbuf,
+    void *writebuf)
+{
+	struct sender_argument *sap;
+	struct timespec finishtime;
+	pid_t *pids;
+	size_t len;
+	unsigned int i, n;
+
+	/*
+	 * Set up shared pages across fork() that will allow not just
+	 * passing arguments, but also getting back the starting timestamp
+ 	 * that may be somewhat after the time of fork() in this process.
+	 */
+	len = max(fanin_producers, 1) * sizeof(*sap) + getpagesize() - 1;
+	len -= len % getpagesize();
+#ifdef __linux__
+	if ((sap = mmap(NULL, len, PROT_READ | PROT_WRITE,
+	    MAP_ANON | MAP_SHARED, -1, 0)) == MAP_FAILED)
+		err(EX_OSERR, "mmap");
+#else
+	if ((sap = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_ANON,
+	    -1, 0)) == MAP_FAILED)
+		err(EX_OSERR, "mmap");
+	if (minherit(sap, len, INHERIT_SHARE) < 0)
+		err(EX_OSERR, "minherit");
+#endif
+	n = fanin_split(sap, writefd, blockcount, writebuf, 0);
+	pids = calloc(n, sizeof(*pids));
+	if (pids == NULL)
+		err(EX_OSERR, "FAIL: calloc");
+	for (i = 0; i < n; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0)
+			err(EX_OSERR, "FAIL: fork");
+		if (pids[i] == 0) {
+			if (!Bflag)
+				sleep(1);
+			sender(&sap[i]);
+			if (!Bflag)
+				sleep(1);
+			_exit(0);
+		}
+	}
+	finishtime = receiver(readfd, blockcount, readbuf);
+	for (i = 0; i < n; i++)
+		if (waitpid(pids[i], NULL, 0) != pids[i])
+			err(EX_OSERR, "FAIL: waitpid");
+	fanin_collect(sap, n, 0);
+	timespecsub(&finishtime, &benchmark_starttime);
+	free(pids);
+	munmap(sap, len);
+	return (finishtime);
+}
+
+/*
+ * The single threading case is quite different from the two-thread/process
+ * case, as we need to manually interleave the sender and recipient.  Note the
+ * opportunity for deadlock if the buffer size is greater than what the IPC
+ * primitive provides.
+ *
+ * The buffer pointer must point at a buffer of size 'buffersize' here.
+ *
+ * Socket-buffer sizes can be set with -s or -O.  Pipes on FreeBSD size
+ * themselves, but on Linux their capacity can be set with F_SETPIPE_SZ (-z).
+ */
+static struct timespec
+do_1thread(int readfd, int writefd, long blockcount, void *readbuf,
+    void *writebuf)
+{
+	struct timespec starttime, finishtime;
+	fd_set fdset_read, fdset_write;
+	long read_sofar, runsize, write_sofar;
+	ssize_t len_read, len_write;
+	int flags, nready;
+#ifdef WITH_PERF
+	struct perf_state ps;
+	struct prof_state pr;
+
+	if (perf_nsets != 0)
+		perf_open(&ps);
+	if (prof_event != NULL)
+		prof_open(&pr);
+#endif
+
+	flags = fcntl(readfd, F_GETFL, 0);
+	if (flags < 0)
+		err(EX_OSERR, "FAIL: fcntl(readfd, F_GETFL, 0)");
+	if (fcntl(readfd, F_SETFL, flags | O_NONBLOCK) < 0)
+		err(EX_OSERR, "FAIL: fcntl(readfd, F_SETFL, "
+		    "flags | O_NONBLOCK)");
+	flags = fcntl(writefd, F_GETFL, 0);
+	if (flags < 0)
+		err(EX_OSERR, "FAIL: fcntl(writefd, F_GETFL, 0)");
+	if (fcntl(writefd, F_SETFL, flags | O_NONBLOCK) < 0)
+		err(EX_OSERR, "FAIL: fcntl(writefd, F_SETFL, "
+		    "flags | O_NONBLOCK)");
+
+	FD_ZERO(&fdset_read);
+	FD_SET(readfd, &fdset_read);
+	FD_ZERO(&fdset_write);
+	FD_SET(writefd, &fdset_write);
+	trace_attach(0, "1thread");
+
+	if (clock_gettime(CLOCK_REALTIME, &starttime) < 0)
+		err(EX_OSERR, "FAIL: clock_gettime");
+	if (duration_secs != 0)
+		duration_arm();
+#ifdef WITH_PMC
+	if (benchmark_pmc != BENCHMARK_PMC_NONE)
+		pmc_begin();
+#endif
+#ifdef WITH_PERF
+	if (perf_nsets != 0)
+		perf_begin(&ps);
+	if (prof_event != NULL)
+		prof_begin(&pr);
+#endif
+
+	/*
+	 * HERE BEGINS THE BENCHMARK (1-thread).
+	 */
+	if (IPCBENCH_BENCHMARK_START_ENABLED())
+		IPCBENCH_BENCHMARK_START(benchmark_mode, ipc_type, buffersize,
+		    totalsize);
+	read_sofar = write_sofar = 0;
+	receiver_stats.rs_reads = receiver_stats.rs_writes = 0;
+	runsize = duration_secs != 0 ? LONG_MAX : totalsize;
+	trace_event(TRACE_BENCHMARK, TRACE_BEGIN, runsize);
+	/** As the I/O is nonblocking write()/read() will return after only
+	 * reading part of the buffer. For this benchmark we ensure that
+	 * the whole buffer is used instead of always using offset 0 to
+	 * have the same behaviour as the 2thread/2proc version */
+	while (read_sofar < runsize) {
+		const size_t remaining_write = runsize - write_sofar;
+		if (remaining_write > 0) {
+			const size_t offset = write_sofar % buffersize;
+			const size_t bytes_to_write = min(remaining_write, buffersize - offset);
+			trace_event(TRACE_WRITE, TRACE_BEGIN, bytes_to_write);
+			len_write = write(writefd, writebuf + offset, bytes_to_write);
+			trace_event(TRACE_WRITE, TRACE_END, len_write);
+			receiver_stats.rs_writes++;
+			if (IPCBENCH_WRITE_ENABLED())
+				IPCBENCH_WRITE(writefd, bytes_to_write,
+				    len_write);
+			/*printf("write(%d, %zd, %zd) = %zd\n", writefd, offset, bytes_to_write, len_write);*/
+			if (len_write < 0 && errno != EAGAIN)
+				err(EX_IOERR, "FAIL: write");
+			if (len_write > 0)
+				write_sofar += len_write;
+		}
+		if (write_sofar != 0) {
+			const size_t offset = read_sofar % buffersize;
+			const size_t bytes_to_read = min(runsize - read_sofar, buffersize - offset);
+			trace_event(TRACE_READ, TRACE_BEGIN, bytes_to_read);
+			len_read = read(readfd, readbuf + offset, bytes_to_read);
+			trace_event(TRACE_READ, TRACE_END, len_read);
+			receiver_stats.rs_reads++;
+			if (IPCBENCH_READ_ENABLED())
+				IPCBENCH_READ(readfd, bytes_to_read, len_read);
+			/*printf("read(%d, %zd, %zd) = %zd\n", readfd, offset, bytes_to_read, len_read);*/
+			if (len_read < 0 && errno != EAGAIN)
+				err(EX_IOERR, "FAIL: read");
+			if (len_read > 0)
+				read_sofar += len_read;
+			if (interval_ms != 0)
+				__atomic_store_n(&benchmark_bytes, read_sofar,
+				    __ATOMIC_RELAXED);
+		}
+
+		/* On expiry of -T, stop writing, and drain what is queued. */
+		if (duration_expired && runsize == LONG_MAX)
+			runsize = write_sofar;
+
+		/*
+		 * If we've had neither read nor write progress in this
+		 * iteration, block until one of reading or writing is
+		 * possible.
+		 */
+		if (read_sofar < runsize &&
+		    (len_read == 0 && len_write == 0)) {
+			trace_event(TRACE_SELECT, TRACE_BEGIN, 0);
+			nready = select(max(readfd, writefd), &fdset_read,
+			    &fdset_write, NULL, NULL);
+			trace_event(TRACE_SELECT, TRACE_END, nready);
+			if (nready < 0 && errno != EINTR)
+				err(EX_IOERR, "FAIL: select");
+			if (IPCBENCH_SELECT_WAKEUP_ENABLED())
+				IPCBENCH_SELECT_WAKEUP(nready);
+		}
+	}
+
+	trace_event(TRACE_BENCHMARK, TRACE_END, read_sofar);
+	trace_detach();
+
+	/*
+	 * HERE ENDS THE BENCHMARK (1-thread).
+	 */
+	if (IPCBENCH_BENCHMARK_END_ENABLED())
+		IPCBENCH_BENCHMARK_END();
+#ifdef WITH_PMC
+	if (benchmark_pmc != BENCHMARK_PMC_NONE)
+		pmc_end();
+#endif
+#ifdef WITH_PERF
+	if (perf_nsets != 0)
+		perf_end(&ps, &receiver_stats.rs_perf);
+	if (prof_event != NULL)
+		prof_end(&pr);
+#endif
+	if (clock_gettime(CLOCK_REALTIME, &finishtime) < 0)
+		err(EX_OSERR, "FAIL: clock_gettime");
+	benchmark_bytes = read_sofar;
+	benchmark_starttime = starttime;
+	timespecsub(&finishtime, &starttime);
+	return (finishtime);
+}
+
+/*
+ * TCP socket options (-O), given as a comma-separated list of name=value
+ * pairs.  Each value may be a colon-separated list: with -W, the benchmark
+ * sweeps the cross product of all listed values, and otherwise only one
+ * value may be given.  Options are applied to the sending endpoint, the
+ * receiving endpoint, or both, as appropriate; receive-side options are set
+ * before connecting so that the window scale reflects the buffer size.
+ */
+#define	SOCKOPT_SNDBUF		0	/* SO_SNDBUF on sender */
+#define	SOCKOPT_RCVBUF		1	/* SO_RCVBUF on receiver */
+#define	SOCKOPT_NODELAY		2	/* TCP_NODELAY on sender */
+#define	SOCKOPT_CORK		3	/* TCP_CORK/TCP_NOPUSH on sender */
+#define	SOCKOPT_RCVLOWAT	4	/* SO_RCVLOWAT on receiver */
+#define	SOCKOPT_NOTSENT_LOWAT	5	/* TCP_NOTSENT_LOWAT on sender */
+#define	SOCKOPT_CC		6	/* TCP_CONGESTION on both */
+#define	SOCKOPT_BUSY_POLL	7	/* SO_BUSY_POLL on receiver */
+#define	SOCKOPT_MAX		8
+
+static char *sockopt_names[SOCKOPT_MAX + 1] = {
+	"sndbuf",
+	"rcvbuf",
+	"nodelay",
+	"cork",
+	"rcvlowat",
+	"notsent_lowat",
+	"cc",
+	"busy_poll",
+	NULL
+};
+
+#define	SOCKOPT_VALUES_MAX	16
+
+struct sockopt_values {
+	int		 sv_count;	/* Number of values; 0 if unset. */
+	const char	*sv_values[SOCKOPT_VALUES_MAX];
+};
+static struct sockopt_values sockopt_values[SOCKOPT_MAX];
+
+/*
+ * Value of each option for the current run, or NULL if unset.
+ */
+static const char *sockopt_current[SOCKOPT_MAX];
+
+static void
+sockopt_parse(char *options)
+{
+	struct sockopt_values *svp;
+	char *endp, *value, *v;
+	int opt;
+
+	while (*options != '\0') {
+		opt = getsubopt(&options, sockopt_names, &value);
+		if (opt < 0)
+			usage();
+		switch (opt) {
+#ifndef TCP_NOTSENT_LOWAT
+		case SOCKOPT_NOTSENT_LOWAT:
+			errx(EX_USAGE, "FAIL: notsent_lowat not supported");
+#endif
+#ifndef TCP_CONGESTION
+		case SOCKOPT_CC:
+			errx(EX_USAGE, "FAIL: cc not supported");
+#endif
+#ifndef SO_BUSY_POLL
+		case SOCKOPT_BUSY_POLL:
+			errx(EX_USAGE, "FAIL: busy_poll not supported");
+#endif
+		}
+		svp = &sockopt_values[opt];
+		svp->sv_count = 0;
+		if (value == NULL) {
+			/* Boolean options may be given without a value. */
+			if (opt != SOCKOPT_NODELAY && opt != SOCKOPT_CORK)
+				usage();
+			svp->sv_values[svp->sv_count++] = "1";
+			continue;
+		}
+		while ((v = strsep(&value, ":")) != NULL) {
+			if (*v == '\0' || svp->sv_count == SOCKOPT_VALUES_MAX)
+				usage();
+			if (opt != SOCKOPT_CC && (strtol(v, &endp, 10) < 0 ||
+			    *endp != '\0'))
+				usage();
+			svp->sv_values[svp->sv_count++] = v;
+		}
+	}
+}
+
+static void
+sockopt_set(int fd, int level, int name, int opt)
+{
+	const char *value;
+	int i;
+
+	value = sockopt_current[opt];
+	if (value == NULL)
+		return;
+	i = strtol(value, NULL, 10);
+	if (setsockopt(fd, level, name, &i, sizeof(i)) < 0)
+		err(EX_OSERR, "FAIL: setsockopt %s=%s", sockopt_names[opt],
+		    value);
+}
+
+/*
+ * Apply current options to the sending or receiving TCP endpoint.
+ */
+static void
+sockopt_apply(int fd, int sending)
+{
+
+	if (sending) {
+		sockopt_set(fd, SOL_SOCKET, SO_SNDBUF, SOCKOPT_SNDBUF);
+		sockopt_set(fd, IPPROTO_TCP, TCP_NODELAY, SOCKOPT_NODELAY);
+#ifdef TCP_CORK
+		sockopt_set(fd, IPPROTO_TCP, TCP_CORK, SOCKOPT_CORK);
+#else
+		sockopt_set(fd, IPPROTO_TCP, TCP_NOPUSH, SOCKOPT_CORK);
+#endif
+#ifdef TCP_NOTSENT_LOWAT
+		sockopt_set(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+		    SOCKOPT_NOTSENT_LOWAT);
+#endif
+	} else {
+		sockopt_set(fd, SOL_SOCKET, SO_RCVBUF, SOCKOPT_RCVBUF);
+		sockopt_set(fd, SOL_SOCKET, SO_RCVLOWAT, SOCKOPT_RCVLOWAT);
+#ifdef SO_BUSY_POLL
+		sockopt_set(fd, SOL_SOCKET, SO_BUSY_POLL, SOCKOPT_BUSY_POLL);
+#endif
+	}
+#ifdef TCP_CONGESTION
+	if (sockopt_current[SOCKOPT_CC] != NULL &&
+	    setsockopt(fd, IPPROTO_TCP, TCP_CONGESTION,
+	    sockopt_current[SOCKOPT_CC],
+	    strlen(sockopt_current[SOCKOPT_CC])) < 0)
+		err(EX_OSERR, "FAIL: setsockopt cc=%s",
+		    sockopt_current[SOCKOPT_CC]);
+#endif
+}
+
+/*
+ * Print the current option settings as name=value pairs.
+ */
+static void
+sockopt_print(void)
+{
+	const char *sep;
+	int opt;
+
+	sep = "";
+	for (opt = 0; opt < SOCKOPT_MAX; opt++) {
+		if (sockopt_current[opt] == NULL)
+			continue;
+		printf("%s%s=%s", sep, sockopt_names[opt],
+		    sockopt_current[opt]);
+		sep = " ";
+	}
+	if (*sep == '\0')
+		printf("defaults");
+}
+
+/*
+ * Mean round-trip time, in microseconds, of a small message ping-ponged
+ * across the connection.  The message is SO_RCVLOWAT bytes if that is set,
+ * so as not to block forever on the low-water mark.  Options such as
+ * TCP_CORK can delay each round trip by hundreds of milliseconds, so give up
+ * after LATENCY_MAXTIME even if not all rounds are done.
+ */
+#define	LATENCY_ROUNDS		100
+#define	LATENCY_MAXTIME		1	/* Seconds */
+
+static void
+xfer_all(int fd, char *buf, size_t len, int writing)
+{
+	ssize_t done;
+	size_t off;
+
+	for (off = 0; off < len; off += done) {
+		done = writing ? write(fd, buf + off, len - off) :
+		    read(fd, buf + off, len - off);
+		if (done < 0)
+			err(EX_IOERR, "FAIL: %s", writing ? "write" : "read");
+		if (done == 0)
+			errx(EX_IOERR, "FAIL: unexpected EOF");
+	}
+}
+
+static double
+tcp_latency(int readfd, int writefd)
+{
+	struct timespec ts_start, ts_now;
+	size_t len;
+	char *buf;
+	int rounds;
+
+	len = 1;
+	if (sockopt_current[SOCKOPT_RCVLOWAT] != NULL)
+		len = max(len, strtoul(sockopt_current[SOCKOPT_RCVLOWAT],
+		    NULL, 10));
+	buf = calloc(len, 1);
+	if (buf == NULL)
+		err(EX_OSERR, "FAIL: calloc");
+	if (clock_gettime(CLOCK_MONOTONIC, &ts_start) < 0)
+		err(EX_OSERR, "FAIL: clock_gettime");
+	ts_now = ts_start;
+	for (rounds = 0; rounds < LATENCY_ROUNDS; rounds++) {
+		xfer_all(writefd, buf, len, 1);
+		xfer_all(readfd, buf, len, 0);
+		xfer_all(readfd, buf, len, 1);
+		xfer_all(writefd, buf, len, 0);
+		if (clock_gettime(CLOCK_MONOTONIC, &ts_now) < 0)
+			err(EX_OSERR, "FAIL: clock_gettime");
+		if (ts_now.tv_sec - ts_start.tv_sec >= LATENCY_MAXTIME) {
+			rounds++;
+			break;
+		}
+	}
+	free(buf);
+	timespecsub(&ts_now, &ts_start);
+	return (timespec_ns(ts_now) / 1000 / rounds);
+}
+
+/*
+ * TCP_INFO sampler (-y).  A periodic sampler polls getsockopt(TCP_INFO) on
+ * both endpoints at a fixed interval, so that the sender and receiver loops
+ * are untouched; the samples falling within the
+ * timed region are printed after the run.  On Linux, cwnd and ssthresh are
+ * in segments; on FreeBSD, in bytes, and there is no delivery rate.
+ */
+#define	TCPINFO_RING		65536	/* Samples per endpoint */
+
+#define	TCPINFO_SENDER		0
+#define	TCPINFO_RECEIVER	1
+#define	TCPINFO_ENDPOINTS	2
+
+static const char *tcpinfo_endpoints[TCPINFO_ENDPOINTS] = {
+	"snd",
+	"rcv"
+};
+
+struct tcpinfo_sample {
+	struct timespec	 ts_time;
+	uint32_t	 ts_cwnd;
+	uint32_t	 ts_ssthresh;
+	uint32_t	 ts_rtt;	/* Smoothed RTT (us) */
+	uint32_t	 ts_rttvar;	/* RTT variance (us) */
+	uint32_t	 ts_snd_wnd;	/* Peer's advertised window */
+	uint32_t	 ts_retrans;	/* Total retransmissions */
+	uint64_t	 ts_delivery_rate;	/* Bytes/sec */
+};
+
+static long tcpinfo_interval;		/* Microseconds; 0 if disabled */
+
+static int tcpinfo_fds[TCPINFO_ENDPOINTS];
+static struct sampler tcpinfo_sampler;
+
+static void
+tcpinfo_sample(int fd, struct tcpinfo_sample *tsp)
+{
+	struct tcp_info ti;
+	socklen_t len;
+
+	len = sizeof(ti);
+	if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &ti, &len) < 0)
+		err(EX_OSERR, "FAIL: getsockopt TCP_INFO");
+	tsp->ts_cwnd = ti.tcpi_snd_cwnd;
+	tsp->ts_ssthresh = ti.tcpi_snd_ssthresh;
+	tsp->ts_rtt = ti.tcpi_rtt;
+	tsp->ts_rttvar = ti.tcpi_rttvar;
+	tsp->ts_snd_wnd = ti.tcpi_snd_wnd;
+#ifdef __linux__
+	tsp->ts_retrans = ti.tcpi_total_retrans;
+	tsp->ts_delivery_rate = ti.tcpi_delivery_rate;
+#else
+	tsp->ts_retrans = ti.tcpi_snd_rexmitpack;
+	tsp->ts_delivery_rate = 0;
+#endif
+}
+
+/*
+ * Sample both endpoints into 'slot', TCPINFO_ENDPOINTS samples.
+ */
+static void
+tcpinfo_endpoints_sample(void *slot, struct timespec now, void *arg)
+{
+	struct tcpinfo_sample *tsp = slot;
+	int i;
+
+	(void)arg;
+	for (i = 0; i < TCPINFO_ENDPOINTS; i++) {
+		tsp[i].ts_time = now;
+		tcpinfo_sample(tcpinfo_fds[i], &tsp[i]);
+	}
+}
+
+static void
+tcpinfo_start(int readfd, int writefd)
+{
+
+	tcpinfo_fds[TCPINFO_SENDER] = writefd;
+	tcpinfo_fds[TCPINFO_RECEIVER] = readfd;
+	sampler_start(&tcpinfo_sampler, tcpinfo_interval * 1000,
+	    TCPINFO_ENDPOINTS * sizeof(struct tcpinfo_sample), TCPINFO_RING,
+	    tcpinfo_endpoints_sample, NULL);
+}
+
+static void
+tcpinfo_finish(void)
+{
+
+	sampler_stop(&tcpinfo_sampler);
+}
+
+/*
+ * Print the samples taken between 'starttime' and 'starttime' + 'duration',
+ * with times relative to the start.
+ */
+static void
+tcpinfo_print(struct timespec starttime, struct timespec duration)
+{
+	struct sampler *sp = &tcpinfo_sampler;
+	struct tcpinfo_sample *tsp;
+	struct timespec t;
+	long first, n, printed;
+	int i;
+
+	first = max(0, sp->sp_count - TCPINFO_RING);
+	printf("tcp_info: interval %ld us, %ld samples, %ld overwritten\n",
+	    tcpinfo_interval, sp->sp_count, first);
+	printf("%12s %3s %8s %10s %8s %8s %10s %7s %14s\n", "time_us", "end",
+	    "cwnd", "ssthresh", "rtt_us", "rttvar", "snd_wnd", "retrans",
+	    "delivery_Bps");
+	printed = 0;
+	for (n = first; n < sp->sp_count; n++) {
+		tsp = sampler_slot(sp, n);
+		t = tsp->ts_time;
+		timespecsub(&t, &starttime);
+		if (t.tv_sec < 0 || timespec_ns(t) > timespec_ns(duration))
+			continue;
+		for (i = 0; i < TCPINFO_ENDPOINTS; i++)
+			printf("%12.0F %3s %8u %10u %8u %8u %10u %7u %14ju\n",
+			    timespec_ns(t) / 1000, tcpinfo_endpoints[i],
+			    tsp[i].ts_cwnd, tsp[i].ts_ssthresh, tsp[i].ts_rtt,
+			    tsp[i].ts_rttvar, tsp[i].ts_snd_wnd,
+			    tsp[i].ts_retrans,
+			    (uintmax_t)tsp[i].ts_delivery_rate);
+		printed++;
+	}
+	if (printed == 0)
+		printf("tcp_info: no samples within the timed region\n");
+}
+
+/*
+ * Scenario mode runs the TCP benchmark between two network namespaces
+ * joined by a veth pair, under each of a table of tc netem profiles.  The
+ * namespaces are switched only while creating sockets: the listen (and so
+ * the sending) socket lives in the server namespace, and the receiving
+ * socket in the client namespace, so that the ordinary 2thread benchmark
+ * carries data across the veth pair.  Linux only, and must run as root.
+ */
+#define	SCENARIO_NS_SERVER	"ipc-scenario-s"
+#define	SCENARIO_NS_CLIENT	"ipc-scenario-c"
+#define	SCENARIO_IF_SERVER	"veth-ipcs0"
+#define	SCENARIO_IF_CLIENT	"veth-ipcs1"
+#define	SCENARIO_ADDR_SERVER	"10.41.1.1"
+#define	SCENARIO_ADDR_CLIENT	"10.41.1.2"
+
+#define	SCENARIO_HOST		0
+#define	SCENARIO_SERVER		1
+#define	SCENARIO_CLIENT		2
+#define	SCENARIO_MAX		3
+
+static int scenario_nsfd[SCENARIO_MAX] = { -1, -1, -1 };
+
+/*
+ * Switch the calling thread into a namespace; a no-op outside scenario mode.
+ */
+static void
+scenario_enter(int ns)
+{
+
+	if (benchmark_mode != BENCHMARK_MODE_SCENARIO)
+		return;
+#ifdef __linux__
+	if (setns(scenario_nsfd[ns], CLONE_NEWNET) < 0)
+		err(EX_OSERR, "FAIL: setns");
+#endif
+}
+
+/*
+ * Server and client modes split the TCP benchmark across two processes --
+ * potentially in different network namespaces, joined by a veth pair (see
+ * netns.sh), so that data crosses a real device path rather than loopback.
+ * The client connects to the server and sends totalsize bytes; the server
+ * receives them and replies with a single acknowledgement byte.  Both ends
+ * must be given the same buffer and total sizes.  The server measures from
+ * accept() to the last byte received; the client from its first write() to
+ * receipt of the acknowledgement.
+ */
+static int
+remote_listen(void)
+{
+	struct sockaddr_in sin;
+	int i, listenfd;
+
+	listenfd = socket(PF_INET, SOCK_STREAM, 0);
+	if (listenfd < 0)
+		err(EX_OSERR, "FAIL: socket (listen)");
+	i = 1;
+	if (setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &i, sizeof(i)) < 0)
+		err(EX_OSERR, "FAIL: setsockopt SO_REUSEADDR");
+
+	/* Receive-side options are inherited by the accepted socket. */
+	sockopt_apply(listenfd, 0);
+	bzero(&sin, sizeof(sin));
+#ifndef __linux__
+	sin.sin_len = sizeof(sin);
+#endif
+	sin.sin_family = AF_INET;
+	sin.sin_addr = tcp_addr;
+	sin.sin_port = htons(tcp_port);
+	if (bind(listenfd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+		err(EX_OSERR, "FAIL: bind %s:%u", tcp_addr_string, tcp_port);
+	if (listen(listenfd, -1) < 0)
+		err(EX_OSERR, "FAIL: listen");
+	return (listenfd);
+}
+
+static int
+remote_socket(void)
+{
+	int writefd;
+
+	writefd = socket(PF_INET, SOCK_STREAM, 0);
+	if (writefd < 0)
+		err(EX_OSERR, "FAIL: socket (write)");
+	sockopt_apply(writefd, 1);
+	return (writefd);
+}
+
+/*
+ * Neither end connects until the benchmark proper, so that neither waits on
+ * the other settling.  'readfd' is the listen socket on entry; the accepted
+ * connection replaces it, so that the caller closes the connection as with
+ * other IPC types.
+ */
+static struct timespec
+do_server(int readfd, long blockcount, void *readbuf)
+{
+	struct timespec starttime, finishtime;
+	char ack;
+	int fd;
+
+	fd = accept(readfd, NULL, NULL);
+	if (fd < 0)
+		err(EX_OSERR, "FAIL: accept");
+	if (dup2(fd, readfd) < 0)
+		err(EX_OSERR, "FAIL: dup2");
+	close(fd);
+	if (clock_gettime(CLOCK_REALTIME, &starttime) < 0)
+		err(EX_OSERR, "FAIL: clock_gettime");
+#ifdef WITH_PMC
+	if (benchmark_pmc != BENCHMARK_PMC_NONE)
+		pmc_begin();
+#endif
+	finishtime = receiver(readfd, blockcount, readbuf);
+	ack = 0;
+	if (write(readfd, &ack, sizeof(ack)) != sizeof(ack))
+		err(EX_IOERR, "FAIL: write (acknowledgement)");
+	timespecsub(&finishtime, &starttime);
+	return (finishtime);
+}
+
+static struct timespec
+do_client(int writefd, long blockcount, void *writebuf)
+{
+	struct sockaddr_in sin;
+	struct timespec finishtime;
+	ssize_t len;
+	char ack;
+
+	bzero(&sin, sizeof(sin));
+#ifndef __linux__
+	sin.sin_len = sizeof(sin);
+#endif
+	sin.sin_family = AF_INET;
+	sin.sin_addr = tcp_addr;
+	sin.sin_port = htons(tcp_port);
+	if (connect(writefd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+		err(EX_OSERR, "FAIL: connect %s:%u", tcp_addr_string, tcp_port);
+	sa.sa_writefd = writefd;
+	sa.sa_blockcount = blockcount;
+	sa.sa_buffer = writebuf;
+	sender(&sa);
+	len = read(writefd, &ack, sizeof(ack));
+	if (len < 0)
+		err(EX_IOERR, "FAIL: read (acknowledgement)");
+	if (len == 0)
+		errx(EX_IOERR, "FAIL: server closed without acknowledgement");
+	if (IPCBENCH_BENCHMARK_END_ENABLED())
+		IPCBENCH_BENCHMARK_END();
+#ifdef WITH_PMC
+	if (benchmark_pmc != BENCHMARK_PMC_NONE)
+		pmc_end();
+#endif
+	if (clock_gettime(CLOCK_REALTIME, &finishtime) < 0)
+		err(EX_OSERR, "FAIL: clock_gettime");
+	sender_stats = sa.sa_stats;
+	benchmark_starttime = sa.sa_starttime;
+	timespecsub(&finishtime, &sa.sa_starttime);
+	return (finishtime);
+}
+
+/*
+ * Allocate a suitable IPC object, returning its read and write endpoints.
+ */
+static void
+ipc_objects(int *readfdp, int *writefdp)
+{
+	struct sockaddr_in sin;
+	int error, fd[2], flags, i, listenfd, readfd, writefd, sockoptval;
+
+	/*
+	 * In the server and client modes, only one endpoint is local.
+	 */
+	switch (benchmark_mode) {
+	case BENCHMARK_MODE_SERVER:
+		*readfdp = remote_listen();
+		*writefdp = -1;
+		return;
+
+	case BENCHMARK_MODE_CLIENT:
+		*readfdp = -1;
+		*writefdp = remote_socket();
+		return;
+	}
+
+	switch (ipc_type) {
+	case BENCHMARK_IPC_PIPE:
+		if (pipe(fd) < 0)
+			err(EX_OSERR, "FAIL: pipe");
+
+		/*
+		 * On FreeBSD, it doesn't matter which end of the pipe we use,
+		 * but on other operating systems, it is sometimes the case
+		 * that the first file descriptor must be used for reading,
+		 * and the second for writing.
+		 */
+		readfd = fd[0];
+		writefd = fd[1];
+#ifdef F_SETPIPE_SZ
+		if (pipe_capacity != 0 &&
+		    fcntl(writefd, F_SETPIPE_SZ, pipe_capacity) < 0)
+			err(EX_OSERR, "FAIL: fcntl(writefd, F_SETPIPE_SZ, %ld)",
+			    pipe_capacity);
+#endif
+		break;
+
+	case BENCHMARK_IPC_LOCAL_SOCKET:
+		if (socketpair(PF_LOCAL, SOCK_STREAM, 0, fd) < 0)
+			err(EX_OSERR, "FAIL: socketpair");
+
+		/*
+		 * With socket pairs, it makes no difference which one we use
+		 * for reading or writing.
+		 */
+		readfd = fd[0];
+		writefd = fd[1];
+		break;
+
+	case BENCHMARK_IPC_LOCAL_DGRAM:
+	case BENCHMARK_IPC_LOCAL_SEQPACKET:
+		if (socketpair(PF_LOCAL, ipc_type == BENCHMARK_IPC_LOCAL_DGRAM ?
+		    SOCK_DGRAM : SOCK_SEQPACKET, 0, fd) < 0)
+			err(EX_OSERR, "FAIL: socketpair");
+		readfd = fd[0];
+		writefd = fd[1];
+		break;
+
+	case BENCHMARK_IPC_UDP_SOCKET:
+		/*
+		 * Bind the 'read' endpoint, and connect the 'write' endpoint
+		 * to it so that plain send() can be used.
+		 */
+		readfd = socket(PF_INET, SOCK_DGRAM, 0);
+		if (readfd < 0)
+			err(EX_OSERR, "FAIL: socket (read)");
+		bzero(&sin, sizeof(sin));
+#ifndef __linux__
+		sin.sin_len = sizeof(sin);
+#endif
+		sin.sin_family = AF_INET;
+		sin.sin_addr = tcp_addr;
+		sin.sin_port = htons(tcp_port);
+		if (bind(readfd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+			err(EX_OSERR, "FAIL: bind");
+		writefd = socket(PF_INET, SOCK_DGRAM, 0);
+		if (writefd < 0)
+			err(EX_OSERR, "FAIL: socket (write)");
+		if (connect(writefd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+			err(EX_OSERR, "FAIL: connect");
+		break;
+
+	case BENCHMARK_IPC_TCP_SOCKET:
+		scenario_enter(SCENARIO_SERVER);
+		listenfd = socket(PF_INET, SOCK_STREAM, 0);
+		if (listenfd < 0)
+			err(EX_OSERR, "FAIL: socket (listen)");
+
+		/*
+		 * Socket address used for both binding and connecting.
+		 */
+		i = 1;
+		if (setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &i,
+		    sizeof(i)) < 0)
+			err(EX_OSERR, "FAIL: setsockopt SO_REUSEADDR");
+		bzero(&sin, sizeof(sin));
+#ifndef __linux__
+		sin.sin_len = sizeof(sin);
+#endif
+		sin.sin_family = AF_INET;
+		sin.sin_addr = tcp_addr;
+		sin.sin_port = htons(tcp_port);
+		if (bind(listenfd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+			err(EX_OSERR, "FAIL: bind");
+		if (listen(listenfd, -1) < 0)
+			err(EX_OSERR, "FAIL: listen");
+
+		/*
+		 * Create the 'read' endpoint and connect it to the listen
+		 * socket in a non-blocking manner (as we need to accept()
+		 * it before the connection can complete, and don't want to
+		 * deadlock).
+		 *
+		 * Note that it *does* matter which we use for reading vs.
+		 * writing -- we intentionally wait until the full three-way
+		 * handshake is done before transmitting data, and only the
+		 * accepted socket has this property (i.e., waiting for the
+		 * ACK in the SYN-SYN/ACK-ACK exchange).
+		 */
+		scenario_enter(SCENARIO_CLIENT);
+		readfd = socket(PF_INET, SOCK_STREAM, 0);
+		if (readfd < 0)
+			err(EX_OSERR, "FAIL: socket (read)");
+		scenario_enter(SCENARIO_HOST);
+		sockopt_apply(readfd, 0);
+		flags = fcntl(readfd, F_GETFL, 0);
+		if (flags < 0)
+			err(EX_OSERR, "FAIL: fcntl(readfd, F_GETFL, 0)");
+		if (fcntl(readfd, F_SETFL, flags | O_NONBLOCK) < 0)
+			err(EX_OSERR, "FAIL: fcntl(readfd, F_SETFL, "
+			    "flags | O_NONBLOCK)");
+		error = connect(readfd, (struct sockaddr *)&sin,
+		    sizeof(sin));
+		if (error < 0 && errno != EINPROGRESS)
+			err(EX_OSERR, "FAIL: connect");
+
+		/*
+		 * On the listen socket, now accept the 'write' endpoint --
+		 * which should block until the full three-way handshake is
+		 * complete.
+		 */
+		writefd = accept(listenfd, NULL, NULL);
+		if (writefd < 0)
+			err(EX_OSERR, "accept");
+		sockopt_apply(writefd, 1);
+
+		/*
+		 * Restore blocking status to the 'read' endpoint, and close
+		 * the now-unnecessary listen socket.  Any further use of
+		 * the 'read' endpoint will block until the socket is ready,
+		 * although in practice that is unlikely.
+		 */
+		if (fcntl(readfd, F_SETFL, flags) < 0)
+			err(EX_OSERR, "FAIL: fcntl(readfd, F_SETFL, flags");
+		close(listenfd);
+		break;
+
+	default:
+		assert(0);
+	}
+
+	if (ipc_type == BENCHMARK_IPC_LOCAL_SOCKET ||
+	    ipc_type == BENCHMARK_IPC_TCP_SOCKET ||
+	    ipc_type_datagram(ipc_type)) {
+		if (sflag) {
+			/*
+			 * Default socket-buffer sizes may be too low (e.g.,
+			 * 8K) to allow atomic sends/receives of our requested
+			 * buffer length.  Extend both socket buffers to fit
+			 * better.
+			 */
+			sockoptval = buffersize;
+			if (setsockopt(writefd, SOL_SOCKET, SO_SNDBUF,
+			    &sockoptval, sizeof(sockoptval)) < 0)
+				err(EX_OSERR, "FAIL: setsockopt SO_SNDBUF");
+			if (setsockopt(readfd, SOL_SOCKET, SO_RCVBUF,
+			    &sockoptval, sizeof(sockoptval)) < 0)
+				err(EX_OSERR, "FAIL: setsockopt SO_RCVBUF");
+		}
+	}
+	*readfdp = readfd;
+	*writefdp = writefd;
+}
+
+/*
+ * Perform the actual benchmark; timing is done within different versions as
+ * they behave quite differently.  Each returns the total execution time from
+ * just before first byte sent to just after last byte received.
+ */
+static struct timespec
+ipc_benchmark(int readfd, int writefd, long blockcount, void *readbuf,
+    void *writebuf)
+{
+	struct timespec ts;
+
+	switch (benchmark_mode) {
+	case BENCHMARK_MODE_1THREAD:
+		ts = do_1thread(readfd, writefd, blockcount, readbuf,
+		    writebuf);
+		break;
+
+	case BENCHMARK_MODE_2THREAD:
+	case BENCHMARK_MODE_SCENARIO:
+		ts = do_2thread(readfd, writefd, blockcount, readbuf,
+		    writebuf);
+		break;
+
+	case BENCHMARK_MODE_2PROC:
+		ts = do_2proc(readfd, writefd, blockcount, readbuf, writebuf);
+		break;
+
+	case BENCHMARK_MODE_SERVER:
+		ts = do_server(readfd, blockcount, readbuf);
+		break;
+
+	case BENCHMARK_MODE_CLIENT:
+		ts = do_client(writefd, blockcount, writebuf);
+		break;
+
+	default:
+		assert(0);
+	}
+	return (ts);
+}
+
+/*
+ * Convert the time taken to move 'bytes' bytes into KBytes/sec.
+ */
+static double
+ipc_rate(struct timespec ts, long bytes)
+{
+	double secs, rate;
+
+	/* Seconds with fractional component. */
+	secs = (float)ts.tv_sec + (float)ts.tv_nsec / 1000000000;
+
+	/* Bytes/second. */
+	rate = bytes / secs;
+
+	/* Kilobytes/second. */
+	rate /= (1024);
+	return (rate);
+}
+
+/*
+ * Run the benchmark once for every combination of socket-option values,
+ * printing throughput and round-trip latency for each, and finally the
+ * combination giving the highest throughput.
+ */
+static void
+ipc_sweep(long blockcount, void *readbuf, void *writebuf)
+{
+	const char *best[SOCKOPT_MAX];
+	struct timespec ts;
+	double rate, rtt, best_rate, best_rtt;
+	int idx[SOCKOPT_MAX], opt, readfd, writefd;
+
+	bzero(idx, sizeof(idx));
+	best_rate = best_rtt = 0;
+	for (;;) {
+		for (opt = 0; opt < SOCKOPT_MAX; opt++)
+			sockopt_current[opt] = sockopt_values[opt].sv_count ?
+			    sockopt_values[opt].sv_values[idx[opt]] : NULL;
+		ipc_objects(&readfd, &writefd);
+		ts = ipc_benchmark(readfd, writefd, blockcount, readbuf,
+		    writebuf);
+		rtt = tcp_latency(readfd, writefd);
+		close(readfd);
+		close(writefd);
+		rate = ipc_rate(ts, totalsize);
+		if (!qflag) {
+			sockopt_print();
+			printf(": %.2F KBytes/sec, %.1F us RTT\n", rate, rtt);
+			fflush(stdout);
+		}
+		if (rate > best_rate) {
+			best_rate = rate;
+			best_rtt = rtt;
+			memcpy(best, sockopt_current, sizeof(best));
+		}
+
+		/* Advance to the next combination, odometer-style. */
+		for (opt = 0; opt < SOCKOPT_MAX; opt++) {
+			if (++idx[opt] < sockopt_values[opt].sv_count)
+				break;
+			idx[opt] = 0;
+		}
+		if (opt == SOCKOPT_MAX)
+			break;
+	}
+	memcpy(sockopt_current, best, sizeof(best));
+	printf("best: ");
+	sockopt_print();
+	printf(": %.2F KBytes/sec, %.1F us RTT\n", best_rate, best_rtt);
+}
+
+#ifdef F_SETPIPE_SZ
+/*
+ * Largest pipe capacity an unprivileged process may request.
+ */
+#define	PIPE_MAX_SIZE_PATH	"/proc/sys/fs/pipe-max-size"
+
+static long
+pipe_max_size(void)
+{
+	FILE *fp;
+	long l;
+
+	fp = fopen(PIPE_MAX_SIZE_PATH, "r");
+	if (fp == NULL)
+		err(EX_OSFILE, "FAIL: %s", PIPE_MAX_SIZE_PATH);
+	if (fscanf(fp, "%ld", &l) != 1)
+		errx(EX_OSFILE, "FAIL: %s: unreadable", PIPE_MAX_SIZE_PATH);
+	fclose(fp);
+	return (l);
+}
+
+/*
+ * Run the benchmark for each pair of pipe capacity, doubling from the page
+ * size to pipe-max-size, and buffer size, doubling from the page size to
+ * -b buffersize, printing throughput and the capacity actually granted for
+ * each, and finally the pair giving the highest throughput.
+ */
+static void
+pipe_sweep(void *readbuf, void *writebuf)
+{
+	struct timespec ts;
+	long best_buffersize, best_capacity, capacity, maxcapacity;
+	long maxbuffersize;
+	double rate, best_rate;
+	int granted, readfd, writefd;
+
+	maxcapacity = pipe_max_size();
+	maxbuffersize = buffersize;
+	best_rate = 0;
+	best_buffersize = best_capacity = 0;
+	for (capacity = getpagesize(); ; capacity *= 2) {
+		capacity = min(capacity, maxcapacity);
+		for (buffersize = getpagesize(); buffersize <= maxbuffersize;
+		    buffersize *= 2) {
+			if (totalsize % buffersize != 0)
+				continue;
+			pipe_capacity = capacity;
+			ipc_objects(&readfd, &writefd);
+			granted = fcntl(writefd, F_GETPIPE_SZ);
+			ts = ipc_benchmark(readfd, writefd,
+			    totalsize / buffersize, readbuf, writebuf);
+			close(readfd);
+			close(writefd);
+			rate = ipc_rate(ts, totalsize);
+			if (!qflag) {
+				printf("capacity=%ld (granted %d) "
+				    "buffersize=%ld: %.2F KBytes/sec\n",
+				    capacity, granted, buffersize, rate);
+				fflush(stdout);
+			}
+			if (rate > best_rate) {
+				best_rate = rate;
+				best_capacity = capacity;
+				best_buffersize = buffersize;
+			}
+		}
+		if (capacity == maxcapacity)
+			break;
+	}
+	buffersize = maxbuffersize;
+	printf("best: capacity=%ld buffersize=%ld: %.2F KBytes/sec\n",
+	    best_capacity, best_buffersize, best_rate);
+}
+#endif
+
+/*
+ * Network profiles for scenario mode.  Delay and jitter are split evenly
+ * between the two directions; loss and rate limiting apply only to the
+ * data direction, from server to client namespace.  A profile without any
+ * impairment removes the qdisc to measure the bare veth path.
+ */
+struct scenario_profile {
+	const char	*sp_name;
+	unsigned int	 sp_rtt;	/* Round-trip delay (us) */
+	unsigned int	 sp_jitter;	/* Round-trip jitter (us) */
+	const char	*sp_loss;	/* Loss (%), or NULL */
+	const char	*sp_rate;	/* tc rate limit, or NULL */
+};
+
+static const struct scenario_profile scenario_profiles[] = {
+	{ "rtt0",	0,	0,	NULL,	NULL },
+	{ "rtt1",	1000,	0,	NULL,	NULL },
+	{ "rtt10",	10000,	0,	NULL,	NULL },
+	{ "rtt50",	50000,	0,	NULL,	NULL },
+	{ "rtt100",	100000,	0,	NULL,	NULL },
+	{ "jitter",	50000,	10000,	NULL,	NULL },
+	{ "lossy",	50000,	0,	"0.1",	NULL },
+	{ "wan100",	50000,	0,	NULL,	"100mbit" },
+	{ NULL,		0,	0,	NULL,	NULL }
+};
+
+/*
+ * Bitmask of profiles selected with -Z; if zero, run them all.
+ */
+static unsigned int scenario_selected;
+
+/*
+ * Large enough that netem's queue does not drop packets in flight at any
+ * profile's bandwidth-delay product.
+ */
+#define	SCENARIO_NETEM_LIMIT	100000
+
+static void
+scenario_select(char *names)
+{
+	char *name;
+	int i;
+
+	while ((name = strsep(&names, ",")) != NULL) {
+		for (i = 0; scenario_profiles[i].sp_name != NULL; i++) {
+			if (strcmp(name, scenario_profiles[i].sp_name) == 0)
+				break;
+		}
+		if (scenario_profiles[i].sp_name == NULL)
+			usage();
+		scenario_selected |= 1 << i;
+	}
+}
+
+#ifdef __linux__
+static int
+scenario_system(int check, const char *fmt, ...)
+{
+	char command[512];
+	va_list ap;
+	int ret;
+
+	va_start(ap, fmt);
+	vsnprintf(command, sizeof(command), fmt, ap);
+	va_end(ap);
+	if (vflag) {
+		printf("  # %s\n", command);
+		fflush(stdout);
+	}
+	ret = system(command);
+	if (check && ret != 0)
+		errx(EX_OSERR, "FAIL: %s", command);
+	return (ret);
+}
+
+static void
+scenario_teardown(void)
+{
+
+	if (scenario_nsfd[SCENARIO_HOST] >= 0)
+		scenario_enter(SCENARIO_HOST);
+	scenario_system(0, "ip netns del %s 2>/dev/null", SCENARIO_NS_CLIENT);
+	scenario_system(0, "ip netns del %s 2>/dev/null", SCENARIO_NS_SERVER);
+}
+
+static int
+scenario_open(const char *path)
+{
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		err(EX_OSERR, "FAIL: %s", path);
+	return (fd);
+}
+
+static void
+scenario_setup(void)
+{
+
+	scenario_teardown();
+	atexit(scenario_teardown);
+	scenario_system(1, "ip netns add %s", SCENARIO_NS_SERVER);
+	scenario_system(1, "ip netns add %s", SCENARIO_NS_CLIENT);
+	scenario_system(1, "ip link add %s netns %s type veth peer name %s "
+	    "netns %s", SCENARIO_IF_SERVER, SCENARIO_NS_SERVER,
+	    SCENARIO_IF_CLIENT, SCENARIO_NS_CLIENT);
+	scenario_system(1, "ip -n %s addr add %s/24 dev %s",
+	    SCENARIO_NS_SERVER, SCENARIO_ADDR_SERVER, SCENARIO_IF_SERVER);
+	scenario_system(1, "ip -n %s addr add %s/24 dev %s",
+	    SCENARIO_NS_CLIENT, SCENARIO_ADDR_CLIENT, SCENARIO_IF_CLIENT);
+	scenario_system(1, "ip -n %s link set %s up", SCENARIO_NS_SERVER,
+	    SCENARIO_IF_SERVER);
+	scenario_system(1, "ip -n %s link set %s up", SCENARIO_NS_CLIENT,
+	    SCENARIO_IF_CLIENT);
+	scenario_nsfd[SCENARIO_HOST] = scenario_open("/proc/self/ns/net");
+	scenario_nsfd[SCENARIO_SERVER] =
+	    scenario_open("/var/run/netns/" SCENARIO_NS_SERVER);
+	scenario_nsfd[SCENARIO_CLIENT] =
+	    scenario_open("/var/run/netns/" SCENARIO_NS_CLIENT);
+	if (inet_pton(AF_INET, SCENARIO_ADDR_SERVER, &tcp_addr) != 1)
+		assert(0);
+	tcp_addr_string = SCENARIO_ADDR_SERVER;
+}
+
+static void
+scenario_netem(const char *ns, const char *ifname,
+    const struct scenario_profile *spp, int data)
+{
+	char loss[32], rate[32];
+
+	if (spp->sp_rtt == 0 && spp->sp_jitter == 0 &&
+	    spp->sp_loss == NULL && spp->sp_rate == NULL) {
+		scenario_system(0, "ip netns exec %s tc qdisc del dev %s root "
+		    "2>/dev/null", ns, ifname);
+		return;
+	}
+	loss[0] = rate[0] = '\0';
+	if (data && spp->sp_loss != NULL)
+		snprintf(loss, sizeof(loss), " loss %s%%", spp->sp_loss);
+	if (data && spp->sp_rate != NULL)
+		snprintf(rate, sizeof(rate), " rate %s", spp->sp_rate);
+	scenario_system(1, "ip netns exec %s tc qdisc replace dev %s root "
+	    "netem limit %u delay %uus %uus%s%s", ns, ifname,
+	    SCENARIO_NETEM_LIMIT, spp->sp_rtt / 2, spp->sp_jitter / 2, loss,
+	    rate);
+}
+
+/*
+ * Run the socket-option sweep (see ipc_sweep()) under each selected
+ * profile, giving a table of throughput against RTT and buffer sizes.
+ */
+static void
+scenario(long blockcount, void *readbuf, void *writebuf)
+{
+	const struct scenario_profile *spp;
+	int i;
+
+	scenario_setup();
+	for (i = 0; scenario_profiles[i].sp_name != NULL; i++) {
+		if (scenario_selected != 0 &&
+		    (scenario_selected & (1 << i)) == 0)
+			continue;
+		spp = &scenario_profiles[i];
+		if (!qflag) {
+			printf("profile %s: %.1F ms RTT, %.1F ms jitter, "
+			    "%s%% loss, rate %s\n", spp->sp_name,
+			    spp->sp_rtt / 1000.0, spp->sp_jitter / 1000.0,
+			    spp->sp_loss != NULL ? spp->sp_loss : "0",
+			    spp->sp_rate != NULL ? spp->sp_rate : "unlimited");
+			fflush(stdout);
+		}
+		scenario_netem(SCENARIO_NS_SERVER, SCENARIO_IF_SERVER, spp, 1);
+		scenario_netem(SCENARIO_NS_CLIENT, SCENARIO_IF_CLIENT, spp, 0);
+		ipc_sweep(blockcount, readbuf, writebuf);
+	}
+}
+#endif
+
+/*
+ * Connection-rate benchmark (connrate mode).  Client threads repeatedly
+ * connect to the benchmark port, send a small message, and close.  The
+ * listener is served by several acceptor threads, each with its own
+ * SO_REUSEPORT listen socket so that the kernel spreads incoming
+ * connections across per-socket accept queues -- or, with -L, all sharing
+ * a single listen socket and accept queue.  Each message carries the time
+ * at which the client called connect(), so that acceptors can record the
+ * latency until accept() returned.  As clients close first, it is they
+ * that accumulate TIME_WAIT state.
+ */
+struct connrate_state {
+	int		*cs_listenfds;	/* One per acceptor, or one if -L. */
+	uint64_t	*cs_latencies;	/* Accept latency (ns) per connection. */
+	long		 cs_accepted;	/* Connections accepted so far. */
+	struct timespec	 cs_finishtime;	/* When the last was handled. */
+	pthread_mutex_t	 cs_mutex;
+	pthread_cond_t	 cs_cond;
+	int		 cs_done;
+};
+
+struct connrate_thread {
+	struct connrate_state	*ct_state;
+	pthread_t		 ct_thread;
+	int			 ct_listenfd;	/* Acceptors only. */
+	long			 ct_count;	/* Clients only. */
+};
+
+static void
+connrate_sockaddr(struct sockaddr_in *sinp)
+{
+
+	bzero(sinp, sizeof(*sinp));
+#ifndef __linux__
+	sinp->sin_len = sizeof(*sinp);
+#endif
+	sinp->sin_family = AF_INET;
+	sinp->sin_addr = tcp_addr;
+	sinp->sin_port = htons(tcp_port);
+}
+
+static int
+connrate_listen(void)
+{
+	struct sockaddr_in sin;
+	int fd, i;
+
+	fd = socket(PF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		err(EX_OSERR, "FAIL: socket (listen)");
+	i = 1;
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &i, sizeof(i)) < 0)
+		err(EX_OSERR, "FAIL: setsockopt SO_REUSEADDR");
+#ifdef SO_REUSEPORT_LB
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT_LB, &i, sizeof(i)) < 0)
+		err(EX_OSERR, "FAIL: setsockopt SO_REUSEPORT_LB");
+#else
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &i, sizeof(i)) < 0)
+		err(EX_OSERR, "FAIL: setsockopt SO_REUSEPORT");
+#endif
+	sockopt_apply(fd, 0);
+	connrate_sockaddr(&sin);
+	if (bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+		err(EX_OSERR, "FAIL: bind");
+	if (listen(fd, -1) < 0)
+		err(EX_OSERR, "FAIL: listen");
+	return (fd);
+}
+
+static void *
+connrate_acceptor(void *arg)
+{
+	struct connrate_thread *ctp = arg;
+	struct connrate_state *csp = ctp->ct_state;
+	char buf[CONNRATE_MSGSIZE];
+	uint64_t accepted_ns, connect_ns;
+	ssize_t len;
+	size_t off;
+	long n;
+	int fd;
+
+	for (;;) {
+		fd = accept(ctp->ct_listenfd, NULL, NULL);
+		if (fd < 0) {
+			/* shutdown() of the listen socket ends the run. */
+			if (csp->cs_done)
+				return (NULL);
+			err(EX_OSERR, "FAIL: accept");
+		}
+		accepted_ns = monotonic_ns();
+		for (off = 0; (len = read(fd, buf + off, sizeof(buf) - off))
+		    > 0; off += len);
+		if (len < 0)
+			err(EX_IOERR, "FAIL: read");
+		if (off != sizeof(buf))
+			errx(EX_IOERR, "FAIL: short message %zu", off);
+		close(fd);
+		memcpy(&connect_ns, buf, sizeof(connect_ns));
+		n = __atomic_fetch_add(&csp->cs_accepted, 1, __ATOMIC_RELAXED);
+		csp->cs_latencies[n] = accepted_ns - connect_ns;
+		if (n + 1 == iterations) {
+			if (clock_gettime(CLOCK_REALTIME,
+			    &csp->cs_finishtime) < 0)
+				err(EX_OSERR, "FAIL: clock_gettime");
+			pthread_mutex_lock(&csp->cs_mutex);
+			csp->cs_done = 1;
+			pthread_cond_signal(&csp->cs_cond);
+			pthread_mutex_unlock(&csp->cs_mutex);
+		}
+	}
+}
+
+static void *
+connrate_client(void *arg)
+{
+	struct connrate_thread *ctp = arg;
+	struct sockaddr_in sin;
+	char buf[CONNRATE_MSGSIZE];
+	uint64_t connect_ns;
+	long i;
+	int fd;
+
+	bzero(buf, sizeof(buf));
+	connrate_sockaddr(&sin);
+	for (i = 0; i < ctp->ct_count; i++) {
+		fd = socket(PF_INET, SOCK_STREAM, 0);
+		if (fd < 0)
+			err(EX_OSERR, "FAIL: socket");
+		sockopt_apply(fd, 1);
+		connect_ns = monotonic_ns();
+		if (connect(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+			err(EX_OSERR, "FAIL: connect");
+		memcpy(buf, &connect_ns, sizeof(connect_ns));
+		if (write(fd, buf, sizeof(buf)) != sizeof(buf))
+			err(EX_IOERR, "FAIL: write");
+		close(fd);
+	}
+	return (NULL);
+}
+
+/*
+ * Count TCP connections on the benchmark port in TIME_WAIT, or return -1 if
+ * we don't know how to on this platform.
+ */
+static long
+connrate_timewait(void)
+{
+#ifdef __linux__
+	unsigned int lport, rport, state;
+	char line[256];
+	FILE *fp;
+	long count;
+
+	fp = fopen("/proc/net/tcp", "r");
+	if (fp == NULL)
+		return (-1);
+	count = 0;
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		if (sscanf(line, " %*u: %*x:%x %*x:%x %x", &lport, &rport,
+		    &state) != 3)
+			continue;
+		if (state == 0x06 && (lport == tcp_port || rport == tcp_port))
+			count++;
+	}
+	fclose(fp);
+	return (count);
+#else
+	return (-1);
+#endif
+}
+
+static void
+connrate(void)
+{
+	struct connrate_thread *acceptors, *clients;
+	struct connrate_state cs;
+	struct timespec starttime;
+	long timewait_before, timewait_after;
+	unsigned int i, nlisten;
+	uint64_t *l;
+	double secs;
+
+	bzero(&cs, sizeof(cs));
+	cs.cs_latencies = calloc(iterations, sizeof(uint64_t));
+	if (cs.cs_latencies == NULL)
+		err(EX_OSERR, "FAIL: calloc");
+	pthread_mutex_init(&cs.cs_mutex, NULL);
+	pthread_cond_init(&cs.cs_cond, NULL);
+	nlisten = Lflag ? 1 : connrate_acceptors;
+	cs.cs_listenfds = calloc(nlisten, sizeof(int));
+	acceptors = calloc(connrate_acceptors, sizeof(*acceptors));
+	clients = calloc(connrate_clients, sizeof(*clients));
+	if (cs.cs_listenfds == NULL || acceptors == NULL || clients == NULL)
+		err(EX_OSERR, "FAIL: calloc");
+	for (i = 0; i < nlisten; i++)
+		cs.cs_listenfds[i] = connrate_listen();
+	for (i = 0; i < connrate_acceptors; i++) {
+		acceptors[i].ct_state = &cs;
+		acceptors[i].ct_listenfd = cs.cs_listenfds[Lflag ? 0 : i];
+		if (pthread_create(&acceptors[i].ct_thread, NULL,
+		    connrate_acceptor, &acceptors[i]) != 0)
+			err(EX_OSERR, "FAIL: pthread_create");
+	}
+	timewait_before = connrate_timewait();
+	if (!Bflag)
+		sleep(1);
+
+	if (clock_gettime(CLOCK_REALTIME, &starttime) < 0)
+		err(EX_OSERR, "FAIL: clock_gettime");
+
+	/*
+	 * HERE BEGINS THE BENCHMARK (connrate).
+	 */
+	if (IPCBENCH_BENCHMARK_START_ENABLED())
+		IPCBENCH_BENCHMARK_START(benchmark_mode, ipc_type, buffersize,
+		    totalsize);
+	for (i = 0; i < connrate_clients; i++) {
+		clients[i].ct_state = &cs;
+		clients[i].ct_count = iterations / connrate_clients +
+		    (i < iterations % connrate_clients ? 1 : 0);
+		if (pthread_create(&clients[i].ct_thread, NULL,
+		    connrate_client, &clients[i]) != 0)
+			err(EX_OSERR, "FAIL: pthread_create");
+	}
+	pthread_mutex_lock(&cs.cs_mutex);
+	while (!cs.cs_done)
+		pthread_cond_wait(&cs.cs_cond, &cs.cs_mutex);
+	pthread_mutex_unlock(&cs.cs_mutex);
+	/*
+	 * HERE ENDS THE BENCHMARK (connrate).
+	 */
+	if (IPCBENCH_BENCHMARK_END_ENABLED())
+		IPCBENCH_BENCHMARK_END();
+
+	for (i = 0; i < connrate_clients; i++)
+		pthread_join(clients[i].ct_thread, NULL);
+	for (i = 0; i < nlisten; i++)
+		shutdown(cs.cs_listenfds[i], SHUT_RDWR);
+	for (i = 0; i < connrate_acceptors; i++)
+		pthread_join(acceptors[i].ct_thread, NULL);
+	for (i = 0; i < nlisten; i++)
+		close(cs.cs_listenfds[i]);
+	timewait_after = connrate_timewait();
+
+	if (!qflag) {
+		timespecsub(&cs.cs_finishtime, &starttime);
+		if (vflag) {
+			printf("Benchmark configuration:\n");
+			printf("  mode: %s\n",
+			    benchmark_mode_to_string(benchmark_mode));
+			printf("  connections: %ld\n", iterations);
+			printf("  clients: %u\n", connrate_clients);
+			printf("  acceptors: %u\n", connrate_acceptors);
+			printf("  acceptqueues: %s\n", Lflag ? "shared" :
+			    "SO_REUSEPORT");
+			printf("  time: %jd.%09jd\n",
+			    (intmax_t)cs.cs_finishtime.tv_sec,
+			    (intmax_t)cs.cs_finishtime.tv_nsec);
+		}
+		l = cs.cs_latencies;
+		qsort(l, iterations, sizeof(*l), uint64_compare);
+		printf("accept latency (us): p50 %.1F, p90 %.1F, p99 %.1F, "
+		    "p99.9 %.1F, max %.1F\n",
+		    l[iterations * 50 / 100] / 1000.0,
+		    l[iterations * 90 / 100] / 1000.0,
+		    l[iterations * 99 / 100] / 1000.0,
+		    l[iterations * 999 / 1000] / 1000.0,
+		    l[iterations - 1] / 1000.0);
+		if (timewait_before >= 0)
+			printf("TIME_WAIT connections: %ld before, %ld after\n",
+			    timewait_before, timewait_after);
+		secs = timespec_ns(cs.cs_finishtime) / 1000000000;
+		printf("%.2F connections/sec\n", iterations / secs);
+	}
+	free(clients);
+	free(acceptors);
+	free(cs.cs_listenfds);
+	free(cs.cs_latencies);
+}
+
+static void *
+spawn_thread(void *arg)
+{
+
+	return (NULL);
+}
+
+#ifdef __linux__
+static int
+spawn_clone_child(void *arg)
+{
+
+	return (0);
+}
+#endif
+
+/*
+ * Reap a spawned child, which must have exited cleanly.
+ */
+static void
+spawn_wait(pid_t pid)
+{
+	int status;
+
+	if (waitpid(pid, &status, 0) < 0)
+		err(EX_OSERR, "FAIL: waitpid");
+	if (WIFSIGNALED(status))
+		errx(EX_SOFTWARE, "FAIL: spawned child killed by signal %d",
+		    WTERMSIG(status));
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		errx(EX_SOFTWARE, "FAIL: spawned child exited with status %d",
+		    WEXITSTATUS(status));
+}
+
+/*
+ * Create and tear down -n processes or threads one after another, timing
+ * each from the creating call to its return in the parent, and to the
+ * child's reaping or joining.  vfork() suspends the parent until the child
+ * exits or execs, so for it the two largely coincide.
+ *
+ * With -r, the parent first faults in that much private memory, whose page
+ * tables fork() must copy (and whose pages it must mark copy-on-write),
+ * but vfork(), clone() and pthread_create() share.  On Linux, transparent
+ * huge pages are disabled for it, as a heap built of small allocations
+ * would usually be mapped with small pages.
+ */
+static void
+spawn(void)
+{
+	struct timespec starttime, finishtime;
+	char *target, *exec_argv[3];
+	void *rss, *stack;
+	uint64_t *create_ns, *life_ns, t0, t1;
+	pthread_t thread;
+	long i, pagesize;
+	pid_t pid;
+	double secs;
 
-	FD_ZERO(&fdset_read);
-	FD_SET(readfd, &fdset_read);
-	FD_ZERO(&fdset_write);
-	FD_SET(writefd, &fdset_write);
+	create_ns = calloc(iterations, sizeof(*create_ns));
+	life_ns = calloc(iterations, sizeof(*life_ns));
+	if (create_ns == NULL || life_ns == NULL)
+		err(EX_OSERR, "FAIL: calloc");
+	rss = NULL;
+	if (spawn_rss != 0) {
+		rss = mmap(NULL, spawn_rss, PROT_READ | PROT_WRITE,
+		    MAP_ANON | MAP_PRIVATE, -1, 0);
+		if (rss == MAP_FAILED)
+			err(EX_OSERR, "FAIL: mmap");
+#ifdef MADV_NOHUGEPAGE
+		(void)madvise(rss, spawn_rss, MADV_NOHUGEPAGE);
+#endif
+		pagesize = getpagesize();
+		for (i = 0; i < spawn_rss; i += pagesize)
+			((volatile char *)rss)[i] = 1;
+	}
+	stack = NULL;
+#ifdef __linux__
+	if (spawn_method == SPAWN_METHOD_CLONE) {
+		stack = mmap(NULL, SPAWN_CLONE_STACKSIZE,
+		    PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+		if (stack == MAP_FAILED)
+			err(EX_OSERR, "FAIL: mmap");
+	}
+#endif
+	target = (char *)(spawn_target != NULL ? spawn_target : spawn_self);
+	exec_argv[0] = target;
+	exec_argv[1] = SPAWN_EXIT_ARG;
+	exec_argv[2] = NULL;
+	if (!Bflag)
+		sleep(1);
 
 	if (clock_gettime(CLOCK_REALTIME, &starttime) < 0)
 		err(EX_OSERR, "FAIL: clock_gettime");
-#ifdef WITH_PMC
-	if (benchmark_pmc != BENCHMARK_PMC_NONE)
-		pmc_begin();
-#endif
 
 	/*
-	 * HERE BEGINS THE BENCHMARK (1-thread).
+	 * HERE BEGINS THE BENCHMARK (spawn).
 	 */
-	read_sofar = write_sofar = 0;
-	/** As the I/O is nonblocking write()/read() will return after only
-	 * reading part of the buffer. For this benchmark we ensure that
-	 * the whole buffer is used instead of always using offset 0 to
-	 * have the same behaviour as the 2thread/2proc version */
-	while (read_sofar < totalsize) {
-		const size_t remaining_write = totalsize - write_sofar;
-		if (remaining_write > 0) {
-			const size_t offset = write_sofar % buffersize;
-			const size_t bytes_to_write = min(remaining_write, buffersize - offset);
-			len_write = write(writefd, writebuf + offset, bytes_to_write);
-			/*printf("write(%d, %zd, %zd) = %zd\n", writefd, offset, bytes_to_write, len_write);*/
-			if (len_write < 0 && errno != EAGAIN)
-				err(EX_IOERR, "FAIL: write");
-			if (len_write > 0)
-				write_sofar += len_write;
-		}
-		if (write_sofar != 0) {
-			const size_t offset = read_sofar % buffersize;
-			const size_t bytes_to_read = min(totalsize - read_sofar, buffersize - offset);
-			len_read = read(readfd, readbuf + offset, bytes_to_read);
-			/*printf("read(%d, %zd, %zd) = %zd\n", readfd, offset, bytes_to_read, len_read);*/
-			if (len_read < 0 && errno != EAGAIN)
-				err(EX_IOERR, "FAIL: read");
-			if (len_read > 0)
-				read_sofar += len_read;
-		}
+	if (IPCBENCH_BENCHMARK_START_ENABLED())
+		IPCBENCH_BENCHMARK_START(benchmark_mode, ipc_type, buffersize,
+		    totalsize);
+	for (i = 0; i < iterations; i++) {
+		t0 = monotonic_ns();
+		switch (spawn_method) {
+		case SPAWN_METHOD_FORK:
+		case SPAWN_METHOD_FORKEXEC:
+			pid = fork();
+			if (pid < 0)
+				err(EX_OSERR, "FAIL: fork");
+			if (pid == 0) {
+				if (spawn_method == SPAWN_METHOD_FORKEXEC)
+					execvp(target, exec_argv);
+				_exit(spawn_method == SPAWN_METHOD_FORK ? 0 :
+				    EX_OSERR);
+			}
+			break;
 
-		/*
-		 * If we've had neither read nor write progress in this
-		 * iteration, block until one of reading or writing is
-		 * possible.
-		 */
-		if (read_sofar < totalsize &&
-		    (len_read == 0 && len_write == 0)) {
-			if (select(max(readfd, writefd), &fdset_read,
-			    &fdset_write, NULL, NULL) < 0)
-				err(EX_IOERR, "FAIL: select");
+		case SPAWN_METHOD_VFORK:
+		case SPAWN_METHOD_VFORKEXEC:
+			pid = vfork();
+			if (pid < 0)
+				err(EX_OSERR, "FAIL: vfork");
+			if (pid == 0) {
+				if (spawn_method == SPAWN_METHOD_VFORKEXEC)
+					execvp(target, exec_argv);
+				_exit(spawn_method == SPAWN_METHOD_VFORK ? 0 :
+				    EX_OSERR);
+			}
+			break;
+
+		case SPAWN_METHOD_POSIX_SPAWN:
+			errno = posix_spawnp(&pid, target, NULL, NULL,
+			    exec_argv, environ);
+			if (errno != 0)
+				err(EX_OSERR, "FAIL: posix_spawnp: %s", target);
+			break;
+
+		case SPAWN_METHOD_PTHREAD:
+			errno = pthread_create(&thread, NULL, spawn_thread,
+			    NULL);
+			if (errno != 0)
+				err(EX_OSERR, "FAIL: pthread_create");
+			pid = 0;
+			break;
+
+#ifdef __linux__
+		case SPAWN_METHOD_CLONE:
+			pid = clone(spawn_clone_child,
+			    (char *)stack + SPAWN_CLONE_STACKSIZE, CLONE_VM |
+			    CLONE_FS | CLONE_FILES | CLONE_SIGHAND | SIGCHLD,
+			    NULL);
+			if (pid < 0)
+				err(EX_OSERR, "FAIL: clone");
+			break;
+#endif
+
+		default:
+			assert(0);
 		}
+		t1 = monotonic_ns();
+		if (spawn_method == SPAWN_METHOD_PTHREAD) {
+			if ((errno = pthread_join(thread, NULL)) != 0)
+				err(EX_OSERR, "FAIL: pthread_join");
+		} else
+			spawn_wait(pid);
+		create_ns[i] = t1 - t0;
+		life_ns[i] = monotonic_ns() - t0;
 	}
-
 	/*
-	 * HERE ENDS THE BENCHMARK (1-thread).
+	 * HERE ENDS THE BENCHMARK (spawn).
 	 */
-#ifdef WITH_PMC
-	if (benchmark_pmc != BENCHMARK_PMC_NONE)
-		pmc_end();
-#endif
+	if (IPCBENCH_BENCHMARK_END_ENABLED())
+		IPCBENCH_BENCHMARK_END();
 	if (clock_gettime(CLOCK_REALTIME, &finishtime) < 0)
 		err(EX_OSERR, "FAIL: clock_gettime");
-	timespecsub(&finishtime, &starttime);
-	return (finishtime);
+
+	if (!qflag) {
+		timespecsub(&finishtime, &starttime);
+		if (vflag) {
+			printf("Benchmark configuration:\n");
+			printf("  mode: %s\n",
+			    benchmark_mode_to_string(benchmark_mode));
+			printf("  method: %s\n",
+			    spawn_method_to_string(spawn_method));
+			if (spawn_method_exec(spawn_method))
+				printf("  target: %s\n", target);
+			printf("  creations: %ld\n", iterations);
+			printf("  rss: %ld\n", spawn_rss);
+			printf("  time: %jd.%09jd\n",
+			    (intmax_t)finishtime.tv_sec,
+			    (intmax_t)finishtime.tv_nsec);
+		}
+		qsort(create_ns, iterations, sizeof(*create_ns),
+		    uint64_compare);
+		qsort(life_ns, iterations, sizeof(*life_ns),
+		    uint64_compare);
+		printf("creation latency (us): p50 %.1F, p90 %.1F, p99 %.1F, "
+		    "p99.9 %.1F, max %.1F\n",
+		    create_ns[iterations * 50 / 100] / 1000.0,
+		    create_ns[iterations * 90 / 100] / 1000.0,
+		    create_ns[iterations * 99 / 100] / 1000.0,
+		    create_ns[iterations * 999 / 1000] / 1000.0,
+		    create_ns[iterations - 1] / 1000.0);
+		printf("creation to teardown (us): p50 %.1F, p90 %.1F, "
+		    "p99 %.1F, p99.9 %.1F, max %.1F\n",
+		    life_ns[iterations * 50 / 100] / 1000.0,
+		    life_ns[iterations * 90 / 100] / 1000.0,
+		    life_ns[iterations * 99 / 100] / 1000.0,
+		    life_ns[iterations * 999 / 1000] / 1000.0,
+		    life_ns[iterations - 1] / 1000.0);
+		secs = timespec_ns(finishtime) / 1000000000;
+		printf("%.2F creations/sec\n", iterations / secs);
+	}
+	if (stack != NULL)
+		munmap(stack, SPAWN_CLONE_STACKSIZE);
+	if (rss != NULL)
+		munmap(rss, spawn_rss);
+	free(life_ns);
+	free(create_ns);
 }
 
 static void
 ipc(void)
 {
-	struct sockaddr_in sin;
 	struct timespec ts;
 	long blockcount;
 	void *readbuf, *writebuf;
-	int error, fd[2], flags, i, listenfd, readfd, writefd, sockoptval;
-	double secs, rate;
+	int readfd, writefd;
+	struct sender_stats stats_copy;
+	struct receiver_stats stats_block;
+	struct timespec ts_copy, ts_block;
+	struct osacct oa_before, oa_after;
+	struct calibrate_call cc[2];
+	char counts[64];
+	long reads, writes;
+	unsigned int engine, spin;
+	double latency_block, receiver, sender;
 #ifdef WITH_PMC
 	uint64_t clock_cycles, instr_executed, counter0, counter1;
 #endif
 
+	if (benchmark_mode == BENCHMARK_MODE_CONNRATE) {
+		connrate();
+		return;
+	}
+	if (benchmark_mode == BENCHMARK_MODE_SPAWN) {
+		spawn();
+		return;
+	}
 	if (totalsize % buffersize != 0)
 		errx(EX_USAGE, "FAIL: data size (%ld) is not a multiple of "
 		    "buffersize (%ld)", totalsize, buffersize);
 	blockcount = totalsize / buffersize;
 	if (blockcount < 0)
 		errx(EX_USAGE, "FAIL: negative block count");
+	if (ipc_type_datagram(ipc_type) && buffersize < (long)sizeof(uint64_t))
+		errx(EX_USAGE, "FAIL: buffersize (%ld) is too small for a "
+		    "sequence number", buffersize);
+	if (ipc_type == BENCHMARK_IPC_UDP_SOCKET && buffersize > DGRAM_UDP_MAX)
+		errx(EX_USAGE, "FAIL: buffersize (%ld) exceeds maximum UDP "
+		    "payload (%d)", buffersize, DGRAM_UDP_MAX);
+	if (Hflag && buffersize < (long)sizeof(struct chunk_header))
+		errx(EX_USAGE, "FAIL: buffersize (%ld) is too small for a "
+		    "chunk header", buffersize);
+	if (msgsize_dist != MSGSIZE_NONE)
+		msgsize_generate();
+	if (fanin_producers != 0) {
+		if (buffersize % sizeof(uint64_t) != 0)
+			errx(EX_USAGE, "FAIL: buffersize (%ld) is not a "
+			    "multiple of a fan-in tag (%zu)", buffersize,
+			    sizeof(uint64_t));
+		if (blockcount / fanin_producers > UINT32_MAX)
+			errx(EX_USAGE, "FAIL: too many blocks per producer");
+		if (blockcount < fanin_producers)
+			errx(EX_USAGE, "FAIL: fewer blocks (%ld) than "
+			    "producers (%u)", blockcount, fanin_producers);
+		fanin_stats = calloc(fanin_producers, sizeof(*fanin_stats));
+		if (fanin_stats == NULL)
+			err(EX_OSERR, "FAIL: calloc");
+	}
+	if (Hflag && benchmark_mode != BENCHMARK_MODE_CLIENT) {
+		chunk_latencies = calloc(blockcount, sizeof(uint64_t));
+		if (chunk_latencies == NULL)
+			err(EX_OSERR, "FAIL: calloc");
+	}
 
 	/*
 	 * Allocate zero-filled memory for our I/O buffer.
@@ -756,6 +5363,64 @@ ipc(void)
 	if (writebuf == NULL)
 		err(EX_OSERR, "FAIL: calloc");
 
+	/*
+	 * Zero-copy results are reported next to those for the copying
+	 * read()/write() path, which we measure first over its own IPC
+	 * object.
+	 */
+	if ((benchmark_engine == BENCHMARK_ENGINE_VMSPLICE ||
+	    benchmark_engine == BENCHMARK_ENGINE_SPLICE) &&
+	    buffersize % getpagesize() != 0)
+		errx(EX_USAGE, "FAIL: buffersize (%ld) is not a multiple of "
+		    "the page size (%d)", buffersize, getpagesize());
+	zerocopy_compare = benchmark_engine_zerocopy(benchmark_engine);
+	if (zerocopy_compare) {
+		engine = benchmark_engine;
+		benchmark_engine = BENCHMARK_ENGINE_RW;
+		ipc_objects(&readfd, &writefd);
+		ts_copy = ipc_benchmark(readfd, writefd, blockcount, readbuf,
+		    writebuf);
+		stats_copy = sender_stats;
+		close(readfd);
+		close(writefd);
+		benchmark_engine = engine;
+	}
+
+#ifdef __linux__
+	if (benchmark_mode == BENCHMARK_MODE_SCENARIO) {
+		scenario(blockcount, readbuf, writebuf);
+		return;
+	}
+#endif
+	/*
+	 * Similarly, busy-polling results are reported next to those for
+	 * blocking I/O.
+	 */
+	if (lflag) {
+		spin = lflag;
+		lflag = 0;
+		ipc_objects(&readfd, &writefd);
+		ts_block = ipc_benchmark(readfd, writefd, blockcount, readbuf,
+		    writebuf);
+		stats_block = receiver_stats;
+		if (Hflag)
+			latency_block = chunk_median(blockcount);
+		close(readfd);
+		close(writefd);
+		lflag = spin;
+	}
+
+	if (Wflag) {
+#ifdef F_SETPIPE_SZ
+		if (ipc_type == BENCHMARK_IPC_PIPE) {
+			pipe_sweep(readbuf, writebuf);
+			return;
+		}
+#endif
+		ipc_sweep(blockcount, readbuf, writebuf);
+		return;
+	}
+
 #ifdef WITH_PMC
 	/*
 	 * Allocate and initialise performance counters, if required.
@@ -767,173 +5432,68 @@ ipc(void)
 	/*
 	 * Allocate a suitable IPC object.
 	 */
-	switch (ipc_type) {
-	case BENCHMARK_IPC_PIPE:
-		if (pipe(fd) < 0)
-			err(EX_OSERR, "FAIL: pipe");
-
-		/*
-		 * On FreeBSD, it doesn't matter which end of the pipe we use,
-		 * but on other operating systems, it is sometimes the case
-		 * that the first file descriptor must be used for reading,
-		 * and the second for writing.
-		 */
-		readfd = fd[0];
-		writefd = fd[1];
-		break;
-
-	case BENCHMARK_IPC_LOCAL_SOCKET:
-		if (socketpair(PF_LOCAL, SOCK_STREAM, 0, fd) < 0)
-			err(EX_OSERR, "FAIL: socketpair");
-
-		/*
-		 * With socket pairs, it makes no difference which one we use
-		 * for reading or writing.
-		 */
-		readfd = fd[0];
-		writefd = fd[1];
-		break;
-
-	case BENCHMARK_IPC_TCP_SOCKET:
-		listenfd = socket(PF_INET, SOCK_STREAM, 0);
-		if (listenfd < 0)
-			err(EX_OSERR, "FAIL: socket (listen)");
-
-		/*
-		 * Socket address used for both binding and connecting.
-		 */
-		i = 1;
-		if (setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &i,
-		    sizeof(i)) < 0)
-			err(EX_OSERR, "FAIL: setsockopt SO_REUSEADDR");
-		bzero(&sin, sizeof(sin));
-		sin.sin_len = sizeof(sin);
-		sin.sin_family = AF_INET;
-		sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
-		sin.sin_port = htons(tcp_port);
-		if (bind(listenfd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
-			err(EX_OSERR, "FAIL: bind");
-		if (listen(listenfd, -1) < 0)
-			err(EX_OSERR, "FAIL: listen");
-
-		/*
-		 * Create the 'read' endpoint and connect it to the listen
-		 * socket in a non-blocking manner (as we need to accept()
-		 * it before the connection can complete, and don't want to
-		 * deadlock).
-		 *
-		 * Note that it *does* matter which we use for reading vs.
-		 * writing -- we intentionally wait until the full three-way
-		 * handshake is done before transmitting data, and only the
-		 * accepted socket has this property (i.e., waiting for the
-		 * ACK in the SYN-SYN/ACK-ACK exchange).
-		 */
-		readfd = socket(PF_INET, SOCK_STREAM, 0);
-		if (readfd < 0)
-			err(EX_OSERR, "FAIL: socket (read)");
-		flags = fcntl(readfd, F_GETFL, 0);
-		if (flags < 0)
-			err(EX_OSERR, "FAIL: fcntl(readfd, F_GETFL, 0)");
-		if (fcntl(readfd, F_SETFL, flags | O_NONBLOCK) < 0)
-			err(EX_OSERR, "FAIL: fcntl(readfd, F_SETFL, "
-			    "flags | O_NONBLOCK)");
-		error = connect(readfd, (struct sockaddr *)&sin,
-		    sizeof(sin));
-		if (error < 0 && errno != EINPROGRESS)
-			err(EX_OSERR, "FAIL: connect");
-
-		/*
-		 * On the listen socket, now accept the 'write' endpoint --
-		 * which should block until the full three-way handshake is
-		 * complete.
-		 */
-		writefd = accept(listenfd, NULL, NULL);
-		if (writefd < 0)
-			err(EX_OSERR, "accept");
-
-		/*
-		 * Restore blocking status to the 'read' endpoint, and close
-		 * the now-unnecessary listen socket.  Any further use of
-		 * the 'read' endpoint will block until the socket is ready,
-		 * although in practice that is unlikely.
-		 */
-		if (fcntl(readfd, F_SETFL, flags) < 0)
-			err(EX_OSERR, "FAIL: fcntl(readfd, F_SETFL, flags");
-		close(listenfd);
-		break;
-
-	default:
-		assert(0);
-	}
-
-
-	if (ipc_type == BENCHMARK_IPC_LOCAL_SOCKET ||
-	    ipc_type == BENCHMARK_IPC_TCP_SOCKET) {
-		if (sflag) {
-			/*
-			 * Default socket-buffer sizes may be too low (e.g.,
-			 * 8K) to allow atomic sends/receives of our requested
-			 * buffer length.  Extend both socket buffers to fit
-			 * better.
-			 */
-			sockoptval = buffersize;
-			if (setsockopt(writefd, SOL_SOCKET, SO_SNDBUF,
-			    &sockoptval, sizeof(sockoptval)) < 0)
-				err(EX_OSERR, "FAIL: setsockopt SO_SNDBUF");
-			if (setsockopt(readfd, SOL_SOCKET, SO_RCVBUF,
-			    &sockoptval, sizeof(sockoptval)) < 0)
-				err(EX_OSERR, "FAIL: setsockopt SO_RCVBUF");
-		}
+	ipc_objects(&readfd, &writefd);
+	if (Cflag) {
+		cc[0].cc_name = "null read()";
+		cc[0].cc_call = calibrate_read;
+		cc[0].cc_fd = readfd;
+		cc[1].cc_name = "null write()";
+		cc[1].cc_call = calibrate_write;
+		cc[1].cc_fd = writefd;
+		calibrate(cc, 2, readbuf, buffersize);
 	}
 
 	/*
 	 * Before we start, sync() the filesystem so that it is fairly
 	 * quiesced from prior work.  Give things a second to settle down.
+	 * A server is already listening, and must not keep its client
+	 * waiting, so does without.
 	 */
-	if (!Bflag) {
+	if (!Bflag && benchmark_mode != BENCHMARK_MODE_SERVER) {
 		/* Flush terminal output. */
 		fflush(stdout);
 		fflush(stderr);
 
-		/* Flush filesystems as a whole. */
-		(void)sync();
-		(void)sync();
-		(void)sync();
-
-		/*
-		 * Let things settle.
-		 *
-		 * NB: This will have the side effect of aliasing execution
-		 * to the timer.  Unclear if this is a good thing.
-		 */
-		(void)sleep(1);
-	}
-
-	/*
-	 * Perform the actual benchmark; timing is done within different
-	 * versions as they behave quite differently.  Each returns the total
-	 * execution time from just before first byte sent to just after last
-	 * byte received.
-	 */
-	switch (benchmark_mode) {
-	case BENCHMARK_MODE_1THREAD:
-		ts = do_1thread(readfd, writefd, blockcount, readbuf,
-		    writebuf);
-		break;
-
-	case BENCHMARK_MODE_2THREAD:
-		ts = do_2thread(readfd, writefd, blockcount, readbuf,
-		    writebuf);
-		break;
-
-	case BENCHMARK_MODE_2PROC:
-		ts = do_2proc(readfd, writefd, blockcount, readbuf, writebuf);
-		break;
+		/* Flush filesystems as a whole. */
+		(void)sync();
+		(void)sync();
+		(void)sync();
 
-	default:
-		assert(0);
+		/*
+		 * Let things settle.
+		 *
+		 * NB: This will have the side effect of aliasing execution
+		 * to the timer.  Unclear if this is a good thing.
+		 */
+		(void)sleep(1);
 	}
 
+	/*
+	 * Perform the actual benchmark.
+	 */
+#ifdef WITH_PERF
+	if (prof_event != NULL)
+		prof_setup();
+#endif
+	if (trace_path != NULL)
+		trace_setup(benchmark_mode == BENCHMARK_MODE_1THREAD ? 1 :
+		    1 + max(fanin_producers, 1), trace_names);
+	if (Rflag)
+		osacct_begin(&oa_before, -1);
+	if (duration_secs != 0)
+		duration_limit_setup();
+	if (tcpinfo_interval != 0)
+		tcpinfo_start(readfd, writefd);
+	if (interval_ms != 0)
+		interval_start();
+	ts = ipc_benchmark(readfd, writefd, blockcount, readbuf, writebuf);
+	if (interval_ms != 0)
+		interval_finish();
+	if (tcpinfo_interval != 0)
+		tcpinfo_finish();
+	if (Rflag)
+		osacct_end(&oa_after, -1);
+
 	/*
 	 * Now we can disruptively print things -- if we're not in quiet mode.
 	 */
@@ -943,10 +5503,61 @@ ipc(void)
 			printf("  buffersize: %ld\n", buffersize);
 			printf("  totalsize: %ld\n", totalsize);
 			printf("  blockcount: %ld\n", blockcount);
+			if (duration_secs != 0) {
+				printf("  duration: %ld\n", duration_secs);
+				printf("  bytes: %ld\n", benchmark_bytes);
+			}
 			printf("  mode: %s\n",
 			    benchmark_mode_to_string(benchmark_mode));
 			printf("  ipctype: %s\n",
 			    ipc_type_to_string(ipc_type));
+			if (ipc_type == BENCHMARK_IPC_TCP_SOCKET ||
+			    ipc_type == BENCHMARK_IPC_UDP_SOCKET)
+				printf("  address: %s:%u\n", tcp_addr_string,
+				    tcp_port);
+			printf("  engine: %s\n",
+			    benchmark_engine_to_string(benchmark_engine));
+			printf("  produce: %s\n",
+			    payload_to_string(payload_produce));
+			printf("  consume: %s\n",
+			    payload_to_string(payload_consume));
+			if (fanin_producers != 0)
+				printf("  producers: %u\n", fanin_producers);
+			if (msgsize_dist != MSGSIZE_NONE)
+				printf("  msgsizes: %s\n",
+				    msgsize_to_string(msgsize_dist));
+			if (ipc_type_datagram(ipc_type))
+				printf("  batch: %u\n", dgram_batch);
+			if (ipc_type == BENCHMARK_IPC_TCP_SOCKET) {
+				printf("  sockopts: ");
+				sockopt_print();
+				printf("\n");
+			}
+#ifdef WITH_IO_URING
+			if (benchmark_engine == BENCHMARK_ENGINE_URING) {
+				printf("  qdepth: %u\n", uring_qdepth);
+				printf("  sqpoll: %s\n", Sflag ? "yes" : "no");
+			}
+#endif
+#ifdef F_GETPIPE_SZ
+			if (ipc_type == BENCHMARK_IPC_PIPE)
+				printf("  pipecapacity: %d\n",
+				    fcntl(writefd, F_GETPIPE_SZ));
+#endif
+#ifdef SPLICE_F_GIFT
+			if (benchmark_engine == BENCHMARK_ENGINE_VMSPLICE ||
+			    benchmark_engine == BENCHMARK_ENGINE_SPLICE) {
+				printf("  giftring: %ld (page-aligned, "
+				    "buffer reused after >= pipecapacity "
+				    "bytes)\n", vmsplice_ringsize(writefd));
+			}
+			if (benchmark_engine == BENCHMARK_ENGINE_SPLICE)
+				printf("  sink: %s\n", splice_sink);
+#endif
+#ifdef SO_ZEROCOPY
+			if (benchmark_engine == BENCHMARK_ENGINE_ZEROCOPY)
+				printf("  nbufs: %u\n", zerocopy_nbufs);
+#endif
 			printf("  time: %jd.%09jd\n", (intmax_t)ts.tv_sec,
 			    (intmax_t)ts.tv_nsec);
 		}
@@ -994,19 +5605,122 @@ ipc(void)
 		}
 #endif
 
-		/* Seconds with fractional component. */
-		secs = (float)ts.tv_sec + (float)ts.tv_nsec / 1000000000;
-
-		/* Bytes/second. */
-		rate = totalsize / secs;
-
-		/* Kilobytes/second. */
-		rate /= (1024);
-
-		printf("%.2F KBytes/sec\n", rate);
+		if (benchmark_engine_zerocopy(benchmark_engine)) {
+			printf("sender CPU: %.3F ns/byte (copying rw: %.3F)\n",
+			    timespec_ns(sender_stats.ss_cputime) / totalsize,
+			    timespec_ns(stats_copy.ss_cputime) / totalsize);
+			if (sender_stats.ss_cycles != 0 &&
+			    stats_copy.ss_cycles != 0)
+				printf("sender CPU: %.3F cycles/byte (copying "
+				    "rw: %.3F)\n", (double)
+				    sender_stats.ss_cycles / totalsize,
+				    (double)stats_copy.ss_cycles / totalsize);
+			else
+				printf("sender CPU: cycles/byte unavailable\n");
+			if (benchmark_engine == BENCHMARK_ENGINE_ZEROCOPY)
+				printf("zerocopy sends: %ld, copied by kernel: "
+				    "%ld (%.1F%%)\n", sender_stats.ss_zc_sends,
+				    sender_stats.ss_zc_copied,
+				    sender_stats.ss_zc_sends == 0 ? 0.0 :
+				    100.0 * sender_stats.ss_zc_copied /
+				    sender_stats.ss_zc_sends);
+			printf("%.2F KBytes/sec (copying rw)\n",
+			    ipc_rate(ts_copy, totalsize));
+		}
+		if (lflag) {
+			printf("receiver CPU: %.3F ms (blocking: %.3F ms)\n",
+			    timespec_ns(receiver_stats.rs_cputime) / 1000000,
+			    timespec_ns(stats_block.rs_cputime) / 1000000);
+			printf("receiver spin: %ld EAGAIN, %.3F ms (%.1F%% of "
+			    "CPU)\n", receiver_stats.rs_spin.sp_spins,
+			    receiver_stats.rs_spin.sp_spintime / 1000000.0,
+			    100.0 * receiver_stats.rs_spin.sp_spintime /
+			    timespec_ns(receiver_stats.rs_cputime));
+			if (lflag > 1)
+				printf("sender spin: %ld EAGAIN, %.3F ms "
+				    "(%.1F%% of CPU)\n",
+				    sender_stats.ss_spin.sp_spins,
+				    sender_stats.ss_spin.sp_spintime /
+				    1000000.0, 100.0 *
+				    sender_stats.ss_spin.sp_spintime /
+				    timespec_ns(sender_stats.ss_cputime));
+			if (Hflag)
+				printf("chunk latency p50: %.1F us (blocking)\n",
+				    latency_block / 1000);
+			printf("%.2F KBytes/sec (blocking)\n",
+			    ipc_rate(ts_block, totalsize));
+		}
+		if (ipc_type_datagram(ipc_type)) {
+			printf("messages: sent %ld, received %ld, lost %ld, "
+			    "reordered %ld\n", blockcount,
+			    receiver_stats.rs_messages,
+			    receiver_stats.rs_lost,
+			    receiver_stats.rs_reordered);
+			printf("%.2F messages/sec\n",
+			    receiver_stats.rs_messages /
+			    (timespec_ns(ts) / 1000000000));
+			printf("%.2F KBytes/sec\n", ipc_rate(ts,
+			    receiver_stats.rs_bytes));
+		} else
+			printf("%.2F KBytes/sec\n", ipc_rate(ts,
+			    duration_secs != 0 ? benchmark_bytes : totalsize));
+		if (Cflag) {
+			reads = receiver_stats.rs_reads;
+			writes = benchmark_mode == BENCHMARK_MODE_1THREAD ?
+			    receiver_stats.rs_writes : sender_stats.ss_writes;
+			receiver = calibrate_harness(0, reads);
+			sender = calibrate_harness(1, writes);
+			snprintf(counts, sizeof(counts), "%ld reads, %ld writes",
+			    reads, writes);
+			calibrate_print(ts, duration_secs != 0 ?
+			    benchmark_bytes : totalsize,
+			    benchmark_mode == BENCHMARK_MODE_1THREAD ?
+			    receiver + sender : max(receiver, sender), counts,
+			    Cflag > 1);
+		}
+		if (Hflag && benchmark_mode != BENCHMARK_MODE_CLIENT)
+			chunk_print(blockcount);
+		if (fanin_producers != 0)
+			fanin_print(benchmark_starttime, ts);
+		if (msgsize_count != 0)
+			msgsize_print(sender_stats.ss_class_ns);
+		if (payload_produce == PAYLOAD_CHECKSUM &&
+		    payload_consume == PAYLOAD_CHECKSUM)
+			printf("payload checksum: 0x%016jx (sender 0x%016jx: "
+			    "%s)\n", (uintmax_t)receiver_stats.rs_checksum,
+			    (uintmax_t)sender_stats.ss_checksum,
+			    receiver_stats.rs_checksum ==
+			    sender_stats.ss_checksum ? "match" : "MISMATCH");
+		else if (payload_produce == PAYLOAD_CHECKSUM)
+			printf("payload checksum: 0x%016jx (sender)\n",
+			    (uintmax_t)sender_stats.ss_checksum);
+		else if (payload_consume == PAYLOAD_CHECKSUM)
+			printf("payload checksum: 0x%016jx\n",
+			    (uintmax_t)receiver_stats.rs_checksum);
+		if (interval_ms != 0)
+			interval_print(benchmark_starttime, ts);
+		if (tcpinfo_interval != 0)
+			tcpinfo_print(benchmark_starttime, ts);
+#ifdef WITH_PERF
+		if (perf_nsets != 0)
+			perf_print(benchmark_mode == BENCHMARK_MODE_1THREAD ||
+			    benchmark_mode == BENCHMARK_MODE_SERVER ? NULL :
+			    &sender_stats.ss_perf,
+			    benchmark_mode == BENCHMARK_MODE_CLIENT ? NULL :
+			    &receiver_stats.rs_perf);
+		if (prof_event != NULL)
+			prof_report();
+#endif
+		if (Rflag)
+			osacct_print(&oa_before, &oa_after,
+			    duration_secs != 0 ? benchmark_bytes : totalsize, 0);
 	}
-	close(readfd);
-	close(writefd);
+	if (trace_path != NULL)
+		trace_write(ts, qflag);
+	if (readfd >= 0)
+		close(readfd);
+	if (writefd >= 0)
+		close(writefd);
 #ifdef WITH_PMC
 	if (benchmark_pmc != BENCHMARK_PMC_NONE)
 		pmc_teardown();
@@ -1021,16 +5735,50 @@ main(int argc, char *argv[])
 {
 	char *endp;
 	long l;
-	int ch;
+	int ch, i;
+
+	/*
+	 * Exit at once if we are a spawn-mode exec target.
+	 */
+	if (argc == 2 && strcmp(argv[1], SPAWN_EXIT_ARG) == 0)
+		exit(0);
+	spawn_self = argv[0];
 
 	buffersize = BUFFERSIZE;
 	totalsize = TOTALSIZE;
-	while ((ch = getopt(argc, argv, "Bb:i:p:P:qst:v"
-#ifdef WITH_PMC
+	while ((ch = getopt(argc, argv, "A:a:Bb:Cc:D:E:e:g:HI:i:k:lLM:m:n:O:p:P:qRr:sT:t:u:vWy:Z:"
+#ifdef F_SETPIPE_SZ
+	"z:"
+#endif
+#if defined(WITH_PMC) || defined(WITH_PERF)
 	"P:"
+#endif
+#ifdef WITH_PERF
+	"X:"
+#endif
+#ifdef WITH_IO_URING
+	"Q:S"
+#endif
+#ifdef SPLICE_F_GIFT
+	"f:"
+#endif
+#ifdef SO_ZEROCOPY
+	"N:"
 #endif
 	    )) != -1) {
 		switch (ch) {
+		case 'A':
+			tcp_addr_string = optarg;
+			break;
+
+		case 'a':
+			l = strtol(optarg, &endp, 10);
+			if (*optarg == '\0' || *endp != '\0' ||
+			    l <= 0 || l > CONNRATE_THREADS_MAX)
+				usage();
+			connrate_acceptors = l;
+			break;
+
 		case 'B':
 			Bflag++;
 			break;
@@ -1041,12 +5789,122 @@ main(int argc, char *argv[])
 				usage();
 			break;
 
+		case 'C':
+			Cflag++;
+			break;
+
+		case 'c':
+			l = strtol(optarg, &endp, 10);
+			if (*optarg == '\0' || *endp != '\0' ||
+			    l <= 0 || l > CONNRATE_THREADS_MAX)
+				usage();
+			connrate_clients = l;
+			break;
+
+		case 'E':
+			trace_path = optarg;
+			break;
+
+		case 'e':
+			benchmark_engine = benchmark_engine_from_string(optarg);
+			if (benchmark_engine == BENCHMARK_ENGINE_INVALID)
+				usage();
+			break;
+
+#ifdef SPLICE_F_GIFT
+		case 'f':
+			splice_sink = optarg;
+			break;
+#endif
+
+		case 'g':
+			payload_produce = payload_from_string(optarg);
+			if (payload_produce == PAYLOAD_INVALID)
+				usage();
+			break;
+
+		case 'H':
+			Hflag++;
+			break;
+
+		case 'I':
+			interval_ms = strtol(optarg, &endp, 10);
+			if (*optarg == '\0' || *endp != '\0' ||
+			    interval_ms <= 0 || interval_ms >= 1000000)
+				usage();
+			break;
+
 		case 'i':
 			ipc_type = ipc_type_from_string(optarg);
 			if (ipc_type == BENCHMARK_IPC_INVALID)
 				usage();
 			break;
 
+		case 'D':
+			if (msgsize_parse(optarg) < 0)
+				usage();
+			break;
+
+		case 'k':
+			l = strtol(optarg, &endp, 10);
+			if (*optarg == '\0' || *endp != '\0' ||
+			    l <= 0 || l > FANIN_PRODUCERS_MAX)
+				usage();
+			fanin_producers = l;
+			break;
+
+		case 'l':
+			lflag++;
+			break;
+
+		case 'L':
+			Lflag++;
+			break;
+
+		case 'M':
+			if ((endp = strchr(optarg, ':')) != NULL) {
+				*endp = '\0';
+				spawn_target = endp + 1;
+				if (*spawn_target == '\0')
+					usage();
+			}
+			spawn_method = spawn_method_from_string(optarg);
+			if (spawn_method == SPAWN_METHOD_INVALID)
+				usage();
+			if (spawn_target != NULL &&
+			    !spawn_method_exec(spawn_method))
+				usage();
+			break;
+
+		case 'm':
+			l = strtol(optarg, &endp, 10);
+			if (*optarg == '\0' || *endp != '\0' ||
+			    l <= 0 || l > DGRAM_BATCH_MAX)
+				usage();
+			dgram_batch = l;
+			break;
+
+		case 'n':
+			iterations = strtol(optarg, &endp, 10);
+			if (*optarg == '\0' || *endp != '\0' ||
+			    iterations <= 0)
+				usage();
+			break;
+
+#ifdef SO_ZEROCOPY
+		case 'N':
+			l = strtol(optarg, &endp, 10);
+			if (*optarg == '\0' || *endp != '\0' ||
+			    l <= 0 || l > ZEROCOPY_NBUFS_MAX)
+				usage();
+			zerocopy_nbufs = l;
+			break;
+#endif
+
+		case 'O':
+			sockopt_parse(optarg);
+			break;
+
 		case 'p':
 			l = strtol(optarg, &endp, 10);
 			if (*optarg == '\0' || *endp != '\0' ||
@@ -1062,25 +5920,99 @@ main(int argc, char *argv[])
 				usage();
 			break;
 #endif
+#ifdef WITH_PERF
+		case 'P':
+			if (perf_parse(optarg) < 0)
+				usage();
+			break;
+#endif
 
 		case 'q':
 			qflag++;
 			break;
 
+		case 'R':
+			Rflag++;
+			break;
+
+		case 'r':
+			spawn_rss = strtol(optarg, &endp, 10);
+			if (*optarg == '\0' || *endp != '\0' || spawn_rss <= 0)
+				usage();
+			break;
+
+#ifdef WITH_IO_URING
+		case 'Q':
+			l = strtol(optarg, &endp, 10);
+			if (*optarg == '\0' || *endp != '\0' ||
+			    l <= 0 || l > URING_QDEPTH_MAX)
+				usage();
+			uring_qdepth = l;
+			break;
+
+		case 'S':
+			Sflag++;
+			break;
+#endif
+
 		case 's':
 			sflag++;
 			break;
 
+		case 'T':
+			duration_secs = strtol(optarg, &endp, 10);
+			if (*optarg == '\0' || *endp != '\0' ||
+			    duration_secs <= 0)
+				usage();
+			break;
+
 		case 't':
 			totalsize = strtol(optarg, &endp, 10);
 			if (*optarg == '\0' || *endp != '\0' || totalsize <= 0)
 				usage();
 			break;
 
+		case 'u':
+			payload_consume = payload_from_string(optarg);
+			if (payload_consume == PAYLOAD_INVALID)
+				usage();
+			break;
+
 		case 'v':
 			vflag++;
 			break;
 
+		case 'W':
+			Wflag++;
+			break;
+
+#ifdef WITH_PERF
+		case 'X':
+			if (prof_parse(optarg) < 0)
+				usage();
+			break;
+#endif
+
+		case 'y':
+			tcpinfo_interval = strtol(optarg, &endp, 10);
+			if (*optarg == '\0' || *endp != '\0' ||
+			    tcpinfo_interval <= 0 || tcpinfo_interval >= 1000000)
+				usage();
+			break;
+
+		case 'Z':
+			scenario_select(optarg);
+			break;
+
+#ifdef F_SETPIPE_SZ
+		case 'z':
+			pipe_capacity = strtol(optarg, &endp, 10);
+			if (*optarg == '\0' || *endp != '\0' ||
+			    pipe_capacity <= 0 || pipe_capacity > INT_MAX)
+				usage();
+			break;
+#endif
+
 		case '?':
 		default:
 			usage();
@@ -1088,12 +6020,7 @@ main(int argc, char *argv[])
 	}
 	argc -= optind;
 	argv += optind;
-
-	/*
-	 * A little argument-specific validation.
-	 */
-	if (sflag && (ipc_type != BENCHMARK_IPC_LOCAL_SOCKET) &&
-	    (ipc_type != BENCHMARK_IPC_TCP_SOCKET))
+	if (inet_pton(AF_INET, tcp_addr_string, &tcp_addr) != 1)
 		usage();
 
 	/*
@@ -1105,6 +6032,277 @@ main(int argc, char *argv[])
 	benchmark_mode = benchmark_mode_from_string(argv[0]);
 	if (benchmark_mode == BENCHMARK_MODE_INVALID)
 		usage();
+
+	/*
+	 * A little argument-specific validation.
+	 */
+	if (sflag && (ipc_type != BENCHMARK_IPC_LOCAL_SOCKET) &&
+	    (ipc_type != BENCHMARK_IPC_TCP_SOCKET) &&
+	    !ipc_type_datagram(ipc_type))
+		usage();
+
+	if (dgram_batch != DGRAM_BATCH_DEFAULT && !ipc_type_datagram(ipc_type))
+		usage();
+
+	/*
+	 * Socket options are supported only for TCP, and may not be mixed
+	 * with -s.  Only with -W, or in scenario mode, may more than one value
+	 * be given for each.
+	 */
+	for (i = 0; i < SOCKOPT_MAX; i++) {
+		if (sockopt_values[i].sv_count == 0)
+			continue;
+		if (ipc_type != BENCHMARK_IPC_TCP_SOCKET)
+			usage();
+		if (sockopt_values[i].sv_count > 1 && !Wflag &&
+		    benchmark_mode != BENCHMARK_MODE_SCENARIO)
+			usage();
+		sockopt_current[i] = sockopt_values[i].sv_values[0];
+	}
+	if (sflag && (sockopt_current[SOCKOPT_SNDBUF] != NULL ||
+	    sockopt_current[SOCKOPT_RCVBUF] != NULL))
+		usage();
+#ifdef F_SETPIPE_SZ
+	if (Wflag && ipc_type != BENCHMARK_IPC_TCP_SOCKET &&
+	    ipc_type != BENCHMARK_IPC_PIPE)
+#else
+	if (Wflag && ipc_type != BENCHMARK_IPC_TCP_SOCKET)
+#endif
+		usage();
+#ifdef F_SETPIPE_SZ
+	if (pipe_capacity != 0 && (ipc_type != BENCHMARK_IPC_PIPE || Wflag))
+		usage();
+#endif
+
+	/*
+	 * The connection-rate benchmark is TCP-only, and moves no bulk data,
+	 * so has no use for alternative engines or sweeps.  Its own options
+	 * are meaningless in other modes.
+	 */
+	if (benchmark_mode == BENCHMARK_MODE_CONNRATE) {
+		if (ipc_type != BENCHMARK_IPC_TCP_SOCKET ||
+		    benchmark_engine != BENCHMARK_ENGINE_RW || Wflag || sflag)
+			usage();
+	} else if (benchmark_mode == BENCHMARK_MODE_SERVER ||
+	    benchmark_mode == BENCHMARK_MODE_CLIENT) {
+		/*
+		 * With one endpoint remote, there is no copying baseline to
+		 * compare MSG_ZEROCOPY against, and -s cannot reach the far
+		 * socket; use -O sndbuf/rcvbuf instead.
+		 */
+		if (ipc_type != BENCHMARK_IPC_TCP_SOCKET || Wflag || sflag ||
+		    benchmark_engine_zerocopy(benchmark_engine))
+			usage();
+	} else if (benchmark_mode == BENCHMARK_MODE_SCENARIO) {
+#ifndef __linux__
+		usage();
+#endif
+		if (ipc_type != BENCHMARK_IPC_TCP_SOCKET ||
+		    benchmark_engine_zerocopy(benchmark_engine))
+			usage();
+	} else if (benchmark_mode == BENCHMARK_MODE_SPAWN) {
+		/*
+		 * Creation moves no data, so uses no IPC object or engine,
+		 * and has nothing to sweep or count per buffer.
+		 */
+		if (ipc_type != BENCHMARK_IPC_DEFAULT ||
+		    benchmark_engine != BENCHMARK_ENGINE_RW || Wflag || sflag)
+			usage();
+#ifdef F_SETPIPE_SZ
+		if (pipe_capacity != 0)
+			usage();
+#endif
+#ifdef WITH_PERF
+		if (perf_nsets != 0)
+			usage();
+#endif
+	}
+	if (scenario_selected != 0 && benchmark_mode != BENCHMARK_MODE_SCENARIO)
+		usage();
+	if (benchmark_mode != BENCHMARK_MODE_SPAWN &&
+	    (spawn_method != SPAWN_METHOD_DEFAULT || spawn_target != NULL ||
+	    spawn_rss != 0))
+		usage();
+
+	/*
+	 * Chunk headers are written and parsed only by the read()/write()
+	 * stream loops of a single run with separate sender and receiver.
+	 */
+	if (Hflag && (ipc_type_datagram(ipc_type) ||
+	    benchmark_engine != BENCHMARK_ENGINE_RW || Wflag ||
+	    (benchmark_mode != BENCHMARK_MODE_2THREAD &&
+	    benchmark_mode != BENCHMARK_MODE_2PROC &&
+	    benchmark_mode != BENCHMARK_MODE_SERVER &&
+	    benchmark_mode != BENCHMARK_MODE_CLIENT)))
+		usage();
+
+	/*
+	 * Likewise payload production and consumption, except that they may
+	 * be swept; each needs its own end of the connection.
+	 */
+	if ((payload_produce != PAYLOAD_NONE ||
+	    payload_consume != PAYLOAD_NONE) &&
+	    (ipc_type_datagram(ipc_type) ||
+	    benchmark_engine != BENCHMARK_ENGINE_RW ||
+	    benchmark_mode == BENCHMARK_MODE_1THREAD ||
+	    benchmark_mode == BENCHMARK_MODE_CONNRATE ||
+	    benchmark_mode == BENCHMARK_MODE_SPAWN))
+		usage();
+	if ((payload_produce != PAYLOAD_NONE &&
+	    benchmark_mode == BENCHMARK_MODE_SERVER) ||
+	    (payload_consume != PAYLOAD_NONE &&
+	    benchmark_mode == BENCHMARK_MODE_CLIENT))
+		usage();
+
+	/*
+	 * Busy polling replaces the blocking stream loops, and is compared
+	 * with a blocking run over a fresh IPC object.
+	 */
+	if (lflag && (ipc_type_datagram(ipc_type) ||
+	    benchmark_engine != BENCHMARK_ENGINE_RW || Wflag ||
+	    (benchmark_mode != BENCHMARK_MODE_2THREAD &&
+	    benchmark_mode != BENCHMARK_MODE_2PROC)))
+		usage();
+
+	/*
+	 * Fan-in producers tag whole records in the stream loops of a single
+	 * run, overwriting anything -g or -H would put there.
+	 */
+	if (fanin_producers != 0 && (ipc_type_datagram(ipc_type) ||
+	    benchmark_engine != BENCHMARK_ENGINE_RW || Wflag || Hflag ||
+	    payload_produce != PAYLOAD_NONE ||
+	    (benchmark_mode != BENCHMARK_MODE_2THREAD &&
+	    benchmark_mode != BENCHMARK_MODE_2PROC)))
+		usage();
+
+	/*
+	 * Message sizes replace the sender's stream loop, so exclude anything
+	 * that relies on whole buffers, and a checksum that the receiver
+	 * could not reproduce from its buffersize reads.
+	 */
+	if (msgsize_dist != MSGSIZE_NONE && (ipc_type_datagram(ipc_type) ||
+	    benchmark_engine != BENCHMARK_ENGINE_RW || Wflag || Hflag ||
+	    fanin_producers != 0 || payload_produce == PAYLOAD_CHECKSUM ||
+	    (benchmark_mode != BENCHMARK_MODE_2THREAD &&
+	    benchmark_mode != BENCHMARK_MODE_2PROC &&
+	    benchmark_mode != BENCHMARK_MODE_CLIENT)))
+		usage();
+
+#ifdef WITH_PERF
+	/*
+	 * Profiles cover the one timed run of a benchmark.
+	 */
+	if (prof_event != NULL && (Wflag ||
+	    benchmark_mode == BENCHMARK_MODE_CONNRATE ||
+	    benchmark_mode == BENCHMARK_MODE_SCENARIO ||
+	    benchmark_mode == BENCHMARK_MODE_SPAWN))
+		usage();
+#endif
+
+	/*
+	 * Resource accounting brackets a single run.
+	 */
+	if (Rflag && (Wflag || benchmark_mode == BENCHMARK_MODE_CONNRATE ||
+	    benchmark_mode == BENCHMARK_MODE_SCENARIO ||
+	    benchmark_mode == BENCHMARK_MODE_SPAWN))
+		usage();
+
+	/*
+	 * Duration-limited runs replace the bounds of the read()/write()
+	 * stream loops of a single run, and so exclude anything sized by
+	 * block count.  Interval sampling watches the receiver.
+	 */
+	if (duration_secs != 0 && (ipc_type_datagram(ipc_type) ||
+	    benchmark_engine != BENCHMARK_ENGINE_RW || Wflag || Hflag ||
+	    lflag || fanin_producers != 0 || msgsize_dist != MSGSIZE_NONE ||
+	    (benchmark_mode != BENCHMARK_MODE_1THREAD &&
+	    benchmark_mode != BENCHMARK_MODE_2THREAD &&
+	    benchmark_mode != BENCHMARK_MODE_2PROC)))
+		usage();
+	if (interval_ms != 0 && (ipc_type_datagram(ipc_type) ||
+	    benchmark_engine != BENCHMARK_ENGINE_RW || Wflag || lflag ||
+	    (benchmark_mode != BENCHMARK_MODE_1THREAD &&
+	    benchmark_mode != BENCHMARK_MODE_2THREAD &&
+	    benchmark_mode != BENCHMARK_MODE_2PROC)))
+		usage();
+
+	/*
+	 * Calibration models the read()/write() stream loops of a single run;
+	 * a zero-length write() would send an empty datagram.
+	 */
+	if (Cflag && (ipc_type_datagram(ipc_type) ||
+	    benchmark_engine != BENCHMARK_ENGINE_RW || Wflag ||
+	    (benchmark_mode != BENCHMARK_MODE_1THREAD &&
+	    benchmark_mode != BENCHMARK_MODE_2THREAD &&
+	    benchmark_mode != BENCHMARK_MODE_2PROC)))
+		usage();
+
+	/*
+	 * Tracing instruments only the read()/write() stream loops, and keeps
+	 * the events of a single run.
+	 */
+	if (trace_path != NULL && (ipc_type_datagram(ipc_type) ||
+	    benchmark_engine != BENCHMARK_ENGINE_RW || Wflag ||
+	    (benchmark_mode != BENCHMARK_MODE_1THREAD &&
+	    benchmark_mode != BENCHMARK_MODE_2THREAD &&
+	    benchmark_mode != BENCHMARK_MODE_2PROC)))
+		usage();
+
+	/*
+	 * TCP_INFO sampling needs both endpoints, and a single run.
+	 */
+	if (tcpinfo_interval != 0 && (ipc_type != BENCHMARK_IPC_TCP_SOCKET ||
+	    Wflag || (benchmark_mode != BENCHMARK_MODE_1THREAD &&
+	    benchmark_mode != BENCHMARK_MODE_2THREAD &&
+	    benchmark_mode != BENCHMARK_MODE_2PROC)))
+		usage();
+	if (benchmark_mode != BENCHMARK_MODE_CONNRATE &&
+	    (Lflag || connrate_acceptors != CONNRATE_ACCEPTORS_DEFAULT ||
+	    connrate_clients != CONNRATE_CLIENTS_DEFAULT))
+		usage();
+	if (iterations != ITERATIONS_DEFAULT &&
+	    benchmark_mode != BENCHMARK_MODE_CONNRATE &&
+	    benchmark_mode != BENCHMARK_MODE_SPAWN)
+		usage();
+
+	/*
+	 * Alternative engines replace the blocking sender and receiver loops,
+	 * so have no meaning in the interleaved 1thread mode.  Splicing is
+	 * possible only to and from pipes, and MSG_ZEROCOPY only with TCP.
+	 */
+	if (benchmark_engine != BENCHMARK_ENGINE_RW &&
+	    benchmark_mode == BENCHMARK_MODE_1THREAD)
+		usage();
+
+	/*
+	 * Message-oriented IPC types are supported only by the read()/write()
+	 * engine, and not in 1thread mode, where a dropped UDP message could
+	 * leave us waiting forever.
+	 */
+	if (ipc_type_datagram(ipc_type) &&
+	    (benchmark_mode == BENCHMARK_MODE_1THREAD ||
+	    benchmark_engine != BENCHMARK_ENGINE_RW))
+		usage();
+#ifdef WITH_IO_URING
+	if (Sflag && benchmark_engine != BENCHMARK_ENGINE_URING)
+		usage();
+#endif
+#ifdef SPLICE_F_GIFT
+	if ((benchmark_engine == BENCHMARK_ENGINE_VMSPLICE ||
+	    benchmark_engine == BENCHMARK_ENGINE_SPLICE) &&
+	    ipc_type != BENCHMARK_IPC_PIPE)
+		usage();
+	if (splice_sink != NULL &&
+	    benchmark_engine != BENCHMARK_ENGINE_SPLICE)
+		usage();
+	if (splice_sink == NULL)
+		splice_sink = SPLICE_SINK_DEFAULT;
+#endif
+#ifdef SO_ZEROCOPY
+	if (benchmark_engine == BENCHMARK_ENGINE_ZEROCOPY &&
+	    ipc_type != BENCHMARK_IPC_TCP_SOCKET)
+		usage();
+#endif
 	ipc();
 	exit(0);
 }
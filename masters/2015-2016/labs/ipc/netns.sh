@@ -0,0 +1,98 @@
+#!/bin/sh
+#
+# Create (or destroy) a pair of network namespaces joined by a veth pair, so
+# that the ipc benchmark's server and client modes can exchange data over a
+# real network device path (GRO/GSO, veth queues) rather than loopback, all
+# on one machine.  Must be run as root on Linux.
+#
+#	netns.sh up		Create namespaces, veth pair and addresses
+#	netns.sh down		Destroy them
+#	netns.sh run args...	Run "ipc args... server" in the server
+#				namespace and "ipc args... client" in the
+#				client namespace, once the server listens on
+#				the port given by any -p in args
+#
+# Override IPC to select a different binary (default: ./ipc-static).
+#
+
+IPC=${IPC:-./ipc-static}
+SERVER_NS=ipc-server
+CLIENT_NS=ipc-client
+SERVER_IF=veth-ipc0
+CLIENT_IF=veth-ipc1
+SERVER_ADDR=10.41.0.1
+CLIENT_ADDR=10.41.0.2
+
+up() {
+	ip netns add ${SERVER_NS} || exit 1
+	ip netns add ${CLIENT_NS} || exit 1
+	ip link add ${SERVER_IF} netns ${SERVER_NS} type veth \
+	    peer name ${CLIENT_IF} netns ${CLIENT_NS} || exit 1
+	ip -n ${SERVER_NS} addr add ${SERVER_ADDR}/24 dev ${SERVER_IF}
+	ip -n ${CLIENT_NS} addr add ${CLIENT_ADDR}/24 dev ${CLIENT_IF}
+	ip -n ${SERVER_NS} link set lo up
+	ip -n ${CLIENT_NS} link set lo up
+	ip -n ${SERVER_NS} link set ${SERVER_IF} up
+	ip -n ${CLIENT_NS} link set ${CLIENT_IF} up
+}
+
+down() {
+	ip netns del ${CLIENT_NS} 2>/dev/null
+	ip netns del ${SERVER_NS} 2>/dev/null
+}
+
+# The TCP port that ipc will use: the last -p in its arguments, as getopt()
+# would have it, or ipc's default.
+port() {
+	port=10141
+	while [ $# -gt 0 ]; do
+		case "$1" in
+		-p)
+			port=$2
+			shift
+			;;
+		-p*)
+			port=${1#-p}
+			;;
+		esac
+		shift
+	done
+	echo ${port}
+}
+
+run() {
+	port=$(port "$@")
+	ip netns exec ${SERVER_NS} ${IPC} -i tcp -A ${SERVER_ADDR} "$@" \
+	    server &
+	server=$!
+
+	# Wait for the server to start listening before connecting.
+	while ! ip netns exec ${SERVER_NS} ss -Hltn "sport = :${port}" |
+	    grep -q .; do
+		if ! kill -0 ${server} 2>/dev/null; then
+			wait ${server}
+			exit
+		fi
+		sleep 0.1
+	done
+	ip netns exec ${CLIENT_NS} ${IPC} -i tcp -A ${SERVER_ADDR} "$@" \
+	    client
+	wait ${server}
+}
+
+case "$1" in
+up)
+	up
+	;;
+down)
+	down
+	;;
+run)
+	shift
+	run "$@"
+	;;
+*)
+	echo "usage: $0 up | down | run [ipc options]" >&2
+	exit 64
+	;;
+esac
@@ -0,0 +1,1248 @@
+/*-
+ * Copyright (c) 2026 The io and ipc benchmark contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <sys/types.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#ifndef __linux__
+#include <sys/sysctl.h>
+#endif
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sysexits.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * L41: Benchmark suite driver
+ *
+ * Runs the io and ipc benchmarks as described by a workload file, checks
+ * that the machine is quiet enough to measure on, and appends each trial's
+ * results, with a fingerprint of the environment, to a results file.  If a
+ * baseline is named, each workload's results are compared with that
+ * baseline's, and the exit status reports whether any regressed.
+ *
+ * With -A, instead compares two builds, such as io-static and io-dynamic:
+ * pairs of trials alternate the two in random order with the same
+ * arguments, so that drift in clock rate, temperature or cache state falls
+ * on both alike, and the paired differences are reported.
+ */
+
+#define	RESULTS_DEFAULT		"suite-results.tsv"
+#define	THRESHOLD_DEFAULT	5.0	/* Percent. */
+#define	ALPHA_DEFAULT		0.05
+#define	WARMUP_DEFAULT		1
+#define	REPETITIONS_DEFAULT	5
+#define	PAIRS_DEFAULT		10
+
+#define	EXIT_REGRESSION		1
+
+static unsigned int Aflag;	/* A/B comparison */
+static unsigned int Iflag;	/* isolation checks are fatal */
+static unsigned int qflag;	/* quiet */
+static unsigned int vflag;	/* verbose */
+
+static const char *results_path = RESULTS_DEFAULT;
+static const char *baseline_label;
+static const char *run_label;
+static double threshold = THRESHOLD_DEFAULT;
+static double alpha = ALPHA_DEFAULT;
+static long ab_pairs;
+static long ab_warmup = -1;
+static long ab_seed;
+
+/*
+ * Metrics scraped from the benchmarks' output.  Throughput is the line that
+ * is just "<number> KBytes/sec": other rates, such as ipc's copying or
+ * blocking comparison runs and -CC's harness-subtracted figure, carry a
+ * parenthesised qualifier, and may be printed before it.  The latency
+ * percentiles are present only with ipc -H.
+ */
+#define	METRIC_THROUGHPUT	0
+#define	METRIC_LATENCY_P50	1
+#define	METRIC_LATENCY_P99	2
+#define	METRIC_COUNT		3
+
+static const struct metric_desc {
+	const char	*md_name;
+	const char	*md_unit;
+	int		 md_higher_better;
+} metric_desc[METRIC_COUNT] = {
+	[METRIC_THROUGHPUT] = { "throughput", "KBytes/sec", 1 },
+	[METRIC_LATENCY_P50] = { "latency_p50", "us", 0 },
+	[METRIC_LATENCY_P99] = { "latency_p99", "us", 0 },
+};
+
+struct samples {
+	double	*s_values;
+	long	 s_count;
+};
+
+/*
+ * One line of the workload file: either a setup command, run once, or a
+ * measured workload.
+ */
+struct workload {
+	char		*wl_name;
+	char		**wl_argv;	/* NULL-terminated. */
+	int		 wl_setup;
+	long		 wl_warmup;
+	long		 wl_repetitions;
+	struct samples	 wl_samples[METRIC_COUNT];
+	struct samples	 wl_baseline[METRIC_COUNT];
+};
+
+static struct workload *workloads;
+static long nworkloads;
+
+/*
+ * The environment the results were measured in, recorded with each one so
+ * that results from different machines or configurations are not compared
+ * unawares.
+ */
+#define	FINGERPRINT_LEN		128
+
+struct fingerprint {
+	char	fp_kernel[FINGERPRINT_LEN];
+	char	fp_cpu[FINGERPRINT_LEN];
+	char	fp_governor[FINGERPRINT_LEN];
+	char	fp_commit[FINGERPRINT_LEN];
+};
+
+static struct fingerprint fingerprint;
+
+/*
+ * Fields of a results file line, tab-separated, one line per metric per
+ * trial.
+ */
+#define	RESULTS_RUN		0
+#define	RESULTS_LABEL		1
+#define	RESULTS_COMMIT		2
+#define	RESULTS_KERNEL		3
+#define	RESULTS_CPU		4
+#define	RESULTS_GOVERNOR	5
+#define	RESULTS_WORKLOAD	6
+#define	RESULTS_METRIC		7
+#define	RESULTS_VALUE		8
+#define	RESULTS_FIELDS		9
+
+static void
+usage(void)
+{
+
+	fprintf(stderr,
+	    "%s [-Iqv] [-a alpha] [-b baseline] [-l label] [-o results]\n"
+	    "    [-t percent] workloadfile\n"
+	    "%s -A [-Iqv] [-a alpha] [-n pairs] [-s seed] [-w warmup]\n"
+	    "    program-a program-b [arg ...]\n", PROGNAME, PROGNAME);
+	fprintf(stderr,
+  "\n"
+  "Optional flags:\n"
+  "    -A              Compare two programs given the same arguments, in\n"
+  "                    pairs of trials run in random order\n"
+  "    -a alpha        Set the significance level (default: 0.05)\n"
+  "    -b baseline     Compare with the results labelled baseline, and exit\n"
+  "                    with status 1 if any regressed\n"
+  "    -I              Make the CPU isolation checks fatal\n"
+  "    -l label        Label this run's results (default: the git commit\n"
+  "                    of the workload file's tree; required outside one)\n"
+  "    -n pairs        Set -A trial pairs (default: 10)\n"
+  "    -o results      Append results to this file\n"
+  "                    (default: " RESULTS_DEFAULT ")\n"
+  "    -q              Just report regressions, don't print stuff out\n"
+  "    -s seed         Seed the -A trial order (default: from the time)\n"
+  "    -t percent      Regression threshold (default: 5)\n"
+  "    -v              Show each trial's result\n"
+  "    -w warmup       Set -A unmeasured trials of each program (default: 1)\n"
+  "\n"
+  "Workload file lines (# starts a comment):\n"
+  "    setup command [arg ...]      Run command once, when reached\n"
+  "    warmup count                 Unmeasured trials before each later\n"
+  "                                 workload (default: 1)\n"
+  "    repetitions count            Measured trials of each later workload\n"
+  "                                 (default: 5)\n"
+  "    run name command [arg ...]   A workload: an io or ipc command line\n"
+  "\n"
+  "A workload regresses when its mean throughput (or latency) is worse\n"
+  "than the baseline's by more than the threshold, with significance alpha\n"
+  "under a one-sided Welch's t-test.\n"
+  "\n"
+  "With -A, the change from program-a to program-b is the mean of the\n"
+  "pairs' percentage differences, with its 1 - alpha confidence interval;\n"
+  "it is significant when the interval excludes zero.\n");
+	exit(EX_USAGE);
+}
+
+/*
+ * Copy 'value' into a fingerprint field, less any trailing newline, with
+ * tabs and newlines replaced so that it remains a single results field.
+ */
+static void
+fingerprint_set(char *field, const char *value)
+{
+	char *cp;
+
+	snprintf(field, FINGERPRINT_LEN, "%s", value);
+	field[strcspn(field, "\n")] = '\0';
+	for (cp = field; *cp != '\0'; cp++) {
+		if (*cp == '\t')
+			*cp = ' ';
+	}
+	if (field[0] == '\0')
+		snprintf(field, FINGERPRINT_LEN, "-");
+}
+
+/*
+ * First line of a command's output, or "" if it printed nothing or failed.
+ */
+static void
+fingerprint_command(char *field, const char *command)
+{
+	char line[FINGERPRINT_LEN];
+	FILE *fp;
+
+	line[0] = '\0';
+	fp = popen(command, "r");
+	if (fp != NULL) {
+		if (fgets(line, sizeof(line), fp) == NULL)
+			line[0] = '\0';
+		if (pclose(fp) != 0)
+			line[0] = '\0';
+	}
+	fingerprint_set(field, line);
+}
+
+/*
+ * 'path' is the workload file, or NULL if there is none.
+ */
+static void
+fingerprint_collect(const char *path)
+{
+	struct fingerprint *fpp = &fingerprint;
+	struct utsname uts;
+	char value[3 * FINGERPRINT_LEN], dirty[FINGERPRINT_LEN];
+	char dir[PATH_MAX];
+	int cwd;
+#ifdef __linux__
+	char line[256];
+	FILE *fp;
+	char *cp;
+#else
+	size_t len;
+#endif
+
+	if (uname(&uts) < 0)
+		err(EX_OSERR, "FAIL: uname");
+	snprintf(value, sizeof(value), "%s %s %s", uts.sysname, uts.release,
+	    uts.machine);
+	fingerprint_set(fpp->fp_kernel, value);
+
+	value[0] = '\0';
+#ifdef __linux__
+	fp = fopen("/proc/cpuinfo", "r");
+	if (fp != NULL) {
+		while (fgets(line, sizeof(line), fp) != NULL) {
+			if (strncmp(line, "model name", 10) != 0)
+				continue;
+			cp = strchr(line, ':');
+			if (cp != NULL) {
+				snprintf(value, sizeof(value), "%s",
+				    cp + strspn(cp, ": \t"));
+				break;
+			}
+		}
+		fclose(fp);
+	}
+	fingerprint_set(fpp->fp_cpu, value);
+
+	value[0] = '\0';
+	fp = fopen("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor",
+	    "r");
+	if (fp != NULL) {
+		if (fgets(value, sizeof(value), fp) == NULL)
+			value[0] = '\0';
+		fclose(fp);
+	}
+	fingerprint_set(fpp->fp_governor, value);
+#else
+	len = sizeof(value);
+	if (sysctlbyname("hw.model", value, &len, NULL, 0) < 0)
+		value[0] = '\0';
+	fingerprint_set(fpp->fp_cpu, value);
+	fingerprint_set(fpp->fp_governor, "");
+#endif
+
+	/*
+	 * The commit of the tree the benchmarks were built from, taken to be
+	 * the one holding the workload file, whose relative paths name them,
+	 * rather than wherever we were run from; marked if it has uncommitted
+	 * changes.
+	 */
+	value[0] = '\0';
+	if (path != NULL) {
+		cwd = open(".", O_RDONLY);
+		if (cwd < 0)
+			err(EX_OSERR, "FAIL: open .");
+		snprintf(dir, sizeof(dir), "%s", path);
+		if (chdir(dirname(dir)) < 0)
+			err(EX_NOINPUT, "FAIL: %s", dir);
+		fingerprint_command(value,
+		    "git rev-parse --short HEAD 2>/dev/null");
+		if (strcmp(value, "-") != 0) {
+			fingerprint_command(dirty, "git status --porcelain "
+			    "--untracked-files=no 2>/dev/null");
+			if (strcmp(dirty, "-") != 0)
+				strncat(value, "-dirty", sizeof(value) -
+				    strlen(value) - 1);
+		}
+		if (fchdir(cwd) < 0)
+			err(EX_OSERR, "FAIL: fchdir");
+		close(cwd);
+	}
+	fingerprint_set(fpp->fp_commit, value);
+}
+
+#ifdef __linux__
+/*
+ * First line of a sysfs file, or NULL if it can't be read.
+ */
+static char *
+sysfs_read(const char *path, char *buf, size_t len)
+{
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return (NULL);
+	if (fgets(buf, len, fp) == NULL) {
+		fclose(fp);
+		return (NULL);
+	}
+	fclose(fp);
+	buf[strcspn(buf, "\n")] = '\0';
+	return (buf);
+}
+
+/*
+ * Parse a kernel CPU list ("0-3,6") into a CPU set.
+ */
+static void
+cpulist_parse(const char *list, cpu_set_t *setp)
+{
+	char *endp;
+	long lo, hi;
+
+	CPU_ZERO(setp);
+	while (*list != '\0') {
+		lo = hi = strtol(list, &endp, 10);
+		if (endp == list)
+			break;
+		if (*endp == '-')
+			hi = strtol(endp + 1, &endp, 10);
+		for (; lo <= hi && lo < CPU_SETSIZE; lo++)
+			CPU_SET(lo, setp);
+		list = endp + (*endp == ',');
+	}
+}
+#endif
+
+/*
+ * Check that the machine is fit to benchmark on: idle, with fixed clock
+ * frequencies, and with our CPUs isolated from the scheduler's other work.
+ * Each failing check is reported; returns the number that failed.
+ */
+static int
+isolation_check(void)
+{
+	double load[3];
+	int problems;
+#ifdef __linux__
+	char path[128], buf[256];
+	cpu_set_t affinity, isolated;
+	int cpu;
+#endif
+
+	problems = 0;
+	if (getloadavg(load, 3) == 3 && load[0] > 0.5) {
+		warnx("load average is %.2f; the machine is not idle", load[0]);
+		problems++;
+	}
+#ifdef __linux__
+	if (sched_getaffinity(0, sizeof(affinity), &affinity) < 0)
+		err(EX_OSERR, "FAIL: sched_getaffinity");
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (!CPU_ISSET(cpu, &affinity))
+			continue;
+		snprintf(path, sizeof(path),
+		    "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor",
+		    cpu);
+		if (sysfs_read(path, buf, sizeof(buf)) != NULL &&
+		    strcmp(buf, "performance") != 0) {
+			warnx("cpu%d: scaling governor is \"%s\", not "
+			    "\"performance\"", cpu, buf);
+			problems++;
+			break;
+		}
+	}
+	if ((sysfs_read("/sys/devices/system/cpu/intel_pstate/no_turbo", buf,
+	    sizeof(buf)) != NULL && strcmp(buf, "0") == 0) ||
+	    (sysfs_read("/sys/devices/system/cpu/cpufreq/boost", buf,
+	    sizeof(buf)) != NULL && strcmp(buf, "1") == 0)) {
+		warnx("turbo boost is enabled; clock rates will vary");
+		problems++;
+	}
+	if (sysfs_read("/sys/devices/system/cpu/isolated", buf,
+	    sizeof(buf)) == NULL || buf[0] == '\0') {
+		warnx("no CPUs are isolated (isolcpus=); benchmarks share "
+		    "CPUs with the rest of the system");
+		problems++;
+	} else {
+		cpulist_parse(buf, &isolated);
+		CPU_AND(&isolated, &isolated, &affinity);
+		if (!CPU_EQUAL(&isolated, &affinity)) {
+			warnx("not confined to the isolated CPUs (%s); run "
+			    "under taskset -c %s", buf, buf);
+			problems++;
+		}
+	}
+#endif
+	return (problems);
+}
+
+static void
+samples_add(struct samples *sp, double value)
+{
+
+	sp->s_values = realloc(sp->s_values,
+	    (sp->s_count + 1) * sizeof(*sp->s_values));
+	if (sp->s_values == NULL)
+		err(EX_OSERR, "FAIL: realloc");
+	sp->s_values[sp->s_count++] = value;
+}
+
+static int
+double_compare(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x < y ? -1 : x > y);
+}
+
+static void
+samples_stats(const struct samples *sp, double *meanp, double *varp)
+{
+	double mean, var;
+	long i;
+
+	mean = 0;
+	for (i = 0; i < sp->s_count; i++)
+		mean += sp->s_values[i];
+	mean /= sp->s_count;
+	var = 0;
+	for (i = 0; i < sp->s_count; i++)
+		var += (sp->s_values[i] - mean) * (sp->s_values[i] - mean);
+	*meanp = mean;
+	*varp = sp->s_count > 1 ? var / (sp->s_count - 1) : 0;
+}
+
+/*
+ * Continued fraction for the regularised incomplete beta function, by the
+ * modified Lentz method.
+ */
+static double
+incbeta_cf(double a, double b, double x)
+{
+	double c, d, del, h, m2, aa;
+	int m;
+
+	c = 1;
+	d = 1 - (a + b) * x / (a + 1);
+	if (fabs(d) < 1e-300)
+		d = 1e-300;
+	d = 1 / d;
+	h = d;
+	for (m = 1; m <= 300; m++) {
+		m2 = 2 * m;
+		aa = m * (b - m) * x / ((a + m2 - 1) * (a + m2));
+		d = 1 + aa * d;
+		if (fabs(d) < 1e-300)
+			d = 1e-300;
+		c = 1 + aa / c;
+		if (fabs(c) < 1e-300)
+			c = 1e-300;
+		d = 1 / d;
+		h *= d * c;
+		aa = -(a + m) * (a + b + m) * x / ((a + m2) * (a + m2 + 1));
+		d = 1 + aa * d;
+		if (fabs(d) < 1e-300)
+			d = 1e-300;
+		c = 1 + aa / c;
+		if (fabs(c) < 1e-300)
+			c = 1e-300;
+		d = 1 / d;
+		del = d * c;
+		h *= del;
+		if (fabs(del - 1) < 1e-12)
+			break;
+	}
+	return (h);
+}
+
+static double
+incbeta(double a, double b, double x)
+{
+	double bt;
+
+	if (x <= 0)
+		return (0);
+	if (x >= 1)
+		return (1);
+	bt = exp(lgamma(a + b) - lgamma(a) - lgamma(b) + a * log(x) +
+	    b * log(1 - x));
+	if (x < (a + 1) / (a + b + 2))
+		return (bt * incbeta_cf(a, b, x) / a);
+	return (1 - bt * incbeta_cf(b, a, 1 - x) / b);
+}
+
+/*
+ * P(T > t) for Student's t distribution with 'df' degrees of freedom.
+ */
+static double
+student_t_sf(double t, double df)
+{
+	double p;
+
+	p = 0.5 * incbeta(df / 2, 0.5, df / (df + t * t));
+	return (t > 0 ? p : 1 - p);
+}
+
+/*
+ * The t such that P(T > t) = p, for 0 < p < 0.5, by bisection.
+ */
+static double
+student_t_quantile(double p, double df)
+{
+	double lo, hi, mid;
+	int i;
+
+	lo = 0;
+	hi = 1e6;
+	for (i = 0; i < 200; i++) {
+		mid = (lo + hi) / 2;
+		if (student_t_sf(mid, df) > p)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return ((lo + hi) / 2);
+}
+
+/*
+ * Compare a workload's samples of one metric with the baseline's: the
+ * percentage change in the mean, signed so that positive is worse, and the
+ * one-sided Welch's t-test p-value for the hypothesis that the current mean
+ * is worse than the baseline mean by more than the threshold.
+ */
+static void
+compare(const struct samples *cur, const struct samples *base,
+    int higher_better, double *changep, double *pp)
+{
+	double mc, vc, mb, vb, scale, se, t, df, qc, qb;
+
+	samples_stats(cur, &mc, &vc);
+	samples_stats(base, &mb, &vb);
+	*changep = (mc - mb) / mb * 100;
+	if (higher_better)
+		*changep = -*changep;
+
+	/*
+	 * Scale the baseline to the threshold of acceptability, and test
+	 * whether the current results fall beyond it.
+	 */
+	scale = higher_better ? 1 - threshold / 100 : 1 + threshold / 100;
+	mb *= scale;
+	vb *= scale * scale;
+	qc = vc / cur->s_count;
+	qb = vb / base->s_count;
+	se = sqrt(qc + qb);
+	if (se == 0) {
+		*pp = (higher_better ? mc < mb : mc > mb) ? 0 : 1;
+		return;
+	}
+	t = (mc - mb) / se;
+	df = (qc + qb) * (qc + qb) / (qc * qc / (cur->s_count - 1) +
+	    qb * qb / (base->s_count - 1));
+	*pp = higher_better ? student_t_sf(-t, df) : student_t_sf(t, df);
+}
+
+/*
+ * Split a workload file line into whitespace-separated words, in place.
+ */
+static char **
+words_split(char *line, int *countp)
+{
+	char **words, *word;
+	int count;
+
+	words = NULL;
+	count = 0;
+	while ((word = strsep(&line, " \t\n")) != NULL) {
+		if (*word == '\0')
+			continue;
+		words = realloc(words, (count + 2) * sizeof(*words));
+		if (words == NULL)
+			err(EX_OSERR, "FAIL: realloc");
+		if ((words[count++] = strdup(word)) == NULL)
+			err(EX_OSERR, "FAIL: strdup");
+	}
+	if (words != NULL)
+		words[count] = NULL;
+	*countp = count;
+	return (words);
+}
+
+static void
+workload_load(const char *path)
+{
+	struct workload *wlp;
+	char *line, **words, *endp;
+	size_t linecap;
+	long lineno, l, warmup, repetitions;
+	int i, count;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		err(EX_NOINPUT, "FAIL: %s", path);
+	warmup = WARMUP_DEFAULT;
+	repetitions = REPETITIONS_DEFAULT;
+	line = NULL;
+	linecap = 0;
+	for (lineno = 1; getline(&line, &linecap, fp) > 0; lineno++) {
+		line[strcspn(line, "#")] = '\0';
+		words = words_split(line, &count);
+		if (count == 0)
+			continue;
+		if (strcmp(words[0], "warmup") == 0 ||
+		    strcmp(words[0], "repetitions") == 0) {
+			if (count != 2)
+				goto bad;
+			l = strtol(words[1], &endp, 10);
+			if (*endp != '\0' || l < 0)
+				goto bad;
+			if (words[0][0] == 'w')
+				warmup = l;
+			else if (l < 2)
+				errx(EX_DATAERR, "FAIL: %s:%ld: at least two "
+				    "repetitions are needed", path, lineno);
+			else
+				repetitions = l;
+		} else if (strcmp(words[0], "setup") == 0 ||
+		    strcmp(words[0], "run") == 0) {
+			if (count < (words[0][0] == 's' ? 2 : 3))
+				goto bad;
+			workloads = realloc(workloads,
+			    (nworkloads + 1) * sizeof(*workloads));
+			if (workloads == NULL)
+				err(EX_OSERR, "FAIL: realloc");
+			wlp = &workloads[nworkloads++];
+			memset(wlp, 0, sizeof(*wlp));
+			wlp->wl_setup = (words[0][0] == 's');
+			wlp->wl_name = words[1];
+			wlp->wl_argv = wlp->wl_setup ? &words[1] : &words[2];
+			wlp->wl_warmup = warmup;
+			wlp->wl_repetitions = repetitions;
+			for (i = 0; i < nworkloads - 1; i++) {
+				if (!wlp->wl_setup && !workloads[i].wl_setup &&
+				    strcmp(workloads[i].wl_name,
+				    wlp->wl_name) == 0)
+					errx(EX_DATAERR, "FAIL: %s:%ld: "
+					    "workload %s repeated", path,
+					    lineno, wlp->wl_name);
+			}
+		} else
+			goto bad;
+		continue;
+bad:
+		errx(EX_DATAERR, "FAIL: %s:%ld: expected \"setup command\", "
+		    "\"warmup count\", \"repetitions count\" or \"run name "
+		    "command\"", path, lineno);
+	}
+	if (ferror(fp))
+		err(EX_IOERR, "FAIL: %s", path);
+	free(line);
+	fclose(fp);
+}
+
+/*
+ * Run a command to completion, returning everything it wrote to stdout;
+ * its stderr is passed through.  Any failure is fatal.
+ */
+static char *
+command_run(const struct workload *wlp)
+{
+	char *output;
+	size_t len, cap;
+	ssize_t got;
+	pid_t pid;
+	int fds[2], status;
+
+	if (pipe(fds) < 0)
+		err(EX_OSERR, "FAIL: pipe");
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+		err(EX_OSERR, "FAIL: fork");
+	if (pid == 0) {
+		close(fds[0]);
+		if (dup2(fds[1], STDOUT_FILENO) < 0)
+			err(EX_OSERR, "FAIL: dup2");
+		close(fds[1]);
+		execvp(wlp->wl_argv[0], wlp->wl_argv);
+		warn("FAIL: %s", wlp->wl_argv[0]);
+		_exit(EX_UNAVAILABLE);
+	}
+	close(fds[1]);
+	output = NULL;
+	len = cap = 0;
+	do {
+		if (cap - len < BUFSIZ) {
+			cap += BUFSIZ;
+			if ((output = realloc(output, cap + 1)) == NULL)
+				err(EX_OSERR, "FAIL: realloc");
+		}
+		got = read(fds[0], output + len, cap - len);
+		if (got < 0 && errno != EINTR)
+			err(EX_IOERR, "FAIL: read");
+		if (got > 0)
+			len += got;
+	} while (got != 0);
+	output[len] = '\0';
+	close(fds[0]);
+	if (waitpid(pid, &status, 0) < 0)
+		err(EX_OSERR, "FAIL: waitpid");
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		errx(EX_SOFTWARE, "FAIL: %s %s: %s failed", wlp->wl_setup ?
+		    "setup" : "workload", wlp->wl_name, wlp->wl_argv[0]);
+	return (output);
+}
+
+/*
+ * Pick the metrics out of one trial's output; returns a mask of those
+ * found.
+ */
+static int
+output_parse(const char *output, double values[METRIC_COUNT])
+{
+	const char *line;
+	double v[4];
+	int found, n;
+
+	found = 0;
+	for (line = output; *line != '\0'; line += strcspn(line, "\n"),
+	    line += (*line == '\n')) {
+		n = 0;
+		if (!(found & (1 << METRIC_THROUGHPUT)) &&
+		    sscanf(line, "%lf KBytes/sec%n", &v[0], &n) == 1 &&
+		    n > 0 && (line[n] == '\n' || line[n] == '\0')) {
+			values[METRIC_THROUGHPUT] = v[0];
+			found |= 1 << METRIC_THROUGHPUT;
+		} else if (sscanf(line, "chunk latency (us): min %lf, p50 %lf, "
+		    "p90 %lf, p99 %lf", &v[0], &v[1], &v[2], &v[3]) == 4) {
+			values[METRIC_LATENCY_P50] = v[1];
+			values[METRIC_LATENCY_P99] = v[3];
+			found |= (1 << METRIC_LATENCY_P50) |
+			    (1 << METRIC_LATENCY_P99);
+		}
+	}
+	return (found);
+}
+
+/*
+ * Load the samples labelled 'baseline_label' from the results file, before
+ * this run adds to it, noting if they were measured in a different
+ * environment.
+ */
+static void
+baseline_load(void)
+{
+	struct fingerprint *fpp = &fingerprint;
+	char *line, *cp, *field[RESULTS_FIELDS], *endp;
+	size_t linecap;
+	long i, lineno, found;
+	double value;
+	int f, m, warned;
+	FILE *fp;
+
+	fp = fopen(results_path, "r");
+	if (fp == NULL)
+		err(EX_NOINPUT, "FAIL: %s", results_path);
+	line = NULL;
+	linecap = 0;
+	found = 0;
+	warned = 0;
+	for (lineno = 1; getline(&line, &linecap, fp) > 0; lineno++) {
+		if (line[0] == '#')
+			continue;
+		line[strcspn(line, "\n")] = '\0';
+		cp = line;
+		for (f = 0; f < RESULTS_FIELDS; f++) {
+			if ((field[f] = strsep(&cp, "\t")) == NULL)
+				errx(EX_DATAERR, "FAIL: %s:%ld: expected %d "
+				    "fields", results_path, lineno,
+				    RESULTS_FIELDS);
+		}
+		if (strcmp(field[RESULTS_LABEL], baseline_label) != 0)
+			continue;
+		value = strtod(field[RESULTS_VALUE], &endp);
+		if (*endp != '\0')
+			errx(EX_DATAERR, "FAIL: %s:%ld: bad value",
+			    results_path, lineno);
+		for (m = 0; m < METRIC_COUNT; m++) {
+			if (strcmp(field[RESULTS_METRIC],
+			    metric_desc[m].md_name) == 0)
+				break;
+		}
+		for (i = 0; i < nworkloads; i++) {
+			if (!workloads[i].wl_setup &&
+			    strcmp(field[RESULTS_WORKLOAD],
+			    workloads[i].wl_name) == 0)
+				break;
+		}
+		if (m == METRIC_COUNT || i == nworkloads)
+			continue;
+		samples_add(&workloads[i].wl_baseline[m], value);
+		found++;
+		if (!warned && (strcmp(field[RESULTS_KERNEL],
+		    fpp->fp_kernel) != 0 || strcmp(field[RESULTS_CPU],
+		    fpp->fp_cpu) != 0 || strcmp(field[RESULTS_GOVERNOR],
+		    fpp->fp_governor) != 0)) {
+			warnx("baseline %s was measured on %s, %s, governor "
+			    "%s", baseline_label, field[RESULTS_KERNEL],
+			    field[RESULTS_CPU], field[RESULTS_GOVERNOR]);
+			warned = 1;
+		}
+	}
+	if (ferror(fp))
+		err(EX_IOERR, "FAIL: %s", results_path);
+	free(line);
+	fclose(fp);
+	if (found == 0)
+		errx(EX_DATAERR, "FAIL: %s: no results labelled %s",
+		    results_path, baseline_label);
+}
+
+/*
+ * Run each workload's warm-up and measured trials in file order, appending
+ * each measured trial's metrics to the results file as they arrive.
+ */
+static void
+suite_run(FILE *results, const char *run)
+{
+	struct fingerprint *fpp = &fingerprint;
+	struct workload *wlp;
+	double values[METRIC_COUNT];
+	char *output;
+	long i, r;
+	int found, m;
+
+	for (i = 0; i < nworkloads; i++) {
+		wlp = &workloads[i];
+		if (wlp->wl_setup) {
+			free(command_run(wlp));
+			continue;
+		}
+		if (!qflag)
+			printf("%s: %ld warm-up, %ld measured trials\n",
+			    wlp->wl_name, wlp->wl_warmup,
+			    wlp->wl_repetitions);
+		for (r = 0; r < wlp->wl_warmup; r++)
+			free(command_run(wlp));
+		for (r = 0; r < wlp->wl_repetitions; r++) {
+			output = command_run(wlp);
+			found = output_parse(output, values);
+			free(output);
+			if (!(found & (1 << METRIC_THROUGHPUT)))
+				errx(EX_DATAERR, "FAIL: workload %s: no "
+				    "KBytes/sec result (is -q given?)",
+				    wlp->wl_name);
+			for (m = 0; m < METRIC_COUNT; m++) {
+				if (!(found & (1 << m)))
+					continue;
+				samples_add(&wlp->wl_samples[m], values[m]);
+				fprintf(results, "%s\t%s\t%s\t%s\t%s\t%s\t%s\t"
+				    "%s\t%.2F\n", run, run_label,
+				    fpp->fp_commit, fpp->fp_kernel,
+				    fpp->fp_cpu, fpp->fp_governor,
+				    wlp->wl_name, metric_desc[m].md_name,
+				    values[m]);
+				if (vflag)
+					printf("  trial %ld: %s %.2F %s\n",
+					    r + 1, metric_desc[m].md_name,
+					    values[m], metric_desc[m].md_unit);
+			}
+		}
+		if (fflush(results) == EOF)
+			err(EX_IOERR, "FAIL: %s", results_path);
+	}
+}
+
+/*
+ * Summarise each workload's metrics and, with a baseline, compare them;
+ * returns the number of regressions.
+ */
+static int
+suite_report(void)
+{
+	const struct metric_desc *mdp;
+	struct workload *wlp;
+	double mean, var, change, p;
+	long i;
+	int m, regressed, regressions;
+
+	regressions = 0;
+	for (i = 0; i < nworkloads; i++) {
+		wlp = &workloads[i];
+		if (wlp->wl_setup)
+			continue;
+		for (m = 0; m < METRIC_COUNT; m++) {
+			mdp = &metric_desc[m];
+			if (wlp->wl_samples[m].s_count == 0)
+				continue;
+			samples_stats(&wlp->wl_samples[m], &mean, &var);
+			if (baseline_label == NULL) {
+				if (!qflag)
+					printf("%-24s %-12s %14.2F %-10s "
+					    "(sd %.1F%%)\n", wlp->wl_name,
+					    mdp->md_name, mean, mdp->md_unit,
+					    mean != 0 ? sqrt(var) / mean *
+					    100 : 0);
+				continue;
+			}
+			if (wlp->wl_baseline[m].s_count < 2) {
+				if (!qflag)
+					printf("%-24s %-12s %14.2F %-10s "
+					    "no baseline\n", wlp->wl_name,
+					    mdp->md_name, mean, mdp->md_unit);
+				continue;
+			}
+			compare(&wlp->wl_samples[m], &wlp->wl_baseline[m],
+			    mdp->md_higher_better, &change, &p);
+			regressed = (change > threshold && p < alpha);
+			regressions += regressed;
+			if (!qflag || regressed)
+				printf("%-24s %-12s %14.2F %-10s %+6.1F%% "
+				    "(p=%.3F)%s\n", wlp->wl_name,
+				    mdp->md_name, mean, mdp->md_unit,
+				    mdp->md_higher_better ? -change : change,
+				    p, regressed ? "  REGRESSION" : "");
+		}
+	}
+	return (regressions);
+}
+
+/*
+ * Run one -A trial, returning a mask of the metrics found.
+ */
+static int
+ab_trial(const struct workload *wlp, double values[METRIC_COUNT])
+{
+	char *output;
+	int found;
+
+	output = command_run(wlp);
+	found = output_parse(output, values);
+	free(output);
+	if (!(found & (1 << METRIC_THROUGHPUT)))
+		errx(EX_DATAERR, "FAIL: %s: no KBytes/sec result (is -q "
+		    "given?)", wlp->wl_name);
+	return (found);
+}
+
+static double
+ab_median(const struct samples *sp)
+{
+	double *sorted, median;
+
+	sorted = malloc(sp->s_count * sizeof(*sorted));
+	if (sorted == NULL)
+		err(EX_OSERR, "FAIL: malloc");
+	memcpy(sorted, sp->s_values, sp->s_count * sizeof(*sorted));
+	qsort(sorted, sp->s_count, sizeof(*sorted), double_compare);
+	median = sp->s_count % 2 ? sorted[sp->s_count / 2] :
+	    (sorted[sp->s_count / 2 - 1] + sorted[sp->s_count / 2]) / 2;
+	free(sorted);
+	return (median);
+}
+
+/*
+ * Compare programs 'a' and 'b' given the same arguments.  Each pair of
+ * trials runs both, in an order chosen by coin toss, and contributes one
+ * percentage difference, b relative to a, per metric; pairing cancels
+ * drift slower than a pair, and randomising the order stops whatever runs
+ * second from being favoured, e.g. by a warmer page cache.
+ */
+static void
+ab_run(struct workload *a, struct workload *b)
+{
+	struct workload *first;
+	const struct metric_desc *mdp;
+	struct samples diffs[METRIC_COUNT];
+	double va[METRIC_COUNT], vb[METRIC_COUNT];
+	double mean, var, half, t, p;
+	long i;
+	int found, m;
+
+	memset(diffs, 0, sizeof(diffs));
+	srand48(ab_seed);
+	if (!qflag)
+		printf("A: %s\nB: %s\n%ld warm-up trials each, %ld pairs, "
+		    "order seed %ld\n", a->wl_name, b->wl_name, ab_warmup,
+		    ab_pairs, ab_seed);
+	for (i = 0; i < ab_warmup; i++) {
+		free(command_run(a));
+		free(command_run(b));
+	}
+	for (i = 0; i < ab_pairs; i++) {
+		first = drand48() < 0.5 ? a : b;
+		found = ab_trial(first, first == a ? va : vb);
+		found &= ab_trial(first == a ? b : a, first == a ? vb : va);
+		for (m = 0; m < METRIC_COUNT; m++) {
+			if (!(found & (1 << m)))
+				continue;
+			samples_add(&a->wl_samples[m], va[m]);
+			samples_add(&b->wl_samples[m], vb[m]);
+			samples_add(&diffs[m], (vb[m] - va[m]) / va[m] * 100);
+			if (vflag)
+				printf("  pair %ld (%s first): %s A %.2F, B "
+				    "%.2F %s\n", i + 1, first == a ? "A" : "B",
+				    metric_desc[m].md_name, va[m], vb[m],
+				    metric_desc[m].md_unit);
+		}
+	}
+
+	for (m = 0; m < METRIC_COUNT; m++) {
+		mdp = &metric_desc[m];
+		if (diffs[m].s_count < 2)
+			continue;
+		samples_stats(&diffs[m], &mean, &var);
+		half = student_t_quantile(alpha / 2, diffs[m].s_count - 1) *
+		    sqrt(var / diffs[m].s_count);
+		if (var == 0)
+			p = mean == 0 ? 1 : 0;
+		else {
+			t = mean / sqrt(var / diffs[m].s_count);
+			p = 2 * student_t_sf(fabs(t), diffs[m].s_count - 1);
+		}
+		printf("%-12s A %.2F, B %.2F %s (medians); B - A %+.2F%% "
+		    "+/- %.2F%% (%.0F%% CI), p=%.3F: %s\n", mdp->md_name,
+		    ab_median(&a->wl_samples[m]), ab_median(&b->wl_samples[m]),
+		    mdp->md_unit, mean, half, (1 - alpha) * 100, p,
+		    p >= alpha ? "no significant difference" :
+		    (mean > 0) == (mdp->md_higher_better != 0) ?
+		    "B is better" : "B is worse");
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct fingerprint *fpp = &fingerprint;
+	struct workload ab[2];
+	char run[32], *endp;
+	FILE *results;
+	time_t now;
+	int ch, i, regressions, sflag;
+
+	ab_seed = time(NULL) ^ getpid();
+	sflag = 0;
+	/*
+	 * With -A, options after program-a belong to the programs; stop at
+	 * the first operand as BSD getopt() does.
+	 */
+	while ((ch = getopt(argc, argv,
+#ifdef __linux__
+	    "+"
+#endif
+	    "Aa:b:Il:n:o:qs:t:vw:")) != -1) {
+		switch (ch) {
+		case 'A':
+			Aflag++;
+			break;
+
+		case 'a':
+			alpha = strtod(optarg, &endp);
+			if (*optarg == '\0' || *endp != '\0' || alpha <= 0 ||
+			    alpha >= 1)
+				usage();
+			break;
+
+		case 'b':
+			baseline_label = optarg;
+			break;
+
+		case 'I':
+			Iflag++;
+			break;
+
+		case 'l':
+			run_label = optarg;
+			break;
+
+		case 'n':
+			ab_pairs = strtol(optarg, &endp, 10);
+			if (*optarg == '\0' || *endp != '\0' || ab_pairs < 2)
+				usage();
+			break;
+
+		case 'o':
+			results_path = optarg;
+			break;
+
+		case 'q':
+			qflag++;
+			break;
+
+		case 's':
+			ab_seed = strtol(optarg, &endp, 10);
+			if (*optarg == '\0' || *endp != '\0')
+				usage();
+			sflag++;
+			break;
+
+		case 't':
+			threshold = strtod(optarg, &endp);
+			if (*optarg == '\0' || *endp != '\0' || threshold < 0 ||
+			    threshold >= 100)
+				usage();
+			break;
+
+		case 'v':
+			vflag++;
+			break;
+
+		case 'w':
+			ab_warmup = strtol(optarg, &endp, 10);
+			if (*optarg == '\0' || *endp != '\0' || ab_warmup < 0)
+				usage();
+			break;
+
+		case '?':
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (Aflag && (argc < 2 || baseline_label != NULL ||
+	    run_label != NULL))
+		usage();
+	if (!Aflag && (argc != 1 || ab_pairs != 0 || ab_warmup != -1 ||
+	    sflag))
+		usage();
+	if (run_label != NULL && (run_label[0] == '\0' ||
+	    strcmp(run_label, "-") == 0 || strpbrk(run_label, "\t\n") != NULL))
+		usage();
+
+	if (Aflag) {
+		if (ab_pairs == 0)
+			ab_pairs = PAIRS_DEFAULT;
+		if (ab_warmup == -1)
+			ab_warmup = WARMUP_DEFAULT;
+		for (i = 0; i < 2; i++) {
+			memset(&ab[i], 0, sizeof(ab[i]));
+			ab[i].wl_name = argv[i];
+			ab[i].wl_argv = calloc(argc, sizeof(*ab[i].wl_argv));
+			if (ab[i].wl_argv == NULL)
+				err(EX_OSERR, "FAIL: calloc");
+			ab[i].wl_argv[0] = argv[i];
+			memcpy(&ab[i].wl_argv[1], &argv[2],
+			    (argc - 2) * sizeof(*argv));
+		}
+		fingerprint_collect(NULL);
+		if (!qflag)
+			printf("suite: %s; %s; governor %s\n", fpp->fp_kernel,
+			    fpp->fp_cpu, fpp->fp_governor);
+		if (isolation_check() != 0 && Iflag)
+			errx(EX_UNAVAILABLE, "FAIL: CPU isolation checks "
+			    "failed");
+		ab_run(&ab[0], &ab[1]);
+		exit(EX_OK);
+	}
+
+	workload_load(argv[0]);
+	fingerprint_collect(argv[0]);
+
+	/*
+	 * Unlabelled runs outside a checkout would all share the label "-",
+	 * and so be compared with one another.
+	 */
+	if (run_label == NULL) {
+		if (strcmp(fpp->fp_commit, "-") == 0)
+			errx(EX_USAGE, "FAIL: %s is not in a git checkout; "
+			    "label this run with -l", argv[0]);
+		run_label = fpp->fp_commit;
+	}
+	if (baseline_label != NULL)
+		baseline_load();
+	if (!qflag)
+		printf("suite: %s; %s; governor %s; commit %s\n",
+		    fpp->fp_kernel, fpp->fp_cpu, fpp->fp_governor,
+		    fpp->fp_commit);
+	if (isolation_check() != 0 && Iflag)
+		errx(EX_UNAVAILABLE, "FAIL: CPU isolation checks failed");
+
+	results = fopen(results_path, "a");
+	if (results == NULL)
+		err(EX_CANTCREAT, "FAIL: %s", results_path);
+	if (fseek(results, 0, SEEK_END) < 0)
+		err(EX_IOERR, "FAIL: %s", results_path);
+	if (ftell(results) == 0)
+		fprintf(results, "# run\tlabel\tcommit\tkernel\tcpu\t"
+		    "governor\tworkload\tmetric\tvalue\n");
+	now = time(NULL);
+	strftime(run, sizeof(run), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+	suite_run(results, run);
+	if (fclose(results) == EOF)
+		err(EX_IOERR, "FAIL: %s", results_path);
+
+	regressions = suite_report();
+	if (regressions != 0) {
+		printf("%d regression%s against %s\n", regressions,
+		    regressions == 1 ? "" : "s", baseline_label);
+		exit(EXIT_REGRESSION);
+	}
+	exit(EX_OK);
+}